@@ -0,0 +1,76 @@
+# The Panel without main(): shared by the application and the soak test
+
+INCLUDEPATH += $$PWD
+
+SOURCES += \
+    $$PWD/cameraingest.cpp \
+    $$PWD/chunkstore.cpp \
+    $$PWD/clocksync.cpp \
+    $$PWD/controllerdiscovery.cpp \
+    $$PWD/frameexport.cpp \
+    $$PWD/imageresampler.cpp \
+    $$PWD/livewindow.cpp \
+    $$PWD/messagewindow.cpp \
+    $$PWD/metrics.cpp \
+    $$PWD/metricsserver.cpp \
+    $$PWD/mjpegserver.cpp \
+    $$PWD/multicastreceiver.cpp \
+    $$PWD/networkworker.cpp \
+    $$PWD/panelconfig.cpp \
+    $$PWD/protocol.cpp \
+    $$PWD/resourcecache.cpp \
+    $$PWD/scoreoverlay.cpp \
+    $$PWD/scorepanel.cpp \
+    $$PWD/scoresnapshot.cpp \
+    $$PWD/slideplaylist.cpp \
+    $$PWD/slidewindow.cpp \
+    $$PWD/spotsync.cpp \
+    $$PWD/stallwatchdog.cpp \
+    $$PWD/startuptrace.cpp \
+    $$PWD/textfitter.cpp \
+    $$PWD/timeoutwindow.cpp \
+    $$PWD/trace.cpp \
+    $$PWD/uploadreceiver.cpp \
+    $$PWD/utility.cpp \
+    $$PWD/volleyapplication.cpp \
+    $$PWD/volleypanel.cpp
+
+
+HEADERS += \
+    $$PWD/cameraingest.h \
+    $$PWD/chunkstore.h \
+    $$PWD/clocksync.h \
+    $$PWD/controllerdiscovery.h \
+    $$PWD/frameexport.h \
+    $$PWD/imageresampler.h \
+    $$PWD/livewindow.h \
+    $$PWD/messagewindow.h \
+    $$PWD/metrics.h \
+    $$PWD/metricsserver.h \
+    $$PWD/mjpegserver.h \
+    $$PWD/multicastreceiver.h \
+    $$PWD/networkworker.h \
+    $$PWD/panelconfig.h \
+    $$PWD/panelorientation.h \
+    $$PWD/protocol.h \
+    $$PWD/resourcecache.h \
+    $$PWD/scoreoverlay.h \
+    $$PWD/scorepanel.h \
+    $$PWD/scoresnapshot.h \
+    $$PWD/scorestate.h \
+    $$PWD/slideplaylist.h \
+    $$PWD/slidewindow.h \
+    $$PWD/spotsync.h \
+    $$PWD/stallwatchdog.h \
+    $$PWD/startuptrace.h \
+    $$PWD/textfitter.h \
+    $$PWD/timeoutwindow.h \
+    $$PWD/trace.h \
+    $$PWD/uploadreceiver.h \
+    $$PWD/utility.h \
+    $$PWD/volleyapplication.h \
+    $$PWD/volleypanel.h
+
+
+# shm_open() is in librt before glibc 2.34
+unix:!macx: LIBS += -lrt
@@ -1,35 +1,21 @@
 QT += core
 QT += gui
+QT += network
 QT += websockets
 QT += widgets
 
-CONFIG += c++11
+CONFIG += c++17
+CONFIG += lrelease
+CONFIG += embed_translations
 
 # You can make your code fail to compile if it uses deprecated APIs.
 # In order to do so, uncomment the following line.
 DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000    # disables all the APIs deprecated before Qt 6.0.0
 
-SOURCES += \
-    main.cpp \
-    messagewindow.cpp \
-    scorepanel.cpp \
-    slidewindow.cpp \
-    timeoutwindow.cpp \
-    utility.cpp \
-    volleyapplication.cpp \
-    volleypanel.cpp
-
-
-HEADERS += \
-    messagewindow.h \
-    panelorientation.h \
-    scorepanel.h \
-    slidewindow.h \
-    timeoutwindow.h \
-    utility.h \
-    volleyapplication.h \
-    volleypanel.h
+include(VolleyPanel.pri)
 
+SOURCES += \
+    main.cpp
 
 RC_ICONS = Logo.ico
 
@@ -0,0 +1,642 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QSocketNotifier>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <cstring>
+
+#ifdef Q_OS_LINUX
+    #include <fcntl.h>
+    #include <unistd.h>
+    #include <errno.h>
+    #include <time.h>
+    #include <sys/ioctl.h>
+    #include <sys/mman.h>
+    #include <linux/videodev2.h>
+#endif
+
+#include "cameraingest.h"
+#include "utility.h"
+#include "metrics.h"
+#include "trace.h"
+
+
+#define N_BUFFERS           4   // Frames in flight: driver, mailbox, screen and a spare
+#define TEST_PATTERN_TIME   40  // msec between test pattern frames
+#define BUFFER_ALIGNMENT    64
+
+
+#ifdef Q_OS_LINUX
+static int
+xioctl(int fd, unsigned long request, void* arg) {
+    int result;
+    do {
+        result = ioctl(fd, request, arg);
+    } while(result == -1 && errno == EINTR);
+    return result;
+}
+#endif
+
+
+/*!
+ * \brief CameraIngest::CameraIngest Live frames acquisition
+ * \param parent
+ *
+ * The object is meant to live in its own thread. Frames are captured in
+ * a small ring of buffers (memory mapped from the driver for V4L2) and
+ * handed to the renderer as QImages that wrap the buffers without any
+ * copy: when the last QImage referring to a buffer is destroyed the
+ * buffer goes back to the ring.
+ * Only the latest frame is kept in the mailbox: a frame not taken by
+ * the renderer before the next one arrives is dropped.
+ */
+CameraIngest::CameraIngest(QObject *parent)
+    : QObject(parent)
+    , type(source_TestPattern)
+    , frameSize(1280, 720)
+    , frameFormat(QImage::Format_RGB32)
+    , bytesPerLine(0)
+    , mailboxTime(0)
+    , nDropped(0)
+    , deviceFd(-1)
+    , pDeviceNotifier(nullptr)
+    , pPatternTimer(nullptr)
+    , pPipeProcess(nullptr)
+    , iPipeBuffer(-1)
+    , pipeFilled(0)
+    , iFrameCount(0)
+    , bRunning(false)
+{
+}
+
+
+CameraIngest::~CameraIngest() {
+    stop();
+    freeBuffers();
+}
+
+
+/*!
+ * \brief CameraIngest::setSource Select the frame source (to be called before start())
+ * \param newType The source type
+ * \param sNewSource The device (V4L2) or the file to loop (Pipe)
+ * \param newFrameSize The requested frame size
+ */
+void
+CameraIngest::setSource(sourceType newType, QString sNewSource, QSize newFrameSize) {
+    type      = newType;
+    sSource   = sNewSource;
+    frameSize = newFrameSize;
+}
+
+
+/*!
+ * \brief CameraIngest::monotonicTime
+ * \return The monotonic clock (the one of the V4L2 timestamps) in usec
+ */
+qint64
+CameraIngest::monotonicTime() {
+#ifdef Q_OS_LINUX
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return qint64(now.tv_sec)*1000000 + now.tv_nsec/1000;
+#else
+    static QElapsedTimer clock;
+    if(!clock.isValid())
+        clock.start();
+    return clock.nsecsElapsed()/1000;
+#endif
+}
+
+
+/*!
+ * \brief CameraIngest::takeFrame Get the latest frame (called by the renderer)
+ * \param pCaptureTime [out] The capture time of the frame
+ * \return The frame or a null image if no new frame is available
+ */
+QImage
+CameraIngest::takeFrame(qint64* pCaptureTime) {
+    QMutexLocker locker(&mailboxMutex);
+    QImage frame;
+    frame.swap(mailbox);
+    if(pCaptureTime)
+        *pCaptureTime = mailboxTime;
+    return frame;
+}
+
+
+qint64
+CameraIngest::droppedFrames() const {
+    return nDropped.load(std::memory_order_relaxed);
+}
+
+
+/*!
+ * \brief CameraIngest::start Start the acquisition (in the ingest thread)
+ */
+void
+CameraIngest::start() {
+    if(bRunning)
+        return;
+    nDropped.store(0, std::memory_order_relaxed);
+    bool bStarted = false;
+    if(type == source_V4L2)
+        bStarted = startDevice();
+    else if(type == source_Pipe)
+        bStarted = startPipe();
+    else
+        bStarted = startTestPattern();
+    if(!bStarted) {
+        stop();
+        return;
+    }
+    bRunning = true;
+}
+
+
+/*!
+ * \brief CameraIngest::stop Stop the acquisition (in the ingest thread)
+ */
+void
+CameraIngest::stop() {
+    bRunning = false;
+    if(pPatternTimer) {
+        pPatternTimer->stop();
+        delete pPatternTimer;
+        pPatternTimer = nullptr;
+    }
+    if(pPipeProcess) {
+        pPipeProcess->disconnect();
+        pPipeProcess->kill();
+        pPipeProcess->waitForFinished(1000);
+        delete pPipeProcess;
+        pPipeProcess = nullptr;
+    }
+    if(iPipeBuffer >= 0) {
+        QMutexLocker locker(&freeMutex);
+        freeList.append(iPipeBuffer);
+        iPipeBuffer = -1;
+    }
+    stopDevice();
+    QMutexLocker locker(&mailboxMutex);
+    mailbox = QImage();
+}
+
+
+/*!
+ * \brief CameraIngest::releaseBuffer QImage cleanup function: the buffer is free again
+ * \param pInfo The FrameBuffer
+ */
+void
+CameraIngest::releaseBuffer(void* pInfo) {
+    FrameBuffer* pBuffer = static_cast<FrameBuffer*>(pInfo);
+    CameraIngest* pOwner = pBuffer->owner;
+    {
+        QMutexLocker locker(&pOwner->freeMutex);
+        pOwner->freeList.append(pBuffer->index);
+    }
+    if(pOwner->type == source_V4L2)
+        QMetaObject::invokeMethod(pOwner, "requeueBuffers", Qt::QueuedConnection);
+}
+
+
+/*!
+ * \brief CameraIngest::allocateBuffers Buffers for the sources not memory mapped
+ * \param nBuffers Number of buffers
+ * \param length Size of each buffer
+ * \return true on success
+ */
+bool
+CameraIngest::allocateBuffers(int nBuffers, size_t length) {
+    freeBuffers();
+    buffers.resize(nBuffers);
+    size_t alignedLength = (length + BUFFER_ALIGNMENT - 1) & ~size_t(BUFFER_ALIGNMENT - 1);
+    QMutexLocker locker(&freeMutex);
+    freeList.clear();
+    for(int i=0; i<nBuffers; i++) {
+        FrameBuffer& buffer = buffers[i];
+        buffer.data     = static_cast<uchar*>(qMallocAligned(alignedLength, BUFFER_ALIGNMENT));
+        buffer.length   = length;
+        buffer.isMapped = false;
+        buffer.index    = i;
+        buffer.owner    = this;
+        if(!buffer.data) {
+            emit ingestError(QString("Unable to allocate the frame buffers"));
+            return false;
+        }
+        freeList.append(i);
+    }
+    return true;
+}
+
+
+void
+CameraIngest::freeBuffers() {
+    for(int i=0; i<buffers.count(); i++) {
+        FrameBuffer& buffer = buffers[i];
+        if(!buffer.data)
+            continue;
+#ifdef Q_OS_LINUX
+        if(buffer.isMapped)
+            munmap(buffer.data, buffer.length);
+        else
+#endif
+            qFreeAligned(buffer.data);
+        buffer.data = nullptr;
+    }
+    buffers.clear();
+    QMutexLocker locker(&freeMutex);
+    freeList.clear();
+}
+
+
+/*!
+ * \brief CameraIngest::takeFreeBuffer
+ * \return The index of a free buffer or -1 if all the buffers are in use
+ */
+int
+CameraIngest::takeFreeBuffer() {
+    QMutexLocker locker(&freeMutex);
+    if(freeList.isEmpty())
+        return -1;
+    return freeList.takeFirst();
+}
+
+
+/*!
+ * \brief CameraIngest::publish Put a frame in the mailbox
+ * \param index The buffer holding the frame
+ * \param captureTime The capture time (monotonic usec)
+ */
+void
+CameraIngest::publish(int index, qint64 captureTime) {
+    TRACE_SCOPE("CameraIngest::publish");
+    QImage frame(buffers[index].data,
+                 frameSize.width(),
+                 frameSize.height(),
+                 bytesPerLine,
+                 frameFormat,
+                 &CameraIngest::releaseBuffer,
+                 &buffers[index]);
+    bool bWasEmpty;
+    {
+        QMutexLocker locker(&mailboxMutex);
+        bWasEmpty = mailbox.isNull();
+        if(!bWasEmpty) // The renderer did not take it: stale
+            nDropped.fetch_add(1, std::memory_order_relaxed);
+        mailbox = frame;
+        mailboxTime = captureTime;
+    }
+    if(bWasEmpty)
+        emit frameReady();
+}
+
+
+/*!
+ * \brief CameraIngest::requeueBuffers Give back to the driver the buffers released by the renderer
+ */
+void
+CameraIngest::requeueBuffers() {
+#ifdef Q_OS_LINUX
+    if(type != source_V4L2 || deviceFd < 0)
+        return;
+    QList<int> released;
+    {
+        QMutexLocker locker(&freeMutex);
+        released.swap(freeList);
+    }
+    for(int index : qAsConst(released)) {
+        struct v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index  = quint32(index);
+        if(xioctl(deviceFd, VIDIOC_QBUF, &buf) == -1) {
+            logMessage(Q_NULLPTR,
+                       Q_FUNC_INFO,
+                       QString("VIDIOC_QBUF failed: %1").arg(strerror(errno)));
+        }
+    }
+#endif
+}
+
+
+/*!
+ * \brief CameraIngest::startDevice Open a V4L2 device and start streaming
+ * \return true on success
+ */
+bool
+CameraIngest::startDevice() {
+#ifdef Q_OS_LINUX
+    freeBuffers();
+    deviceFd = ::open(sSource.toLocal8Bit().constData(), O_RDWR | O_NONBLOCK);
+    if(deviceFd < 0) {
+        emit ingestError(QString("Unable to open %1: %2").arg(sSource, strerror(errno)));
+        return false;
+    }
+    struct v4l2_capability capability;
+    memset(&capability, 0, sizeof(capability));
+    if(xioctl(deviceFd, VIDIOC_QUERYCAP, &capability) == -1) {
+        emit ingestError(QString("%1 is not a V4L2 device").arg(sSource));
+        return false;
+    }
+    quint32 caps = (capability.capabilities & V4L2_CAP_DEVICE_CAPS) ?
+                   capability.device_caps : capability.capabilities;
+    if(!(caps & V4L2_CAP_VIDEO_CAPTURE) || !(caps & V4L2_CAP_STREAMING)) {
+        emit ingestError(QString("%1 can't stream video").arg(sSource));
+        return false;
+    }
+
+    // Only the formats that QPainter can draw without any conversion.
+    // Format_RGB32 is 0xffRRGGBB in native order: B,G,R,X in memory on
+    // little endian (V4L2 XBGR32/BGR32), X,R,G,B on big endian (XRGB32).
+    struct {
+        quint32        pixelFormat;
+        QImage::Format imageFormat;
+    } candidates[] = {
+#if Q_BYTE_ORDER == Q_LITTLE_ENDIAN
+#ifdef V4L2_PIX_FMT_XBGR32
+        { V4L2_PIX_FMT_XBGR32, QImage::Format_RGB32 },
+#endif
+        { V4L2_PIX_FMT_BGR32,  QImage::Format_RGB32 },
+#else
+#ifdef V4L2_PIX_FMT_XRGB32
+        { V4L2_PIX_FMT_XRGB32, QImage::Format_RGB32 },
+#endif
+        { V4L2_PIX_FMT_RGB32,  QImage::Format_RGB32 },
+#endif
+        { V4L2_PIX_FMT_RGB24,  QImage::Format_RGB888 }
+    };
+    bool bFormatOk = false;
+    struct v4l2_format format;
+    for(const auto& candidate : candidates) {
+        memset(&format, 0, sizeof(format));
+        format.type = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        format.fmt.pix.width       = quint32(frameSize.width());
+        format.fmt.pix.height      = quint32(frameSize.height());
+        format.fmt.pix.pixelformat = candidate.pixelFormat;
+        format.fmt.pix.field       = V4L2_FIELD_NONE;
+        if(xioctl(deviceFd, VIDIOC_S_FMT, &format) == 0 &&
+           format.fmt.pix.pixelformat == candidate.pixelFormat)
+        {
+            frameFormat = candidate.imageFormat;
+            bFormatOk = true;
+            break;
+        }
+    }
+    if(!bFormatOk) {
+        emit ingestError(QString("%1: no RGB format available").arg(sSource));
+        return false;
+    }
+    frameSize    = QSize(int(format.fmt.pix.width), int(format.fmt.pix.height));
+    bytesPerLine = int(format.fmt.pix.bytesperline);
+
+    struct v4l2_requestbuffers request;
+    memset(&request, 0, sizeof(request));
+    request.count  = N_BUFFERS;
+    request.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    request.memory = V4L2_MEMORY_MMAP;
+    if(xioctl(deviceFd, VIDIOC_REQBUFS, &request) == -1 || request.count < 2) {
+        emit ingestError(QString("%1: unable to get the capture buffers").arg(sSource));
+        return false;
+    }
+    buffers.resize(int(request.count));
+    for(int i=0; i<buffers.count(); i++) {
+        FrameBuffer& buffer = buffers[i];
+        buffer.data  = nullptr;
+        buffer.index = i;
+        buffer.owner = this;
+        struct v4l2_buffer buf;
+        memset(&buf, 0, sizeof(buf));
+        buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        buf.memory = V4L2_MEMORY_MMAP;
+        buf.index  = quint32(i);
+        if(xioctl(deviceFd, VIDIOC_QUERYBUF, &buf) == -1) {
+            emit ingestError(QString("%1: VIDIOC_QUERYBUF failed").arg(sSource));
+            return false;
+        }
+        void* pData = mmap(nullptr, buf.length, PROT_READ | PROT_WRITE,
+                           MAP_SHARED, deviceFd, buf.m.offset);
+        if(pData == MAP_FAILED) {
+            emit ingestError(QString("%1: mmap failed").arg(sSource));
+            return false;
+        }
+        buffer.data     = static_cast<uchar*>(pData);
+        buffer.length   = buf.length;
+        buffer.isMapped = true;
+        if(xioctl(deviceFd, VIDIOC_QBUF, &buf) == -1) {
+            emit ingestError(QString("%1: VIDIOC_QBUF failed").arg(sSource));
+            return false;
+        }
+    }
+    enum v4l2_buf_type bufferType = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    if(xioctl(deviceFd, VIDIOC_STREAMON, &bufferType) == -1) {
+        emit ingestError(QString("%1: VIDIOC_STREAMON failed").arg(sSource));
+        return false;
+    }
+    pDeviceNotifier = new QSocketNotifier(deviceFd, QSocketNotifier::Read, this);
+    connect(pDeviceNotifier, SIGNAL(activated(int)),
+            this, SLOT(onDeviceReadable()));
+    return true;
+#else
+    emit ingestError(QString("V4L2 devices are available only on Linux"));
+    return false;
+#endif
+}
+
+
+void
+CameraIngest::stopDevice() {
+#ifdef Q_OS_LINUX
+    if(pDeviceNotifier) {
+        pDeviceNotifier->setEnabled(false);
+        delete pDeviceNotifier;
+        pDeviceNotifier = nullptr;
+    }
+    if(deviceFd >= 0) {
+        enum v4l2_buf_type bufferType = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+        xioctl(deviceFd, VIDIOC_STREAMOFF, &bufferType);
+        ::close(deviceFd);
+        deviceFd = -1;
+    }
+#endif
+}
+
+
+/*!
+ * \brief CameraIngest::onDeviceReadable Dequeue a captured frame
+ */
+void
+CameraIngest::onDeviceReadable() {
+#ifdef Q_OS_LINUX
+    requeueBuffers();
+    struct v4l2_buffer buf;
+    memset(&buf, 0, sizeof(buf));
+    buf.type   = V4L2_BUF_TYPE_VIDEO_CAPTURE;
+    buf.memory = V4L2_MEMORY_MMAP;
+    if(xioctl(deviceFd, VIDIOC_DQBUF, &buf) == -1) {
+        if(errno != EAGAIN) {
+            emit ingestError(QString("%1: VIDIOC_DQBUF failed: %2")
+                             .arg(sSource, strerror(errno)));
+        }
+        return;
+    }
+    qint64 captureTime = qint64(buf.timestamp.tv_sec)*1000000 + buf.timestamp.tv_usec;
+    if((buf.flags & V4L2_BUF_FLAG_TIMESTAMP_MASK) != V4L2_BUF_FLAG_TIMESTAMP_MONOTONIC)
+        captureTime = monotonicTime();
+    publish(int(buf.index), captureTime);
+#endif
+}
+
+
+/*!
+ * \brief CameraIngest::startPipe Loop a file through ffmpeg as raw BGRA frames
+ * \return true on success
+ *
+ * The bytes read from the pipe land directly in the frame buffers.
+ */
+bool
+CameraIngest::startPipe() {
+    frameFormat  = QImage::Format_RGB32;
+    bytesPerLine = 4*frameSize.width();
+    if(!allocateBuffers(N_BUFFERS, size_t(bytesPerLine)*size_t(frameSize.height())))
+        return false;
+    discardBuffer.resize(64*1024);
+    pPipeProcess = new QProcess(this);
+    connect(pPipeProcess, SIGNAL(readyReadStandardOutput()),
+            this, SLOT(onPipeReadyRead()));
+    QStringList sArguments = QStringList{
+            "-loglevel", "quiet",
+            "-re",
+            "-stream_loop", "-1",
+            "-i", sSource,
+            "-f", "rawvideo",
+            "-pix_fmt", "bgra",
+            "-s", QString("%1x%2").arg(frameSize.width()).arg(frameSize.height()),
+            "-"
+    };
+#ifdef Q_OS_WINDOWS
+    pPipeProcess->start(QString("ffmpeg.exe"), sArguments);
+#else
+    pPipeProcess->start(QString("/usr/bin/ffmpeg"), sArguments);
+#endif
+    if(!pPipeProcess->waitForStarted(3000)) {
+        emit ingestError(QString("Unable to start ffmpeg on %1").arg(sSource));
+        return false;
+    }
+    Metrics::processStarts.add();
+    return true;
+}
+
+
+/*!
+ * \brief CameraIngest::onPipeReadyRead Fill the current buffer with the pipe data
+ */
+void
+CameraIngest::onPipeReadyRead() {
+    qint64 frameBytes = qint64(bytesPerLine)*frameSize.height();
+    while(pPipeProcess->bytesAvailable() > 0) {
+        if(iPipeBuffer < 0) {
+            iPipeBuffer = takeFreeBuffer();
+            pipeFilled = 0;
+        }
+        if(iPipeBuffer < 0) {// No free buffer: this frame is lost
+            qint64 skip = qMin(frameBytes-pipeFilled, qint64(discardBuffer.size()));
+            qint64 nRead = pPipeProcess->read(discardBuffer.data(), skip);
+            if(nRead <= 0)
+                return;
+            pipeFilled += nRead;
+            if(pipeFilled == frameBytes) {
+                pipeFilled = 0;
+                nDropped.fetch_add(1, std::memory_order_relaxed);
+            }
+            continue;
+        }
+        qint64 nRead = pPipeProcess->read(reinterpret_cast<char*>(buffers[iPipeBuffer].data)+pipeFilled,
+                                          frameBytes-pipeFilled);
+        if(nRead <= 0)
+            return;
+        pipeFilled += nRead;
+        if(pipeFilled == frameBytes) {
+            int index = iPipeBuffer;
+            iPipeBuffer = -1;
+            pipeFilled = 0;
+            publish(index, monotonicTime());
+        }
+    }
+}
+
+
+/*!
+ * \brief CameraIngest::startTestPattern Generate moving color bars
+ * \return true on success
+ */
+bool
+CameraIngest::startTestPattern() {
+    frameFormat  = QImage::Format_RGB32;
+    bytesPerLine = 4*frameSize.width();
+    if(!allocateBuffers(N_BUFFERS, size_t(bytesPerLine)*size_t(frameSize.height())))
+        return false;
+    iFrameCount = 0;
+    pPatternTimer = new QTimer(this);
+    pPatternTimer->setTimerType(Qt::PreciseTimer);
+    connect(pPatternTimer, SIGNAL(timeout()),
+            this, SLOT(onTestPatternTime()));
+    pPatternTimer->start(TEST_PATTERN_TIME);
+    return true;
+}
+
+
+/*!
+ * \brief CameraIngest::onTestPatternTime Draw a test frame in a free buffer
+ */
+void
+CameraIngest::onTestPatternTime() {
+    int index = takeFreeBuffer();
+    if(index < 0) {
+        nDropped.fetch_add(1, std::memory_order_relaxed);
+        return;
+    }
+    static const quint32 bars[8] = {
+        0xFFFFFFFF, 0xFFFFFF00, 0xFF00FFFF, 0xFF00FF00,
+        0xFFFF00FF, 0xFFFF0000, 0xFF0000FF, 0xFF000000
+    };
+    int w = frameSize.width();
+    int h = frameSize.height();
+    uchar* pData = buffers[index].data;
+    quint32* pFirstRow = reinterpret_cast<quint32*>(pData);
+    int shift = (iFrameCount*4) % w;
+    for(int x=0; x<w; x++)
+        pFirstRow[x] = bars[(((x+shift) % w) * 8) / w];
+    for(int y=1; y<h; y++)
+        memcpy(pData + y*bytesPerLine, pFirstRow, size_t(4*w));
+    // A bouncing square shows the motion smoothness
+    int side = h/8;
+    int period = 2*(h-side);
+    int top = (iFrameCount*8) % period;
+    if(top > h-side)
+        top = period - top;
+    for(int y=top; y<top+side; y++) {
+        quint32* pRow = reinterpret_cast<quint32*>(pData + y*bytesPerLine);
+        for(int x=(w-side)/2; x<(w+side)/2; x++)
+            pRow[x] = 0xFF808080;
+    }
+    iFrameCount++;
+    publish(index, monotonicTime());
+}
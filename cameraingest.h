@@ -0,0 +1,112 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QObject>
+#include <QImage>
+#include <QMutex>
+#include <QList>
+#include <QVector>
+#include <QTimer>
+#include <QProcess>
+#include <atomic>
+
+QT_FORWARD_DECLARE_CLASS(QSocketNotifier)
+
+
+class CameraIngest : public QObject
+{
+    Q_OBJECT
+
+public:
+    /*!
+     * \brief The frame sources
+     */
+    enum sourceType {
+        source_V4L2,/*!< A V4L2 capture device (e.g. /dev/video0) */
+        source_Pipe,/*!< Raw frames from an ffmpeg pipe (looped file) */
+        source_TestPattern/*!< Moving color bars */
+    };
+
+public:
+    explicit CameraIngest(QObject *parent = nullptr);
+    ~CameraIngest();
+    void setSource(sourceType newType, QString sNewSource, QSize newFrameSize);
+    QImage takeFrame(qint64* pCaptureTime);
+    qint64 droppedFrames() const;
+    static qint64 monotonicTime();
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void frameReady();
+    void ingestError(QString sError);
+
+private slots:
+    void requeueBuffers();
+    void onDeviceReadable();
+    void onTestPatternTime();
+    void onPipeReadyRead();
+
+private:
+    struct FrameBuffer {
+        uchar*        data;
+        size_t        length;
+        bool          isMapped;
+        int           index;
+        CameraIngest* owner;
+    };
+    static void releaseBuffer(void* pInfo);
+    bool allocateBuffers(int nBuffers, size_t length);
+    void freeBuffers();
+    bool startDevice();
+    void stopDevice();
+    bool startPipe();
+    bool startTestPattern();
+    int  takeFreeBuffer();
+    void publish(int index, qint64 captureTime);
+
+private:
+    sourceType           type;
+    QString              sSource;
+    QSize                frameSize;
+    QImage::Format       frameFormat;
+    int                  bytesPerLine;
+    QVector<FrameBuffer> buffers;
+
+    QMutex               freeMutex;
+    QList<int>           freeList;
+
+    QMutex               mailboxMutex;
+    QImage               mailbox;
+    qint64               mailboxTime;
+    std::atomic<qint64>  nDropped;
+
+    int                  deviceFd;
+    QSocketNotifier*     pDeviceNotifier;
+    QTimer*              pPatternTimer;
+    QProcess*            pPipeProcess;
+    int                  iPipeBuffer;
+    qint64               pipeFilled;
+    QByteArray           discardBuffer;
+    int                  iFrameCount;
+    bool                 bRunning;
+};
@@ -0,0 +1,190 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QCryptographicHash>
+#include <QDateTime>
+#include <QDir>
+#include <QDirIterator>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <cstdio>
+
+#include "chunkstore.h"
+
+
+/*!
+ * \brief ChunkStore::ChunkStore A content addressed store of file chunks
+ * \param sStoreDir Where the chunks are kept (default ~/.cache/VolleyPanel/chunks)
+ *
+ * Every chunk is saved in a file named after the SHA-256 of its content,
+ * so chunks survive a disconnection and are shared among files.
+ * The store may be used at the same time from different threads:
+ * every chunk is written to a temporary file and renamed.
+ */
+ChunkStore::ChunkStore(QString sStoreDir)
+    : sDir(sStoreDir)
+{
+    if(sDir.isEmpty())
+        sDir = QDir::homePath() + QString("/.cache/VolleyPanel/chunks");
+    if(!sDir.endsWith(QString("/")))
+        sDir += QString("/");
+    QDir().mkpath(sDir);
+}
+
+
+QByteArray
+ChunkStore::hash(const QByteArray& data) {
+    return QCryptographicHash::hash(data, QCryptographicHash::Sha256);
+}
+
+
+QString
+ChunkStore::chunkPath(const QByteArray& chunkHash) const {
+    QString sHex = QString::fromLatin1(chunkHash.toHex());
+    // Two levels keep the directories small
+    return sDir + sHex.left(2) + QString("/") + sHex;
+}
+
+
+bool
+ChunkStore::contains(const QByteArray& chunkHash) const {
+    if(chunkHash.size() != HASH_LENGTH)
+        return false;
+    return QFile::exists(chunkPath(chunkHash));
+}
+
+
+/*!
+ * \brief ChunkStore::store Save a chunk after checking its content
+ * \param chunkHash The expected SHA-256 of data
+ * \param data The chunk
+ * \return false if the data does not match its hash or can't be written
+ */
+bool
+ChunkStore::store(const QByteArray& chunkHash, const QByteArray& data) {
+    if(chunkHash.size() != HASH_LENGTH || hash(data) != chunkHash)
+        return false;
+    if(contains(chunkHash))
+        return true;
+    QString sPath = chunkPath(chunkHash);
+    QDir().mkpath(QFileInfo(sPath).absolutePath());
+    QSaveFile chunkFile(sPath);
+    if(!chunkFile.open(QIODevice::WriteOnly))
+        return false;
+    if(chunkFile.write(data) != data.size()) {
+        chunkFile.cancelWriting();
+        return false;
+    }
+    return chunkFile.commit();
+}
+
+
+QByteArray
+ChunkStore::read(const QByteArray& chunkHash) const {
+    QFile chunkFile(chunkPath(chunkHash));
+    if(!chunkFile.open(QIODevice::ReadOnly))
+        return QByteArray();
+    return chunkFile.readAll();
+}
+
+
+void
+ChunkStore::remove(const QByteArray& chunkHash) {
+    if(chunkHash.size() == HASH_LENGTH)
+        QFile::remove(chunkPath(chunkHash));
+}
+
+
+/*!
+ * \brief ChunkStore::prune Remove the chunks of the uploads never completed
+ * \param maxAgeSecs Chunks older than this are removed
+ *
+ * The chunks of the completed files are removed at once: only the ones
+ * of an interrupted upload that has not been resumed get this old.
+ */
+void
+ChunkStore::prune(qint64 maxAgeSecs) {
+    QDateTime oldest = QDateTime::currentDateTime().addSecs(-maxAgeSecs);
+    QDirIterator it(sDir, QDir::Files, QDirIterator::Subdirectories);
+    while(it.hasNext()) {
+        it.next();
+        if(it.fileInfo().lastModified() < oldest)
+            QFile::remove(it.filePath());
+    }
+}
+
+
+/*!
+ * \brief ChunkStore::assemble Rebuild a file from its chunks
+ * \param chunkHashes The chunks in file order
+ * \param expectedSize The file size
+ * \param sDestination The file to write
+ * \return true on success
+ *
+ * The file is written to a temporary file and renamed only when complete,
+ * so a reader never sees a partial file.
+ */
+bool
+ChunkStore::assemble(const QVector<QByteArray>& chunkHashes,
+                     qint64 expectedSize,
+                     QString sDestination) const
+{
+    QSaveFile destination(sDestination);
+    if(!destination.open(QIODevice::WriteOnly))
+        return false;
+    qint64 written = 0;
+    for(const QByteArray& chunkHash : chunkHashes) {
+        QByteArray data = read(chunkHash);
+        if(data.isEmpty() || hash(data) != chunkHash) {
+            destination.cancelWriting();
+            return false;
+        }
+        if(destination.write(data) != data.size()) {
+            destination.cancelWriting();
+            return false;
+        }
+        written += data.size();
+    }
+    if(written != expectedSize) {
+        destination.cancelWriting();
+        return false;
+    }
+    return destination.commit();
+}
+
+
+/*!
+ * \brief ChunkStore::replaceFile Move a file over another one
+ * \param sSource
+ * \param sDestination
+ * \return true on success
+ *
+ * On Linux the destination is replaced atomically: a reader sees either
+ * the old or the new file, never a missing or partial one.
+ */
+bool
+ChunkStore::replaceFile(QString sSource, QString sDestination) {
+#ifdef Q_OS_WINDOWS
+    QFile::remove(sDestination);
+    return QFile::rename(sSource, sDestination);
+#else
+    return std::rename(QFile::encodeName(sSource).constData(),
+                       QFile::encodeName(sDestination).constData()) == 0;
+#endif
+}
@@ -0,0 +1,49 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QString>
+#include <QByteArray>
+#include <QVector>
+
+
+#define HASH_LENGTH 32 // SHA-256
+
+
+class ChunkStore
+{
+public:
+    explicit ChunkStore(QString sStoreDir = QString());
+    static QByteArray hash(const QByteArray& data);
+    bool contains(const QByteArray& chunkHash) const;
+    bool store(const QByteArray& chunkHash, const QByteArray& data);
+    QByteArray read(const QByteArray& chunkHash) const;
+    void remove(const QByteArray& chunkHash);
+    void prune(qint64 maxAgeSecs);
+    bool assemble(const QVector<QByteArray>& chunkHashes,
+                  qint64 expectedSize,
+                  QString sDestination) const;
+    static bool replaceFile(QString sSource, QString sDestination);
+
+private:
+    QString chunkPath(const QByteArray& chunkHash) const;
+
+private:
+    QString sDir;
+};
@@ -0,0 +1,145 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QElapsedTimer>
+#include <QStringList>
+
+#include "clocksync.h"
+
+
+#define MAX_SAMPLES     8       // Samples kept for the minimum round trip filter
+#define MAX_ROUND_TRIP  500000  // Samples slower than this (usec) are discarded
+
+
+/*!
+ * \brief ClockSync::ClockSync NTP-like estimate of the controller clock offset
+ *
+ * The panel sends <timeSync>t0</timeSync> and the controller answers
+ * with <timeSyncReply>t0,t1,t2</timeSyncReply> where t1 and t2 are the
+ * controller times (usec) of reception and answer. With t3 the local
+ * time of reception:
+ *     offset    = ((t1-t0) + (t2-t3)) / 2
+ *     roundTrip = (t3-t0) - (t2-t1)
+ * The offset of the sample with the smallest round trip among the last
+ * MAX_SAMPLES is used, since it is the one least affected by queuing.
+ */
+ClockSync::ClockSync()
+    : iBest(-1)
+{
+}
+
+
+/*!
+ * \brief ClockSync::localTime
+ * \return The local monotonic time in usec
+ */
+qint64
+ClockSync::localTime() {
+    // Used by the network and the GUI threads: started only once
+    static const QElapsedTimer clock = []() {
+        QElapsedTimer timer;
+        timer.start();
+        return timer;
+    }();
+    return clock.nsecsElapsed()/1000;
+}
+
+
+/*!
+ * \brief ClockSync::request
+ * \return The message asking the controller its time
+ */
+QString
+ClockSync::request() {
+    return QString("<timeSync>%1</timeSync>").arg(localTime());
+}
+
+
+/*!
+ * \brief ClockSync::processReply Add a new offset sample
+ * \param sReply The content of the <timeSyncReply> tag
+ * \param receiveTime The local time at which the reply was received
+ * \return true if the sample has been accepted
+ */
+bool
+ClockSync::processReply(QString sReply, qint64 receiveTime) {
+    QStringList sTimes = sReply.split(QChar(','));
+    if(sTimes.count() != 3)
+        return false;
+    bool ok0, ok1, ok2;
+    qint64 t0 = sTimes.at(0).toLongLong(&ok0);
+    qint64 t1 = sTimes.at(1).toLongLong(&ok1);
+    qint64 t2 = sTimes.at(2).toLongLong(&ok2);
+    qint64 t3 = receiveTime;
+    if(!ok0 || !ok1 || !ok2 || t0 > t3)
+        return false;
+    Sample sample;
+    sample.roundTrip = (t3-t0) - (t2-t1);
+    sample.offset    = ((t1-t0) + (t2-t3)) / 2;
+    if(sample.roundTrip < 0 || sample.roundTrip > MAX_ROUND_TRIP)
+        return false;
+
+    if(samples.count() == MAX_SAMPLES)
+        samples.removeFirst();
+    samples.append(sample);
+    iBest = 0;
+    for(int i=1; i<samples.count(); i++) {
+        if(samples.at(i).roundTrip < samples.at(iBest).roundTrip)
+            iBest = i;
+    }
+    return true;
+}
+
+
+void
+ClockSync::reset() {
+    samples.clear();
+    iBest = -1;
+}
+
+
+bool
+ClockSync::isValid() const {
+    return iBest >= 0;
+}
+
+
+qint64
+ClockSync::offset() const {
+    return isValid() ? samples.at(iBest).offset : 0;
+}
+
+
+qint64
+ClockSync::roundTrip() const {
+    return isValid() ? samples.at(iBest).roundTrip : -1;
+}
+
+
+/*!
+ * \brief ClockSync::toLocalDeadline Convert a controller time into a local deadline
+ * \param remoteTime An absolute controller time (usec)
+ * \return The deadline on the local monotonic clock
+ */
+QDeadlineTimer
+ClockSync::toLocalDeadline(qint64 remoteTime) const {
+    qint64 remaining = (remoteTime - offset()) - localTime();
+    QDeadlineTimer deadline(Qt::PreciseTimer);
+    deadline.setPreciseRemainingTime(0, qMax(qint64(0), remaining)*1000, Qt::PreciseTimer);
+    return deadline;
+}
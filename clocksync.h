@@ -0,0 +1,49 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QDeadlineTimer>
+#include <QMetaType>
+
+
+class ClockSync
+{
+public:
+    ClockSync();
+    static qint64 localTime();
+    QString request();
+    bool processReply(QString sReply, qint64 receiveTime);
+    void reset();
+    bool isValid() const;
+    qint64 offset() const;
+    qint64 roundTrip() const;
+    QDeadlineTimer toLocalDeadline(qint64 remoteTime) const;
+
+private:
+    struct Sample {
+        qint64 offset;    // Controller clock - local clock (usec)
+        qint64 roundTrip; // Network round trip (usec)
+    };
+    QVector<Sample> samples;
+    int             iBest;
+};
+
+Q_DECLARE_METATYPE(ClockSync)
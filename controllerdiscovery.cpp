@@ -0,0 +1,250 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QNetworkDatagram>
+#include <QUdpSocket>
+
+#include "controllerdiscovery.h"
+#include "clocksync.h"
+#include "protocol.h"
+
+
+#define ANNOUNCE_TIMEOUT  5000000  // usec without announcements to forget a controller
+#define FAILURE_PENALTY  10000000  // usec a failed controller is not used (if others exist)
+#define EXPIRE_CHECK         1000  // msec
+
+
+/*!
+ * \brief ControllerDiscovery::ControllerDiscovery The controllers that can drive the Panel
+ * \param parent
+ *
+ * The controllers announce themselves (broadcast, multicast or unicast)
+ * with <controller>WebSocket port</controller>. Each announcement is
+ * answered with <discoveryProbe>t0</discoveryProbe> to its sender, that
+ * echoes <discoveryReply>t0</discoveryReply>: the controllers are ranked
+ * by the (smoothed) round trip time of these probes.
+ */
+ControllerDiscovery::ControllerDiscovery(QObject *parent)
+    : QObject(parent)
+    , pSocket(nullptr)
+{
+    connect(&expireTimer, SIGNAL(timeout()),
+            this, SLOT(onExpireTime()));
+    expireTimer.start(EXPIRE_CHECK);
+}
+
+
+/*!
+ * \brief ControllerDiscovery::listen Start to receive the announcements
+ * \param port The UDP port of the announcements
+ * \param group A multicast group to join (a null address for broadcast only)
+ */
+bool
+ControllerDiscovery::listen(quint16 port, const QHostAddress& group) {
+    pSocket = new QUdpSocket(this);
+    if(!pSocket->bind(QHostAddress::AnyIPv4, port,
+                      QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint))
+        return false;
+    if(!group.isNull())
+        pSocket->joinMulticastGroup(group);
+    connect(pSocket, SIGNAL(readyRead()),
+            this, SLOT(onReadyRead()));
+    return true;
+}
+
+
+/*!
+ * \brief ControllerDiscovery::addStatic The configured controller (the first choice while it works)
+ */
+void
+ControllerDiscovery::addStatic(const QUrl& url) {
+    if(find(url) >= 0)
+        return;
+    controllers.append(Controller{url, QHostAddress(), 0, -1, 0, 0, true});
+}
+
+
+int
+ControllerDiscovery::find(const QUrl& url) const {
+    for(int i=0; i<controllers.count(); i++) {
+        if(controllers.at(i).url == url)
+            return i;
+    }
+    return -1;
+}
+
+
+void
+ControllerDiscovery::onReadyRead() {
+    while(pSocket->hasPendingDatagrams()) {
+        QNetworkDatagram datagram = pSocket->receiveDatagram();
+        ProtocolMessage message;
+        message.parse(QString::fromUtf8(datagram.data()));
+        qint64 now = ClockSync::localTime();
+
+        if(message.has(Protocol::Tag::Controller)) {
+            QHostAddress sender(datagram.senderAddress().toIPv4Address());
+            quint16 senderPort = quint16(datagram.senderPort());
+            QUrl url;
+            url.setScheme(QString("ws"));
+            url.setHost(sender.toString());
+            url.setPort(int(message.number(Protocol::Tag::Controller)));
+            int i = find(url);
+            if(i < 0) {
+                // Announced only when its round trip is known: the
+                // first announcer is not necessarily the fastest one
+                controllers.append(Controller{url, sender, senderPort, -1, now, 0, false});
+            }
+            else {
+                bool bWasUsable = isUsable(controllers.at(i), now);
+                controllers[i].address      = sender;
+                controllers[i].announcePort = senderPort;
+                controllers[i].lastSeen     = now;
+                if(!bWasUsable && controllers.at(i).roundTrip >= 0 &&
+                   isUsable(controllers.at(i), now))
+                    emit controllerFound(url);
+            }
+            probe(datagram.senderAddress(), quint16(datagram.senderPort()));
+        }
+
+        if(message.has(Protocol::Tag::DiscoveryReply)) {
+            qint64 roundTrip = now - message.number(Protocol::Tag::DiscoveryReply);
+            if(roundTrip < 0)
+                continue;
+            QHostAddress sender(datagram.senderAddress().toIPv4Address());
+            for(Controller& controller : controllers) {
+                if(controller.bStatic ||
+                   controller.address != sender ||
+                   controller.announcePort != datagram.senderPort())
+                    continue;
+                if(controller.roundTrip < 0) {
+                    controller.roundTrip = roundTrip;
+                    if(isUsable(controller, now))
+                        emit controllerFound(controller.url);
+                    continue;
+                }
+                controller.roundTrip = (7*controller.roundTrip + roundTrip)/8;
+            }
+        }
+    }
+}
+
+
+void
+ControllerDiscovery::probe(const QHostAddress& address, quint16 port) {
+    QByteArray baProbe = Protocol::serialize<Protocol::Tag::DiscoveryProbe>(ClockSync::localTime()).toString().toLatin1();
+    pSocket->writeDatagram(baProbe, address, port);
+}
+
+
+void
+ControllerDiscovery::onExpireTime() {
+    qint64 now = ClockSync::localTime();
+    for(int i=controllers.count()-1; i>=0; i--) {
+        const Controller& controller = controllers.at(i);
+        if(!controller.bStatic && now-controller.lastSeen > ANNOUNCE_TIMEOUT)
+            controllers.removeAt(i);
+    }
+}
+
+
+bool
+ControllerDiscovery::isUsable(const Controller& controller, qint64 now) const {
+    return controller.failedUntil <= now &&
+           (controller.bStatic || now-controller.lastSeen <= ANNOUNCE_TIMEOUT);
+}
+
+
+/*!
+ * \brief ControllerDiscovery::isBetter The ranking
+ *
+ * The configured controller comes first while it works: any host of
+ * the LAN can announce itself and must not take over the Panel. The
+ * announced ones are the standby: the measured round trips come first,
+ * the fastest first.
+ */
+bool
+ControllerDiscovery::isBetter(const Controller& a, const Controller& b) const {
+    if(a.bStatic != b.bStatic)
+        return a.bStatic;
+    if((a.roundTrip < 0) != (b.roundTrip < 0))
+        return a.roundTrip >= 0;
+    return a.roundTrip < b.roundTrip;
+}
+
+
+/*!
+ * \brief ControllerDiscovery::best
+ * \return The best usable controller. If all of them failed recently the
+ * best one anyway: retrying is better than waiting.
+ */
+QUrl
+ControllerDiscovery::best() const {
+    qint64 now = ClockSync::localTime();
+    int iBest = -1;
+    int iBestFailed = -1;
+    for(int i=0; i<controllers.count(); i++) {
+        const Controller& controller = controllers.at(i);
+        int& iCandidate = isUsable(controller, now) ? iBest : iBestFailed;
+        if(iCandidate < 0 || isBetter(controller, controllers.at(iCandidate)))
+            iCandidate = i;
+    }
+    if(iBest < 0)
+        iBest = iBestFailed;
+    return (iBest < 0) ? QUrl() : controllers.at(iBest).url;
+}
+
+
+/*!
+ * \brief ControllerDiscovery::hasAlternative
+ * \return true if a usable controller other than current is known
+ */
+bool
+ControllerDiscovery::hasAlternative(const QUrl& current) const {
+    qint64 now = ClockSync::localTime();
+    for(const Controller& controller : controllers) {
+        if(controller.url != current && isUsable(controller, now))
+            return true;
+    }
+    return false;
+}
+
+
+void
+ControllerDiscovery::setFailed(const QUrl& url) {
+    int i = find(url);
+    if(i >= 0)
+        controllers[i].failedUntil = ClockSync::localTime() + FAILURE_PENALTY;
+}
+
+
+/*!
+ * \brief ControllerDiscovery::description
+ * \return The ranked controllers, for the log
+ */
+QString
+ControllerDiscovery::description() const {
+    QStringList sControllers;
+    for(const Controller& controller : controllers) {
+        sControllers.append(QString("%1 (rtt %2 us%3)")
+                            .arg(controller.url.toString())
+                            .arg(controller.roundTrip)
+                            .arg(controller.bStatic ? QString(", static") : QString()));
+    }
+    return sControllers.join(QString(", "));
+}
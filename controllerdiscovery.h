@@ -0,0 +1,69 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QObject>
+#include <QHostAddress>
+#include <QTimer>
+#include <QUrl>
+#include <QVector>
+
+QT_FORWARD_DECLARE_CLASS(QUdpSocket)
+
+
+class ControllerDiscovery : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit ControllerDiscovery(QObject *parent = nullptr);
+    bool listen(quint16 port, const QHostAddress& group);
+    void addStatic(const QUrl& url);
+    QUrl best() const;
+    bool hasAlternative(const QUrl& current) const;
+    void setFailed(const QUrl& url);
+    QString description() const;
+
+signals:
+    void controllerFound(QUrl url);
+
+private slots:
+    void onReadyRead();
+    void onExpireTime();
+
+private:
+    struct Controller {
+        QUrl         url;
+        QHostAddress address;      // Sender of the announcements
+        quint16      announcePort; // and its port (answering the probes)
+        qint64       roundTrip;    // usec, -1 if not yet measured
+        qint64       lastSeen;     // Local time (usec) of the last announcement
+        qint64       failedUntil;  // Not used before this local time (usec)
+        bool         bStatic;      // Configured, not announced
+    };
+    int  find(const QUrl& url) const;
+    bool isUsable(const Controller& controller, qint64 now) const;
+    bool isBetter(const Controller& a, const Controller& b) const;
+    void probe(const QHostAddress& address, quint16 port);
+
+private:
+    QUdpSocket*         pSocket;
+    QTimer              expireTimer;
+    QVector<Controller> controllers;
+};
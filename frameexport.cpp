@@ -0,0 +1,324 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QWidget>
+#include <QPainter>
+#include <cstring>
+#include <new>
+
+#ifdef Q_OS_UNIX
+    #include <fcntl.h>
+    #include <sys/mman.h>
+    #include <time.h>
+    #include <unistd.h>
+#endif
+
+#include "frameexport.h"
+#include "metrics.h"
+
+
+#define READER_TIMEOUT 2000 // msec without a reader heartbeat: nobody is reading
+#define READER_CHECK   500  // msec between two checks of the heartbeat
+
+
+namespace {
+
+qint64
+monotonicUsec() {
+#ifdef Q_OS_UNIX
+    struct timespec now;
+    clock_gettime(CLOCK_MONOTONIC, &now);
+    return qint64(now.tv_sec)*1000000 + now.tv_nsec/1000;
+#else
+    return 0;
+#endif
+}
+
+} // namespace
+
+
+/*!
+ * \brief FrameExport::FrameExport Publishes the rendered Panel in shared memory
+ * \param parent
+ *
+ * Local consumers (an OBS source, ffmpeg, ...) read the frames in place
+ * from a POSIX shared memory ring instead of capturing the screen.
+ * Nothing is rendered while no reader is attached.
+ */
+FrameExport::FrameExport(QObject *parent)
+    : QObject(parent)
+    , pHeader(nullptr)
+    , mapSize(0)
+    , frame(0)
+    , bReaderAttached(false)
+    , bFullFrame(true)
+    , bOpaque(false)
+{
+    connect(&readerTimer, SIGNAL(timeout()),
+            this, SLOT(onCheckReader()));
+}
+
+
+FrameExport::~FrameExport() {
+#ifdef Q_OS_UNIX
+    if(pHeader) {
+        munmap(pHeader, mapSize);
+        shm_unlink(sShmName.toLocal8Bit().constData());
+    }
+#endif
+}
+
+
+/*!
+ * \brief FrameExport::open Creates the shared memory segment
+ * \param sName The POSIX name (e.g. "/volleypanel")
+ * \param size The size of the frames
+ * \return false if the segment cannot be created
+ */
+bool
+FrameExport::open(QString sName, QSize size) {
+#ifdef Q_OS_UNIX
+    if(pHeader || size.isEmpty())
+        return false;
+    sShmName = sName;
+    quint32 stride     = quint32(size.width())*4;
+    quint32 dataOffset = quint32((sizeof(FrameExportHeader)+63) & ~size_t(63));
+    mapSize = dataOffset + size_t(FRAME_EXPORT_BUFFERS)*stride*quint32(size.height());
+
+    QByteArray baName = sShmName.toLocal8Bit();
+    int fd = shm_open(baName.constData(), O_CREAT|O_RDWR, 0644);
+    if(fd < 0)
+        return false;
+    if(ftruncate(fd, off_t(mapSize)) != 0) {
+        ::close(fd);
+        shm_unlink(baName.constData());
+        return false;
+    }
+    void* pMap = mmap(nullptr, mapSize, PROT_READ|PROT_WRITE, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(pMap == MAP_FAILED) {
+        shm_unlink(baName.constData());
+        return false;
+    }
+    std::memset(pMap, 0, dataOffset);
+    pHeader = new(pMap) FrameExportHeader;
+    pHeader->version    = FRAME_EXPORT_VERSION;
+    pHeader->width      = quint32(size.width());
+    pHeader->height     = quint32(size.height());
+    pHeader->stride     = stride;
+    pHeader->format     = quint32(QImage::Format_ARGB32_Premultiplied);
+    pHeader->nBuffers   = FRAME_EXPORT_BUFFERS;
+    pHeader->dataOffset = dataOffset;
+    for(int i=0; i<FRAME_EXPORT_BUFFERS; i++)
+        pHeader->slot[i].sequence.store(0, std::memory_order_relaxed);
+    pHeader->latest.store(0, std::memory_order_relaxed);
+    pHeader->readerHeartbeat.store(0, std::memory_order_relaxed);
+    // The readers check the magic last
+    std::atomic_thread_fence(std::memory_order_release);
+    pHeader->magic = FRAME_EXPORT_MAGIC;
+    readerTimer.start(READER_CHECK);
+    return true;
+#else
+    Q_UNUSED(sName)
+    Q_UNUSED(size)
+    return false;
+#endif
+}
+
+
+/*!
+ * \brief FrameExport::isReaderAttached
+ * \return true if a reader has shown a sign of life recently
+ */
+bool
+FrameExport::isReaderAttached() const {
+    if(!pHeader)
+        return false;
+    qint64 heartbeat = pHeader->readerHeartbeat.load(std::memory_order_relaxed);
+    return heartbeat > 0 && monotonicUsec()/1000-heartbeat < READER_TIMEOUT;
+}
+
+
+/*!
+ * \brief FrameExport::onCheckReader A new reader needs a complete frame at once
+ */
+void
+FrameExport::onCheckReader() {
+    bool bAttached = isReaderAttached();
+    if(bAttached && !bReaderAttached) {
+        bFullFrame = true;
+        emit readerAttached();
+    }
+    bReaderAttached = bAttached;
+}
+
+
+/*!
+ * \brief FrameExport::publish Renders a widget (and its children) in the next buffer
+ * \param pWidget
+ *
+ * \return false if nothing has been rendered (no reader)
+ *
+ * The widget is painted directly in shared memory, with its window
+ * background: the frame is the one on the screen.
+ */
+bool
+FrameExport::publish(QWidget* pWidget) {
+    if(!isReaderAttached())
+        return false;
+    QImage target = beginFrame();
+    target.fill(Qt::transparent);
+    pWidget->render(&target); // DrawWindowBackground | DrawChildren
+    endFrame();
+    bOpaque = true;
+    return true;
+}
+
+
+/*!
+ * \brief FrameExport::publish Copies an image (e.g. the score overlay) in the next buffer
+ * \param image
+ *
+ * \return false if nothing has been copied (no reader)
+ *
+ * The transparent pixels are kept: the consumer gets the alpha channel.
+ */
+bool
+FrameExport::publish(const QImage& image) {
+    if(!isReaderAttached())
+        return false;
+    QImage target = beginFrame();
+    target.fill(Qt::transparent);
+    QPainter painter(&target);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.drawImage(0, 0, image);
+    painter.end();
+    endFrame();
+    bOpaque = false;
+    return true;
+}
+
+
+/*!
+ * \brief FrameExport::copyLatest Copies the last published frame
+ * \param destination A 32 bit image of the frame size
+ * \return false if there is no frame, the sizes differ or the frame is not opaque
+ *
+ * Cheaper than rendering the widget again. Only a widget frame, painted
+ * on its window background, is opaque: it has the same pixels in
+ * ARGB32_Premultiplied and in RGB32. The transparent pixels of an
+ * overlay would turn black.
+ */
+bool
+FrameExport::copyLatest(QImage& destination) const {
+    if(!pHeader || frame == 0 || !bOpaque ||
+       destination.depth() != 32 ||
+       destination.size() != QSize(int(pHeader->width), int(pHeader->height)))
+        return false;
+    const uchar* pSource = buffer(int(frame % FRAME_EXPORT_BUFFERS));
+    const size_t lineBytes = size_t(pHeader->width)*4;
+    for(int y=0; y<int(pHeader->height); y++)
+        std::memcpy(destination.scanLine(y), pSource + size_t(y)*pHeader->stride, lineBytes);
+    return true;
+}
+
+
+uchar*
+FrameExport::buffer(int iBuffer) const {
+    return reinterpret_cast<uchar*>(pHeader) + pHeader->dataOffset +
+           size_t(iBuffer)*pHeader->stride*pHeader->height;
+}
+
+
+/*!
+ * \brief FrameExport::beginFrame Opens the write of the next buffer of the ring
+ * \return An image over the shared memory
+ */
+QImage
+FrameExport::beginFrame() {
+    int iBuffer = int((frame+1) % FRAME_EXPORT_BUFFERS);
+    pHeader->slot[iBuffer].sequence.fetch_add(1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    return QImage(buffer(iBuffer),
+                  int(pHeader->width),
+                  int(pHeader->height),
+                  int(pHeader->stride),
+                  QImage::Format_ARGB32_Premultiplied);
+}
+
+
+/*!
+ * \brief FrameExport::endFrame Closes the write and makes the frame the latest one
+ */
+void
+FrameExport::endFrame() {
+    quint64 previous = frame;
+    frame++;
+    int iBuffer = int(frame % FRAME_EXPORT_BUFFERS);
+    FrameExportSlot& slot = pHeader->slot[iBuffer];
+    QRect dirty(0, 0, int(pHeader->width), int(pHeader->height));
+    if(previous > 0 && !bFullFrame)
+        dirty = changedRect(buffer(int(previous % FRAME_EXPORT_BUFFERS)), buffer(iBuffer));
+    slot.frame       = frame;
+    slot.timestamp   = monotonicUsec();
+    slot.dirtyX      = dirty.x();
+    slot.dirtyY      = dirty.y();
+    slot.dirtyWidth  = dirty.width();
+    slot.dirtyHeight = dirty.height();
+    bFullFrame = false;
+    slot.sequence.fetch_add(1, std::memory_order_release);
+    pHeader->latest.store(frame, std::memory_order_release);
+    Metrics::exportedFrames.add();
+}
+
+
+/*!
+ * \brief FrameExport::changedRect The bounding box of the pixels changed since the previous frame
+ * \return An empty rectangle if nothing changed
+ *
+ * The unchanged lines are skipped with a memcmp: usually only the
+ * score digits differ.
+ */
+QRect
+FrameExport::changedRect(const uchar* pPrevious, const uchar* pCurrent) const {
+    const int width  = int(pHeader->width);
+    const int height = int(pHeader->height);
+    const size_t stride = pHeader->stride;
+    int top = -1, bottom = -1;
+    int left = width, right = -1;
+    for(int y=0; y<height; y++) {
+        const quint32* pOld = reinterpret_cast<const quint32*>(pPrevious + y*stride);
+        const quint32* pNew = reinterpret_cast<const quint32*>(pCurrent  + y*stride);
+        if(std::memcmp(pOld, pNew, size_t(width)*4) == 0)
+            continue;
+        if(top < 0)
+            top = y;
+        bottom = y;
+        int x = 0;
+        while(x < left && pOld[x] == pNew[x])
+            x++;
+        left = x;
+        x = width-1;
+        while(x > right && pOld[x] == pNew[x])
+            x--;
+        right = x;
+    }
+    if(top < 0)
+        return QRect();
+    return QRect(QPoint(left, top), QPoint(right, bottom));
+}
@@ -0,0 +1,111 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QObject>
+#include <QImage>
+#include <QTimer>
+#include <atomic>
+
+QT_FORWARD_DECLARE_CLASS(QWidget)
+
+
+#define FRAME_EXPORT_MAGIC   0x56504658 // "VPFX"
+#define FRAME_EXPORT_VERSION 1
+#define FRAME_EXPORT_BUFFERS 3
+
+
+/*!
+ * \brief One buffer of the ring, as seen by the readers
+ *
+ * The dirty rectangle is relative to the previous frame: a reader that
+ * skipped some frame has to read the whole buffer.
+ */
+struct FrameExportSlot {
+    std::atomic<quint32> sequence;  /*!< Seqlock: odd while the buffer is written */
+    quint32              reserved;
+    quint64              frame;     /*!< Frame number */
+    qint64               timestamp; /*!< usec, CLOCK_MONOTONIC */
+    qint32               dirtyX;
+    qint32               dirtyY;
+    qint32               dirtyWidth;
+    qint32               dirtyHeight;
+};
+
+
+/*!
+ * \brief The header of the shared memory segment
+ *
+ * The buffers (premultiplied ARGB32, stride bytes per line) follow at
+ * dataOffset. The last complete frame is in buffer latest % nBuffers.
+ * A reader:
+ *  - writes its CLOCK_MONOTONIC msec in readerHeartbeat at least once a second
+ *  - reads sequence (retrying while odd), uses the pixels in place and
+ *    reads sequence again: if it changed the frame has been overwritten.
+ */
+struct FrameExportHeader {
+    quint32              magic;
+    quint32              version;
+    quint32              width;
+    quint32              height;
+    quint32              stride;
+    quint32              format;     /*!< QImage::Format */
+    quint32              nBuffers;
+    quint32              dataOffset;
+    std::atomic<quint64> latest;
+    std::atomic<qint64>  readerHeartbeat;
+    FrameExportSlot      slot[FRAME_EXPORT_BUFFERS];
+};
+
+
+class FrameExport : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FrameExport(QObject *parent = nullptr);
+    ~FrameExport();
+    bool open(QString sName, QSize size);
+    bool isReaderAttached() const;
+    bool publish(QWidget* pWidget);
+    bool publish(const QImage& image);
+    bool copyLatest(QImage& destination) const;
+
+signals:
+    void readerAttached();
+
+private slots:
+    void onCheckReader();
+
+private:
+    QImage beginFrame();
+    void   endFrame();
+    QRect  changedRect(const uchar* pPrevious, const uchar* pCurrent) const;
+    uchar* buffer(int iBuffer) const;
+
+private:
+    QString            sShmName;
+    FrameExportHeader* pHeader;
+    size_t             mapSize;
+    quint64            frame;
+    QTimer             readerTimer;
+    bool               bReaderAttached;
+    bool               bFullFrame; // The next frame is entirely dirty
+    bool               bOpaque;    // The latest frame has no transparent pixel
+};
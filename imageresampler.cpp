@@ -0,0 +1,327 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QThread>
+#include <QThreadPool>
+#include <QRunnable>
+#include <QSemaphore>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#include "imageresampler.h"
+
+
+#define MIN_BAND_COST 65536 // Below this many source samples a band is not worth a thread
+
+
+// The inner loops work on a whole pixel (the four 8 bit channels) at once.
+// With GCC and Clang the vector extensions map to NEON on the Raspberry
+// and to SSE on x86; other compilers get the plain scalar loop.
+#if defined(__GNUC__)
+    #define RESAMPLER_SIMD
+    typedef float v4sf __attribute__((vector_size(16)));
+#endif
+
+
+namespace {
+
+class BandJob : public QRunnable
+{
+public:
+    BandJob(const std::function<void(int, int)>& job, int iFirst, int iLast, QSemaphore* pDone)
+        : myJob(job)
+        , first(iFirst)
+        , last(iLast)
+        , pDoneSemaphore(pDone)
+    {
+        setAutoDelete(true);
+    }
+    void run() {
+        myJob(first, last);
+        pDoneSemaphore->release();
+    }
+
+private:
+    const std::function<void(int, int)>& myJob;
+    int first;
+    int last;
+    QSemaphore* pDoneSemaphore;
+};
+
+
+inline uchar
+clampChannel(float c) {
+    c += 0.5f;
+    return c <= 0.0f ? 0 : (c >= 255.0f ? 255 : uchar(c));
+}
+
+
+#ifdef RESAMPLER_SIMD
+inline v4sf
+loadPixel(const uchar* p) {
+    v4sf v = { float(p[0]), float(p[1]), float(p[2]), float(p[3]) };
+    return v;
+}
+
+
+inline void
+storePixel(uchar* p, v4sf v) {
+    for(int i=0; i<4; i++)
+        p[i] = clampChannel(v[i]);
+}
+#endif
+
+
+} // namespace
+
+
+/*!
+ * \brief ImageResampler::scaled A high quality replacement for QImage::scaled()
+ * \param source The image to resample
+ * \param newSize The requested size
+ * \param aspectMode As in QImage::scaled()
+ * \return The resampled image in QImage::Format_ARGB32_Premultiplied
+ *
+ * The image is resampled separately along the two directions: area averaging
+ * is used when shrinking and linear interpolation when enlarging.
+ * Every pass is split in row bands executed in the global thread pool.
+ */
+QImage
+ImageResampler::scaled(const QImage& source,
+                       const QSize& newSize,
+                       Qt::AspectRatioMode aspectMode)
+{
+    if(source.isNull() || newSize.isEmpty())
+        return QImage();
+    QSize dstSize = source.size().scaled(newSize, aspectMode);
+    if(dstSize.isEmpty())
+        return QImage();
+
+    // Averaging is correct only on premultiplied colors
+    QImage srcImage = source.convertToFormat(QImage::Format_ARGB32_Premultiplied);
+    if(dstSize == srcImage.size())
+        return srcImage;
+
+    // Execute first the pass that produces the smaller intermediate image
+    QImage tmpImage;
+    QImage dstImage(dstSize, QImage::Format_ARGB32_Premultiplied);
+    qint64 horizontalFirst = qint64(dstSize.width()) * srcImage.height();
+    qint64 verticalFirst   = qint64(srcImage.width()) * dstSize.height();
+    if(horizontalFirst <= verticalFirst) {
+        tmpImage = QImage(dstSize.width(), srcImage.height(), QImage::Format_ARGB32_Premultiplied);
+        horizontalPass(srcImage, tmpImage);
+        verticalPass(tmpImage, dstImage);
+    }
+    else {
+        tmpImage = QImage(srcImage.width(), dstSize.height(), QImage::Format_ARGB32_Premultiplied);
+        verticalPass(srcImage, tmpImage);
+        horizontalPass(tmpImage, dstImage);
+    }
+    return dstImage;
+}
+
+
+/*!
+ * \brief ImageResampler::forEachBand Split a job in row bands executed in parallel
+ * \param iRows Total number of rows
+ * \param iRowCost Approximate number of samples read for each row
+ * \param job The function to execute on the rows [first, last)
+ *
+ * The calling thread executes one of the bands and returns only when all
+ * the bands have been completed. If the thread pool is busy the remaining
+ * bands are executed by the calling thread too.
+ */
+void
+ImageResampler::forEachBand(int iRows,
+                            int iRowCost,
+                            const std::function<void(int, int)>& job)
+{
+    if(iRows <= 0)
+        return;
+    int nBands = qMax(1, QThread::idealThreadCount());
+    qint64 maxBands = (qint64(iRows) * qMax(1, iRowCost)) / MIN_BAND_COST;
+    nBands = int(qBound(qint64(1), maxBands, qint64(qMin(nBands, iRows))));
+    if(nBands == 1) {
+        job(0, iRows);
+        return;
+    }
+
+    QSemaphore doneSemaphore;
+    int nStarted = 0;
+    int bandRows = (iRows + nBands - 1) / nBands;
+    for(int first=bandRows; first<iRows; first+=bandRows) {
+        int last = qMin(first+bandRows, iRows);
+        BandJob* pJob = new BandJob(job, first, last, &doneSemaphore);
+        if(QThreadPool::globalInstance()->tryStart(pJob)) {
+            nStarted++;
+        }
+        else {
+            delete pJob;
+            job(first, last);
+        }
+    }
+    job(0, qMin(bandRows, iRows));
+    doneSemaphore.acquire(nStarted);
+}
+
+
+/*!
+ * \brief ImageResampler::computeContributions Filter weights along one direction
+ * \param srcLength Source length in pixels
+ * \param dstLength Destination length in pixels
+ * \param contributions [out] The source pixels contributing to each destination pixel
+ * \param weights [out] The normalized weights
+ */
+void
+ImageResampler::computeContributions(int srcLength,
+                                     int dstLength,
+                                     QVector<Contribution>& contributions,
+                                     QVector<float>& weights)
+{
+    contributions.resize(dstLength);
+    weights.clear();
+    double ratio = double(srcLength) / double(dstLength);
+    for(int i=0; i<dstLength; i++) {
+        Contribution& c = contributions[i];
+        c.weight = weights.count();
+        if(dstLength < srcLength) { // Area averaging
+            double left  = i * ratio;
+            double right = (i+1) * ratio;
+            c.first = int(std::floor(left));
+            int last = qMin(int(std::ceil(right)), srcLength) - 1;
+            c.count = last - c.first + 1;
+            for(int j=c.first; j<=last; j++)
+                weights.append(float((qMin(right, double(j+1)) - qMax(left, double(j))) / ratio));
+        }
+        else { // Linear interpolation
+            double center = (i+0.5) * ratio - 0.5;
+            int j0 = int(std::floor(center));
+            float fraction = float(center - j0);
+            if(j0 < 0) {
+                c.first = 0;
+                c.count = 1;
+                weights.append(1.0f);
+            }
+            else if(j0 >= srcLength-1) {
+                c.first = srcLength-1;
+                c.count = 1;
+                weights.append(1.0f);
+            }
+            else {
+                c.first = j0;
+                c.count = 2;
+                weights.append(1.0f-fraction);
+                weights.append(fraction);
+            }
+        }
+    }
+}
+
+
+/*!
+ * \brief ImageResampler::horizontalPass Resample the rows of the image
+ * \param source The source image
+ * \param destination An image as high as source with the final width
+ */
+void
+ImageResampler::horizontalPass(const QImage& source, QImage& destination) {
+    QVector<Contribution> contributions;
+    QVector<float> weights;
+    computeContributions(source.width(), destination.width(), contributions, weights);
+    const Contribution* pContributions = contributions.constData();
+    const float* pWeights = weights.constData();
+    int dstWidth = destination.width();
+    int srcWidth = source.width();
+    uchar* pDstBits = destination.bits();
+    qsizetype dstStride = destination.bytesPerLine();
+
+    forEachBand(destination.height(), srcWidth, [&](int first, int last) {
+        for(int y=first; y<last; y++) {
+            const uchar* pSrc = source.constScanLine(y);
+            uchar* pDst = pDstBits + y*dstStride;
+            for(int x=0; x<dstWidth; x++) {
+                const Contribution& c = pContributions[x];
+                const uchar* p = pSrc + 4*c.first;
+                const float* w = pWeights + c.weight;
+#ifdef RESAMPLER_SIMD
+                v4sf acc = { 0.0f, 0.0f, 0.0f, 0.0f };
+                for(int k=0; k<c.count; k++, p+=4) {
+                    v4sf wv = { w[k], w[k], w[k], w[k] };
+                    acc += wv * loadPixel(p);
+                }
+                storePixel(pDst + 4*x, acc);
+#else
+                float acc[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+                for(int k=0; k<c.count; k++, p+=4)
+                    for(int i=0; i<4; i++)
+                        acc[i] += w[k] * p[i];
+                for(int i=0; i<4; i++)
+                    pDst[4*x+i] = clampChannel(acc[i]);
+#endif
+            }
+        }
+    });
+}
+
+
+/*!
+ * \brief ImageResampler::verticalPass Resample the columns of the image
+ * \param source The source image
+ * \param destination An image as wide as source with the final height
+ */
+void
+ImageResampler::verticalPass(const QImage& source, QImage& destination) {
+    QVector<Contribution> contributions;
+    QVector<float> weights;
+    computeContributions(source.height(), destination.height(), contributions, weights);
+    const Contribution* pContributions = contributions.constData();
+    const float* pWeights = weights.constData();
+    int width = destination.width();
+    int rowCost = width * qMax(1, source.height()/qMax(1, destination.height()));
+    uchar* pDstBits = destination.bits();
+    qsizetype dstStride = destination.bytesPerLine();
+
+    forEachBand(destination.height(), rowCost, [&](int first, int last) {
+        std::vector<float> accumulator(size_t(4*width));
+        float* acc = accumulator.data();
+        for(int y=first; y<last; y++) {
+            const Contribution& c = pContributions[y];
+            std::memset(acc, 0, accumulator.size()*sizeof(float));
+            for(int k=0; k<c.count; k++) {
+                const uchar* p = source.constScanLine(c.first+k);
+                float w = pWeights[c.weight+k];
+#ifdef RESAMPLER_SIMD
+                v4sf wv = { w, w, w, w };
+                for(int x=0; x<width; x++) {
+                    v4sf a;
+                    std::memcpy(&a, acc+4*x, sizeof(a));
+                    a += wv * loadPixel(p+4*x);
+                    std::memcpy(acc+4*x, &a, sizeof(a));
+                }
+#else
+                for(int i=0; i<4*width; i++)
+                    acc[i] += w * p[i];
+#endif
+            }
+            uchar* pDst = pDstBits + y*dstStride;
+            for(int i=0; i<4*width; i++)
+                pDst[i] = clampChannel(acc[i]);
+        }
+    });
+}
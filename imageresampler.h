@@ -0,0 +1,48 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QImage>
+#include <QVector>
+#include <functional>
+
+
+class ImageResampler
+{
+public:
+    static QImage scaled(const QImage& source,
+                         const QSize& newSize,
+                         Qt::AspectRatioMode aspectMode = Qt::IgnoreAspectRatio);
+    static void forEachBand(int iRows,
+                            int iRowCost,
+                            const std::function<void(int, int)>& job);
+
+private:
+    struct Contribution {
+        int first;  // First source pixel
+        int count;  // Number of source pixels
+        int weight; // Index of the first weight
+    };
+    static void computeContributions(int srcLength,
+                                     int dstLength,
+                                     QVector<Contribution>& contributions,
+                                     QVector<float>& weights);
+    static void horizontalPass(const QImage& source, QImage& destination);
+    static void verticalPass(const QImage& source, QImage& destination);
+};
@@ -0,0 +1,168 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QApplication>
+#include <QScreen>
+#include <QPainter>
+
+#include "livewindow.h"
+#include "cameraingest.h"
+#include "scoreoverlay.h"
+#include "utility.h"
+
+
+#define LATENCY_REPORT_TIME 10000 // msec between two latency reports
+
+
+/*!
+ * \brief LiveWindow::LiveWindow Full screen view of the live camera
+ * \param myLogFile
+ * \param parent
+ *
+ * The frames are drawn straight from the ingest buffers: the window keeps
+ * a reference to the last frame only until the next one arrives.
+ */
+LiveWindow::LiveWindow(QFile *myLogFile, QWidget *parent)
+    : QWidget(parent)
+    , logFile(myLogFile)
+    , pIngest(nullptr)
+    , pOverlay(nullptr)
+    , frameTime(0)
+    , bFramePainted(true)
+    , latencySum(0)
+    , latencyMax(0)
+    , nLatencySamples(0)
+    , nLastDropped(0)
+{
+    setAttribute(Qt::WA_OpaquePaintEvent);
+    setAttribute(Qt::WA_NoSystemBackground);
+    setWindowFlags(Qt::CustomizeWindowHint);
+    QList<QScreen*> screens = QApplication::screens();
+    if(screens.count() > 1) {
+        QRect screenres = screens.at(1)->geometry();
+        move(QPoint(screenres.x(), screenres.y()));
+    }
+}
+
+
+void
+LiveWindow::setIngest(CameraIngest* pNewIngest) {
+    if(pIngest)
+        disconnect(pIngest, nullptr, this, nullptr);
+    releaseFrame();
+    pIngest = pNewIngest;
+    nLastDropped = 0;
+    if(pIngest)
+        connect(pIngest, SIGNAL(frameReady()),
+                this, SLOT(onFrameReady()));
+}
+
+
+/*!
+ * \brief LiveWindow::releaseFrame Give the shown buffer back to the ingest
+ */
+void
+LiveWindow::releaseFrame() {
+    frame = QImage();
+    bFramePainted = true;
+}
+
+
+/*!
+ * \brief LiveWindow::setOverlay Draw the score bug over the frames
+ * \param pNewOverlay The overlay (nullptr for none)
+ */
+void
+LiveWindow::setOverlay(ScoreOverlay* pNewOverlay) {
+    if(pOverlay)
+        disconnect(pOverlay, nullptr, this, nullptr);
+    pOverlay = pNewOverlay;
+    if(pOverlay)
+        connect(pOverlay, SIGNAL(changed()),
+                this, SLOT(update()));
+    update();
+}
+
+
+void
+LiveWindow::onFrameReady() {
+    if(!pIngest)
+        return;
+    qint64 captureTime;
+    QImage newFrame = pIngest->takeFrame(&captureTime);
+    if(newFrame.isNull())
+        return;
+    frame.swap(newFrame); // The previous buffer is released here
+    frameTime = captureTime;
+    bFramePainted = false;
+    update();
+}
+
+
+void
+LiveWindow::paintEvent(QPaintEvent *event) {
+    Q_UNUSED(event)
+    QPainter painter(this);
+    if(frame.isNull()) {
+        painter.fillRect(rect(), Qt::black);
+        return;
+    }
+    QRect target(QPoint(0, 0), frame.size().scaled(size(), Qt::KeepAspectRatio));
+    target.moveCenter(rect().center());
+    if(target != rect()) {
+        QRegion borders = QRegion(rect()).subtracted(QRegion(target));
+        for(const QRect& border : borders)
+            painter.fillRect(border, Qt::black);
+    }
+    painter.drawImage(target, frame);
+    // Only the small cached bug is composited on each frame
+    if(pOverlay)
+        painter.drawPixmap(pOverlay->position(), pOverlay->pixmap());
+    if(!bFramePainted) {
+        bFramePainted = true;
+        qint64 latency = CameraIngest::monotonicTime() - frameTime;
+        latencySum += latency;
+        latencyMax = qMax(latencyMax, latency);
+        nLatencySamples++;
+        if(!reportTimer.isValid())
+            reportTimer.start();
+        if(reportTimer.elapsed() >= LATENCY_REPORT_TIME)
+            reportLatency();
+    }
+}
+
+
+/*!
+ * \brief LiveWindow::reportLatency Log the capture to display latency
+ */
+void
+LiveWindow::reportLatency() {
+    qint64 nDropped = pIngest ? pIngest->droppedFrames() : 0;
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               QString("Live: %1 frames, latency mean %2 ms max %3 ms, %4 dropped")
+               .arg(nLatencySamples)
+               .arg(double(latencySum)/(1000.0*qMax(1, nLatencySamples)), 0, 'f', 1)
+               .arg(double(latencyMax)/1000.0, 0, 'f', 1)
+               .arg(nDropped-nLastDropped));
+    nLastDropped = nDropped;
+    latencySum = 0;
+    latencyMax = 0;
+    nLatencySamples = 0;
+    reportTimer.restart();
+}
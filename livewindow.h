@@ -0,0 +1,62 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QWidget>
+#include <QImage>
+#include <QElapsedTimer>
+
+QT_FORWARD_DECLARE_CLASS(QFile)
+QT_FORWARD_DECLARE_CLASS(CameraIngest)
+QT_FORWARD_DECLARE_CLASS(ScoreOverlay)
+
+
+class LiveWindow : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit LiveWindow(QFile *myLogFile, QWidget *parent = nullptr);
+    void setIngest(CameraIngest* pNewIngest);
+    void releaseFrame();
+    void setOverlay(ScoreOverlay* pNewOverlay);
+
+protected:
+    void paintEvent(QPaintEvent *event);
+
+private slots:
+    void onFrameReady();
+
+private:
+    void reportLatency();
+
+private:
+    QFile*         logFile;
+    CameraIngest*  pIngest;
+    ScoreOverlay*  pOverlay;
+    QImage         frame;
+    qint64         frameTime;
+    bool           bFramePainted;
+    // Capture to display latency statistics (usec)
+    QElapsedTimer  reportTimer;
+    qint64         latencySum;
+    qint64         latencyMax;
+    int            nLatencySamples;
+    qint64         nLastDropped;
+};
@@ -1,7 +1,9 @@
 #include "volleyapplication.h"
+#include "startuptrace.h"
 
 int
 main(int argc, char *argv[]) {
+    StartupTrace::mark("process start");
     qputenv("QT_LOGGING_RULES","*.debug=false;qt.qpa.*=false"); // supress anoying messages
     QString sVersion = QString("0.1");
     QApplication::setApplicationVersion(sVersion);
@@ -23,6 +23,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QApplication>
 
 #include "messagewindow.h"
+#include "resourcecache.h"
 #include "utility.h"
 
 
@@ -54,25 +55,11 @@ MessageWindow::MessageWindow(QWidget *parent)
     panelPalette.setColor(QPalette::BrightText,    Qt::white);
     setPalette(panelPalette);
 
-    // The Label with the message.
-    // Since it has a No Parent it is a QWidget that we can move !
-    pMyLabel = new QLabel(Q_NULLPTR);
-    QString sNewText = tr("No Text");
-    QFont font(pMyLabel->font());
-    font.setPixelSize(12);
-    QFontMetrics f(font);
-    int rW = f.horizontalAdvance(sNewText);
-    QPixmap logo(":/myLogo.png");
-    rW = (logo.width()-rW)/2;
-    QPainter painter(&logo);
-    painter.setPen(QColor(255,255,255,255));
-    painter.setFont(font);
-    painter.drawText(QPoint(rW, 12), sNewText);
-    rW = f.horizontalAdvance(sProducer);
-    rW = (logo.width()-rW)/2;
-    painter.setPen(QColor(255,255,128,255));
-    painter.drawText(QPoint(rW, logo.height()-12), sProducer);
-    pMyLabel->setPixmap(logo);
+    // The Label with the message (owned by the window and
+    // reused for every new message)
+    pMyLabel = new QLabel(this);
+    pMyLabel->setPixmap(labelPixmap(tr("No Text"), QColor(255,255,128,255)));
+    pMyLabel->adjustSize();
     pMyLabel->move(newLabelPosition());
 
     // Initialize the random number generator
@@ -97,7 +84,6 @@ MessageWindow::MessageWindow(QWidget *parent)
 MessageWindow::~MessageWindow() {
     moveTimer.disconnect();
     moveTimer.stop();
-    delete pMyLabel;
 }
 
 
@@ -169,25 +155,36 @@ MessageWindow::keyPressEvent(QKeyEvent *event) {
  */
 void
 MessageWindow::setDisplayedText(QString sNewText) {
-    delete pMyLabel;
-    // The Label with the message
-    pMyLabel = new QLabel(sNewText, this);
+    pMyLabel->setPixmap(labelPixmap(sNewText, QColor(255,34,255,255)));
+    pMyLabel->adjustSize();
+    pMyLabel->move(newLabelPosition());
+}
+
+
+/*!
+ * \brief MessageWindow::labelPixmap The logo with the message and the producer
+ * \param sText The message
+ * \param producerColor
+ * \return A copy of the shared logo with the texts
+ */
+QPixmap
+MessageWindow::labelPixmap(QString sText, QColor producerColor) {
     QFont font(pMyLabel->font());
     font.setPixelSize(12);
     QFontMetrics f(font);
-    int rW = f.horizontalAdvance(sNewText);
-    QPixmap logo(":/myLogo.png");
+    int rW = f.horizontalAdvance(sText);
+    QPixmap logo = ResourceCache::pixmap(QString(":/myLogo.png"));
     rW = (logo.width()-rW)/2;
-    QPainter painter(&logo);
+    QPainter painter(&logo); // Detaches from the cached logo
     painter.setPen(QColor(255,255,255,255));
     painter.setFont(font);
-    painter.drawText(QPoint(rW, 12), sNewText);
+    painter.drawText(QPoint(rW, 12), sText);
     rW = f.horizontalAdvance(sProducer);
     rW = (logo.width()-rW)/2;
-    painter.setPen(QColor(255,34,255,255));
+    painter.setPen(producerColor);
     painter.drawText(QPoint(rW, logo.height()-12), sProducer);
-    pMyLabel->setPixmap(logo);
-    pMyLabel->move(newLabelPosition());
+    painter.end();
+    return logo;
 }
 
 
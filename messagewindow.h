@@ -47,6 +47,7 @@ public:
 
 private:
     QPoint newLabelPosition();
+    QPixmap labelPixmap(QString sText, QColor producerColor);
     QPalette panelPalette;
     QLinearGradient panelGradient;
     QBrush panelBrush;
@@ -0,0 +1,251 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QFile>
+#include <QVector>
+#include <QMutex>
+#include <QMutexLocker>
+
+#ifdef Q_OS_LINUX
+    #include <unistd.h>
+#endif
+
+#include "metrics.h"
+#include "stallwatchdog.h"
+
+
+namespace {
+
+enum metricType {
+    type_Counter,
+    type_Gauge,
+    type_Histogram
+};
+
+
+struct MetricEntry {
+    metricType  type;
+    const char* name;
+    const char* help;
+    const void* metric;
+};
+
+
+QMutex&
+registryMutex() {
+    static QMutex mutex;
+    return mutex;
+}
+
+
+QVector<MetricEntry>&
+registry() {
+    static QVector<MetricEntry> entries;
+    return entries;
+}
+
+
+void
+registerMetric(metricType type, const char* sName, const char* sHelp, const void* pMetric) {
+    QMutexLocker locker(&registryMutex());
+    registry().append(MetricEntry{type, sName, sHelp, pMetric});
+}
+
+
+// Bucket upper limits in usec
+const qint64 bucketLimits[MetricHistogram::nBuckets] = {
+    100, 250, 500, 1000, 2500, 5000, 10000, 25000, 50000, 100000, 250000, 1000000
+};
+
+
+qint64
+residentMemory() {
+#ifdef Q_OS_LINUX
+    QFile statm(QString("/proc/self/statm"));
+    if(!statm.open(QIODevice::ReadOnly))
+        return 0;
+    QList<QByteArray> fields = statm.readAll().split(' ');
+    if(fields.count() < 2)
+        return 0;
+    return fields.at(1).toLongLong() * sysconf(_SC_PAGESIZE);
+#else
+    return 0;
+#endif
+}
+
+} // namespace
+
+
+MetricCounter Metrics::messages("volleypanel_messages_total",
+                                "Text messages received from the controller");
+MetricCounter Metrics::messageBytes("volleypanel_message_bytes_total",
+                                    "Bytes received from the controller");
+MetricCounter Metrics::binaryMessages("volleypanel_binary_messages_total",
+                                      "Binary (upload) messages received");
+MetricCounter Metrics::reconnections("volleypanel_reconnections_total",
+                                     "Connections to the controller");
+MetricCounter Metrics::failovers("volleypanel_failovers_total",
+                                 "Switches to a standby controller");
+MetricCounter Metrics::multicastPackets("volleypanel_multicast_packets_total",
+                                        "Datagrams received on the multicast score channel");
+MetricCounter Metrics::multicastGaps("volleypanel_multicast_gaps_total",
+                                     "Gaps in the numbering of the state messages");
+MetricCounter Metrics::multicastLost("volleypanel_multicast_lost_total",
+                                     "State messages missing in the gaps");
+MetricCounter Metrics::duplicateMessages("volleypanel_duplicate_messages_total",
+                                         "State messages received by both channels");
+MetricHistogram Metrics::parseTime("volleypanel_parse_seconds",
+                                   "Time to parse and apply a message");
+MetricCounter Metrics::dispatches("volleypanel_dispatches_total",
+                                  "Message batches parsed and applied");
+MetricCounter Metrics::coalescedMessages("volleypanel_coalesced_messages_total",
+                                         "Messages merged into a previous one of the same batch");
+MetricCounter Metrics::coalescingSavedTime("volleypanel_coalescing_saved_microseconds_total",
+                                           "Estimated dispatch time saved by the coalescing");
+MetricHistogram Metrics::repaintTime("volleypanel_repaint_seconds",
+                                     "Time to repaint the score panel");
+MetricCounter Metrics::transitionFrames("volleypanel_transition_frames_total",
+                                        "Slide transition frames rendered");
+MetricHistogram Metrics::transitionFrameTime("volleypanel_transition_frame_seconds",
+                                             "Time to render a slide transition frame");
+MetricGauge Metrics::transitionFps("volleypanel_transition_fps",
+                                   "Frame rate of the last slide transition");
+MetricCounter Metrics::exportedFrames("volleypanel_exported_frames_total",
+                                      "Frames published in shared memory");
+MetricCounter Metrics::streamFrames("volleypanel_stream_frames_total",
+                                    "Frames encoded for the MJPEG stream");
+MetricCounter Metrics::streamSkippedFrames("volleypanel_stream_skipped_frames_total",
+                                           "Frames not sent to a slow stream client");
+MetricHistogram Metrics::streamEncodeTime("volleypanel_stream_encode_seconds",
+                                          "Time to encode a frame of the MJPEG stream");
+MetricGauge Metrics::streamClients("volleypanel_stream_clients",
+                                   "Clients of the MJPEG stream");
+MetricCounter Metrics::stalls("volleypanel_stalls_total",
+                              "GUI thread event loop stalls");
+MetricHistogram Metrics::stallTime("volleypanel_stall_seconds",
+                                   "Duration of the GUI thread stalls");
+MetricCounter Metrics::processStarts("volleypanel_process_starts_total",
+                                     "Child processes (players) started");
+MetricGauge Metrics::imageBytes("volleypanel_image_bytes",
+                                "Memory held by the slide show images");
+MetricGauge Metrics::cachedImageBytes("volleypanel_cached_image_bytes",
+                                      "Memory held by the shared logos and icons");
+
+
+MetricCounter::MetricCounter(const char* sName, const char* sHelp)
+    : value(0)
+{
+    registerMetric(type_Counter, sName, sHelp, this);
+}
+
+
+MetricGauge::MetricGauge(const char* sName, const char* sHelp)
+    : value(0.0)
+{
+    registerMetric(type_Gauge, sName, sHelp, this);
+}
+
+
+MetricHistogram::MetricHistogram(const char* sName, const char* sHelp)
+    : nObservations(0)
+    , totalTime(0)
+{
+    for(int i=0; i<nBuckets; i++)
+        buckets[i].store(0, std::memory_order_relaxed);
+    registerMetric(type_Histogram, sName, sHelp, this);
+}
+
+
+qint64
+MetricHistogram::bucketLimit(int iBucket) {
+    return bucketLimits[iBucket];
+}
+
+
+/*!
+ * \brief MetricHistogram::observe Account for a duration
+ * \param usec The duration in usec
+ *
+ * Only the first bucket containing the value is incremented:
+ * the cumulative counts are computed by exposition().
+ */
+void
+MetricHistogram::observe(qint64 usec) {
+    for(int i=0; i<nBuckets; i++) {
+        if(usec <= bucketLimits[i]) {
+            buckets[i].fetch_add(1, std::memory_order_relaxed);
+            break;
+        }
+    }
+    nObservations.fetch_add(1, std::memory_order_relaxed);
+    totalTime.fetch_add(quint64(qMax(qint64(0), usec)), std::memory_order_relaxed);
+}
+
+
+quint64
+MetricHistogram::bucketCount(int iBucket) const {
+    return buckets[iBucket].load(std::memory_order_relaxed);
+}
+
+
+/*!
+ * \brief Metrics::exposition
+ * \return All the metrics in the Prometheus text format
+ */
+QByteArray
+Metrics::exposition() {
+    QByteArray text;
+    text.reserve(4096);
+    QMutexLocker locker(&registryMutex());
+    for(const MetricEntry& entry : qAsConst(registry())) {
+        QByteArray sName(entry.name);
+        text += "# HELP " + sName + " " + entry.help + "\n";
+        if(entry.type == type_Counter) {
+            const MetricCounter* pCounter = static_cast<const MetricCounter*>(entry.metric);
+            text += "# TYPE " + sName + " counter\n";
+            text += sName + " " + QByteArray::number(pCounter->get()) + "\n";
+        }
+        else if(entry.type == type_Gauge) {
+            const MetricGauge* pGauge = static_cast<const MetricGauge*>(entry.metric);
+            text += "# TYPE " + sName + " gauge\n";
+            text += sName + " " + QByteArray::number(pGauge->get(), 'g', 10) + "\n";
+        }
+        else {
+            const MetricHistogram* pHistogram = static_cast<const MetricHistogram*>(entry.metric);
+            text += "# TYPE " + sName + " histogram\n";
+            quint64 cumulative = 0;
+            for(int i=0; i<MetricHistogram::nBuckets; i++) {
+                cumulative += pHistogram->bucketCount(i);
+                text += sName + "_bucket{le=\"" +
+                        QByteArray::number(double(MetricHistogram::bucketLimit(i))*1.0e-6, 'g', 6) +
+                        "\"} " + QByteArray::number(cumulative) + "\n";
+            }
+            // Observations in progress may be already in their bucket
+            quint64 nTotal = qMax(pHistogram->count(), cumulative);
+            text += sName + "_bucket{le=\"+Inf\"} " + QByteArray::number(nTotal) + "\n";
+            text += sName + "_sum " + QByteArray::number(double(pHistogram->sum())*1.0e-6, 'g', 10) + "\n";
+            text += sName + "_count " + QByteArray::number(nTotal) + "\n";
+        }
+    }
+    locker.unlock();
+    text += StallWatchdog::exposition();
+    text += "# HELP process_resident_memory_bytes Resident memory size in bytes\n";
+    text += "# TYPE process_resident_memory_bytes gauge\n";
+    text += "process_resident_memory_bytes " + QByteArray::number(residentMemory()) + "\n";
+    return text;
+}
@@ -0,0 +1,118 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QByteArray>
+#include <atomic>
+
+
+/*!
+ * \brief A monotonic counter
+ */
+class MetricCounter
+{
+public:
+    MetricCounter(const char* sName, const char* sHelp);
+    void add(quint64 n = 1) { value.fetch_add(n, std::memory_order_relaxed); }
+    quint64 get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<quint64> value;
+};
+
+
+/*!
+ * \brief A value that can go up and down
+ */
+class MetricGauge
+{
+public:
+    MetricGauge(const char* sName, const char* sHelp);
+    void set(double newValue) { value.store(newValue, std::memory_order_relaxed); }
+    double get() const { return value.load(std::memory_order_relaxed); }
+
+private:
+    std::atomic<double> value;
+};
+
+
+/*!
+ * \brief A distribution of durations (usec) in fixed buckets
+ */
+class MetricHistogram
+{
+public:
+    static const int nBuckets = 12;
+    MetricHistogram(const char* sName, const char* sHelp);
+    void observe(qint64 usec);
+    quint64 bucketCount(int iBucket) const;
+    quint64 count() const { return nObservations.load(std::memory_order_relaxed); }
+    quint64 sum() const { return totalTime.load(std::memory_order_relaxed); }
+    static qint64 bucketLimit(int iBucket);
+
+private:
+    std::atomic<quint64> buckets[nBuckets];
+    std::atomic<quint64> nObservations;
+    std::atomic<quint64> totalTime;
+};
+
+
+/*!
+ * \brief The Panel metrics
+ *
+ * Updating a metric costs a relaxed atomic operation: they may be used
+ * on the hot paths of every thread.
+ */
+class Metrics
+{
+public:
+    static QByteArray exposition();
+
+    // Network
+    static MetricCounter   messages;
+    static MetricCounter   messageBytes;
+    static MetricCounter   binaryMessages;
+    static MetricCounter   reconnections;
+    static MetricCounter   failovers;
+    static MetricCounter   multicastPackets;
+    static MetricCounter   multicastGaps;
+    static MetricCounter   multicastLost;
+    static MetricCounter   duplicateMessages;
+    static MetricHistogram parseTime;
+    static MetricCounter   dispatches;
+    static MetricCounter   coalescedMessages;
+    static MetricCounter   coalescingSavedTime;
+    // Rendering
+    static MetricHistogram repaintTime;
+    static MetricCounter   transitionFrames;
+    static MetricHistogram transitionFrameTime;
+    static MetricGauge     transitionFps;
+    static MetricCounter   exportedFrames;
+    static MetricCounter   streamFrames;
+    static MetricCounter   streamSkippedFrames;
+    static MetricHistogram streamEncodeTime;
+    static MetricGauge     streamClients;
+    // Responsiveness
+    static MetricCounter   stalls;
+    static MetricHistogram stallTime;
+    // Resources
+    static MetricCounter   processStarts;
+    static MetricGauge     imageBytes;
+    static MetricGauge     cachedImageBytes;
+};
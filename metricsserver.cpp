@@ -0,0 +1,102 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QTcpServer>
+#include <QTcpSocket>
+
+#include "metricsserver.h"
+#include "metrics.h"
+#include "utility.h"
+
+
+#define MAX_REQUEST_SIZE 8192
+
+
+/*!
+ * \brief MetricsServer::MetricsServer A minimal HTTP server for the Prometheus scraper
+ * \param myLogFile
+ * \param parent
+ *
+ * Any GET request is answered with Metrics::exposition() and the
+ * connection is closed (HTTP/1.0).
+ */
+MetricsServer::MetricsServer(QFile *myLogFile, QObject *parent)
+    : QObject(parent)
+    , logFile(myLogFile)
+    , pServer(new QTcpServer(this))
+{
+    connect(pServer, SIGNAL(newConnection()),
+            this, SLOT(onNewConnection()));
+}
+
+
+bool
+MetricsServer::listen(const QHostAddress& address, quint16 port) {
+    if(!pServer->listen(address, port)) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to listen on %1:%2 (%3)")
+                   .arg(address.toString())
+                   .arg(port)
+                   .arg(pServer->errorString()));
+        return false;
+    }
+    return true;
+}
+
+
+void
+MetricsServer::onNewConnection() {
+    while(pServer->hasPendingConnections()) {
+        QTcpSocket* pSocket = pServer->nextPendingConnection();
+        connect(pSocket, SIGNAL(readyRead()),
+                this, SLOT(onReadyRead()));
+        connect(pSocket, SIGNAL(disconnected()),
+                pSocket, SLOT(deleteLater()));
+    }
+}
+
+
+void
+MetricsServer::onReadyRead() {
+    QTcpSocket* pSocket = qobject_cast<QTcpSocket*>(sender());
+    if(!pSocket)
+        return;
+    // Wait for the whole request header
+    if(!pSocket->peek(MAX_REQUEST_SIZE).contains("\r\n\r\n")) {
+        if(pSocket->bytesAvailable() >= MAX_REQUEST_SIZE)
+            pSocket->abort();
+        return;
+    }
+    QByteArray request = pSocket->readAll();
+    QByteArray response;
+    if(request.startsWith("GET ")) {
+        QByteArray body = Metrics::exposition();
+        response = "HTTP/1.0 200 OK\r\n"
+                   "Content-Type: text/plain; version=0.0.4\r\n"
+                   "Content-Length: " + QByteArray::number(body.size()) + "\r\n"
+                   "Connection: close\r\n\r\n" + body;
+    }
+    else {
+        response = "HTTP/1.0 405 Method Not Allowed\r\n"
+                   "Content-Length: 0\r\n"
+                   "Connection: close\r\n\r\n";
+    }
+    pSocket->write(response);
+    pSocket->disconnectFromHost();
+}
@@ -0,0 +1,312 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QBuffer>
+#include <QElapsedTimer>
+#include <QMutexLocker>
+#include <QTcpServer>
+#include <QTcpSocket>
+#include <QTimer>
+
+#include "mjpegserver.h"
+#include "metrics.h"
+
+
+#define MAX_REQUEST_SIZE  8192
+#define MAX_CLIENT_BACKLOG (2*1024*1024) // Bytes queued to a slow client before skipping frames
+#define MJPEG_BOUNDARY    "volleypanelframe"
+#define SNAPSHOT_TIMEOUT  2000 // msec to wait for a fresh frame for /frame.jpg
+
+
+/*!
+ * \brief MjpegServer::MjpegServer Streams the Panel as MJPEG over HTTP
+ * \param parent
+ *
+ * It lives in its own thread: the GUI thread only hands over the last
+ * rendered frame (an implicitly shared QImage). Only the newest frame
+ * is encoded, once, and the same JPEG is sent to every client.
+ *
+ *   GET /           multipart/x-mixed-replace stream
+ *   GET /frame.jpg  a fresh frame (503 if the Panel does not render one)
+ */
+MjpegServer::MjpegServer(QObject *parent)
+    : QObject(parent)
+    , port(0)
+    , pServer(nullptr) // Created in the stream thread
+    , pSnapshotTimer(nullptr)
+    , nClients(0)
+    , iQuality(75)
+    , bEncodeQueued(false)
+{
+}
+
+
+MjpegServer::~MjpegServer() {
+    stop();
+}
+
+
+/*!
+ * \brief MjpegServer::setAddress Where to listen for the clients
+ *
+ * To be called before start().
+ */
+void
+MjpegServer::setAddress(QHostAddress newAddress, quint16 newPort) {
+    address = newAddress;
+    port    = newPort;
+}
+
+
+void
+MjpegServer::setQuality(int iNewQuality) {
+    iQuality = qBound(1, iNewQuality, 100);
+}
+
+
+void
+MjpegServer::start() {
+    if(pServer)
+        return;
+    pServer = new QTcpServer(this);
+    connect(pServer, SIGNAL(newConnection()),
+            this, SLOT(onNewConnection()));
+    pSnapshotTimer = new QTimer(this);
+    pSnapshotTimer->setSingleShot(true);
+    connect(pSnapshotTimer, SIGNAL(timeout()),
+            this, SLOT(onSnapshotTimeout()));
+    if(!pServer->listen(address, port))
+        emit statusMessage(QString("Unable to stream on %1:%2 (%3)")
+                           .arg(address.toString())
+                           .arg(port)
+                           .arg(pServer->errorString()));
+}
+
+
+/*!
+ * \brief MjpegServer::stop Closes the server and all the streams
+ *
+ * To be called in the stream thread (or with a blocking connection).
+ */
+void
+MjpegServer::stop() {
+    for(QTcpSocket* pSocket : clients + snapshotClients) {
+        pSocket->disconnect(this);
+        pSocket->abort();
+        pSocket->deleteLater();
+    }
+    clients.clear();
+    snapshotClients.clear();
+    updateClientCount();
+    if(pSnapshotTimer) {
+        delete pSnapshotTimer;
+        pSnapshotTimer = nullptr;
+    }
+    if(pServer) {
+        pServer->close();
+        delete pServer;
+        pServer = nullptr;
+    }
+}
+
+
+/*!
+ * \brief MjpegServer::submitFrame Hands over a new frame (any thread)
+ * \param frame
+ *
+ * A frame not yet encoded is simply replaced by the newer one.
+ */
+void
+MjpegServer::submitFrame(const QImage& frame) {
+    QMutexLocker locker(&frameMutex);
+    pendingFrame = frame;
+    if(bEncodeQueued)
+        return;
+    bEncodeQueued = true;
+    locker.unlock();
+    QMetaObject::invokeMethod(this, "onEncode", Qt::QueuedConnection);
+}
+
+
+void
+MjpegServer::onEncode() {
+    QMutexLocker locker(&frameMutex);
+    QImage frame = pendingFrame;
+    pendingFrame = QImage();
+    bEncodeQueued = false;
+    locker.unlock();
+    if(frame.isNull())
+        return;
+
+    QElapsedTimer encodeTimer;
+    encodeTimer.start();
+    lastJpeg.clear();
+    QBuffer buffer(&lastJpeg);
+    buffer.open(QIODevice::WriteOnly);
+    if(!frame.save(&buffer, "JPEG", iQuality))
+        return;
+    buffer.close();
+    Metrics::streamEncodeTime.observe(encodeTimer.nsecsElapsed()/1000);
+    Metrics::streamFrames.add();
+
+    lastPart = QByteArray("--" MJPEG_BOUNDARY "\r\n"
+                          "Content-Type: image/jpeg\r\n"
+                          "Content-Length: ") +
+               QByteArray::number(lastJpeg.size()) + "\r\n\r\n" +
+               lastJpeg + "\r\n";
+    for(QTcpSocket* pSocket : qAsConst(clients))
+        sendFrame(pSocket);
+    sendSnapshots();
+}
+
+
+/*!
+ * \brief MjpegServer::sendSnapshots Answers the /frame.jpg requests with the last frame
+ *
+ * Without a frame at all the Panel is not rendering: 503.
+ */
+void
+MjpegServer::sendSnapshots() {
+    for(QTcpSocket* pSocket : qAsConst(snapshotClients)) {
+        if(lastJpeg.isEmpty())
+            pSocket->write("HTTP/1.0 503 Service Unavailable\r\n"
+                           "Content-Length: 0\r\n"
+                           "Connection: close\r\n\r\n");
+        else
+            pSocket->write("HTTP/1.0 200 OK\r\n"
+                           "Content-Type: image/jpeg\r\n"
+                           "Content-Length: " + QByteArray::number(lastJpeg.size()) + "\r\n"
+                           "Cache-Control: no-cache\r\n"
+                           "Connection: close\r\n\r\n" + lastJpeg);
+        pSocket->disconnectFromHost();
+    }
+    snapshotClients.clear();
+    pSnapshotTimer->stop();
+    updateClientCount();
+}
+
+
+/*!
+ * \brief MjpegServer::onSnapshotTimeout No fresh frame in time: the last one will do
+ */
+void
+MjpegServer::onSnapshotTimeout() {
+    sendSnapshots();
+}
+
+
+/*!
+ * \brief MjpegServer::sendFrame Sends the last frame unless the client is behind
+ *
+ * A slow client skips frames instead of growing its send buffer.
+ */
+void
+MjpegServer::sendFrame(QTcpSocket* pSocket) {
+    if(lastPart.isEmpty())
+        return;
+    if(pSocket->bytesToWrite() > MAX_CLIENT_BACKLOG) {
+        Metrics::streamSkippedFrames.add();
+        return;
+    }
+    pSocket->write(lastPart);
+}
+
+
+void
+MjpegServer::onNewConnection() {
+    while(pServer->hasPendingConnections()) {
+        QTcpSocket* pSocket = pServer->nextPendingConnection();
+        connect(pSocket, SIGNAL(readyRead()),
+                this, SLOT(onReadyRead()));
+        connect(pSocket, SIGNAL(disconnected()),
+                this, SLOT(onClientDisconnected()));
+    }
+}
+
+
+void
+MjpegServer::onReadyRead() {
+    QTcpSocket* pSocket = qobject_cast<QTcpSocket*>(sender());
+    if(!pSocket || clients.contains(pSocket) || snapshotClients.contains(pSocket))
+        return;
+    // Wait for the whole request header
+    if(!pSocket->peek(MAX_REQUEST_SIZE).contains("\r\n\r\n")) {
+        if(pSocket->bytesAvailable() >= MAX_REQUEST_SIZE)
+            pSocket->abort();
+        return;
+    }
+    QByteArray request = pSocket->readAll();
+    QList<QByteArray> requestLine = request.left(request.indexOf("\r\n")).split(' ');
+    QByteArray path = requestLine.count() > 1 ? requestLine.at(1) : QByteArray();
+    if(requestLine.at(0) != "GET") {
+        pSocket->write("HTTP/1.0 405 Method Not Allowed\r\n"
+                       "Content-Length: 0\r\n"
+                       "Connection: close\r\n\r\n");
+        pSocket->disconnectFromHost();
+    }
+    else if(path == "/frame.jpg") {
+        // Answered by the next encoded frame (or by the timeout)
+        snapshotClients.append(pSocket);
+        updateClientCount();
+        if(!pSnapshotTimer->isActive())
+            pSnapshotTimer->start(SNAPSHOT_TIMEOUT);
+        emit clientConnected();
+    }
+    else if(path == "/") {
+        pSocket->write("HTTP/1.0 200 OK\r\n"
+                       "Content-Type: multipart/x-mixed-replace; boundary=" MJPEG_BOUNDARY "\r\n"
+                       "Cache-Control: no-cache\r\n"
+                       "Connection: close\r\n\r\n");
+        clients.append(pSocket);
+        updateClientCount();
+        // The panel may not change for a while: start with the last frame
+        // and ask for a fresh one
+        sendFrame(pSocket);
+        emit clientConnected();
+    }
+    else {
+        pSocket->write("HTTP/1.0 404 Not Found\r\n"
+                       "Content-Length: 0\r\n"
+                       "Connection: close\r\n\r\n");
+        pSocket->disconnectFromHost();
+    }
+}
+
+
+void
+MjpegServer::onClientDisconnected() {
+    QTcpSocket* pSocket = qobject_cast<QTcpSocket*>(sender());
+    if(pSocket)
+        removeClient(pSocket);
+}
+
+
+void
+MjpegServer::removeClient(QTcpSocket* pSocket) {
+    clients.removeAll(pSocket);
+    snapshotClients.removeAll(pSocket);
+    updateClientCount();
+    pSocket->deleteLater();
+}
+
+
+void
+MjpegServer::updateClientCount() {
+    nClients.store(clients.count()+snapshotClients.count(), std::memory_order_relaxed);
+    Metrics::streamClients.set(clients.count());
+}
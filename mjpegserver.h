@@ -0,0 +1,83 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QObject>
+#include <QHostAddress>
+#include <QImage>
+#include <QList>
+#include <QMutex>
+#include <atomic>
+
+QT_FORWARD_DECLARE_CLASS(QTcpServer)
+QT_FORWARD_DECLARE_CLASS(QTcpSocket)
+QT_FORWARD_DECLARE_CLASS(QTimer)
+
+
+class MjpegServer : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MjpegServer(QObject *parent = nullptr);
+    ~MjpegServer();
+    void setAddress(QHostAddress newAddress, quint16 newPort);
+    void setQuality(int iNewQuality);
+    bool hasClients() const {
+        return nClients.load(std::memory_order_relaxed) > 0;
+    }
+    void submitFrame(const QImage& frame);
+
+public slots:
+    void start();
+    void stop();
+
+signals:
+    void clientConnected();
+    void statusMessage(QString sMessage);
+
+private slots:
+    void onNewConnection();
+    void onReadyRead();
+    void onClientDisconnected();
+    void onEncode();
+    void onSnapshotTimeout();
+
+private:
+    void sendFrame(QTcpSocket* pSocket);
+    void sendSnapshots();
+    void removeClient(QTcpSocket* pSocket);
+    void updateClientCount();
+
+private:
+    QHostAddress       address;
+    quint16            port;
+    QTcpServer*        pServer;
+    QList<QTcpSocket*> clients;
+    QList<QTcpSocket*> snapshotClients; // Waiting for a fresh /frame.jpg
+    QTimer*            pSnapshotTimer;
+    std::atomic<int>   nClients;        // Both kinds: a frame is wanted
+    int                iQuality;
+    QByteArray         lastPart;   // The last encoded frame, ready to send
+    QByteArray         lastJpeg;
+    // Latest-wins hand off from the GUI thread
+    QMutex             frameMutex;
+    QImage             pendingFrame;
+    bool               bEncodeQueued;
+};
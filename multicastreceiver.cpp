@@ -0,0 +1,82 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QNetworkDatagram>
+#include <QNetworkInterface>
+#include <QUdpSocket>
+
+#include "multicastreceiver.h"
+#include "metrics.h"
+
+
+/*!
+ * \brief MulticastReceiver::MulticastReceiver The score state sent once to all the panels
+ * \param parent
+ *
+ * Every datagram is a state message (score, sets, ...) numbered with
+ * <seq>: the numbers are checked by NetworkWorker, that fills the gaps
+ * through the WebSocket.
+ */
+MulticastReceiver::MulticastReceiver(QObject *parent)
+    : QObject(parent)
+    , pSocket(nullptr)
+{
+}
+
+
+/*!
+ * \brief MulticastReceiver::listen Joins the score channel
+ * \param group
+ * \param port
+ * \param sInterface The network interface (e.g. "eth0", "lo") where to
+ * join the group; empty to let the system choose by its routes
+ */
+bool
+MulticastReceiver::listen(const QHostAddress& group, quint16 port, const QString& sInterface) {
+    pSocket = new QUdpSocket(this);
+    if(!pSocket->bind(QHostAddress::AnyIPv4, port,
+                      QUdpSocket::ShareAddress | QUdpSocket::ReuseAddressHint))
+        return false;
+    if(sInterface.isEmpty()) {
+        if(!pSocket->joinMulticastGroup(group))
+            return false;
+    }
+    else {
+        QNetworkInterface networkInterface = QNetworkInterface::interfaceFromName(sInterface);
+        if(!networkInterface.isValid() || !pSocket->joinMulticastGroup(group, networkInterface))
+            return false;
+    }
+    connect(pSocket, SIGNAL(readyRead()),
+            this, SLOT(onReadyRead()));
+    return true;
+}
+
+
+void
+MulticastReceiver::onReadyRead() {
+    while(pSocket->hasPendingDatagrams()) {
+        QNetworkDatagram datagram = pSocket->receiveDatagram();
+        Metrics::multicastPackets.add();
+        ProtocolMessage message;
+        message.parse(QString::fromUtf8(datagram.data()));
+        // Only numbered state: the commands come through the WebSocket
+        if(!message.isMergeable() || !message.has(Protocol::Tag::Seq))
+            continue;
+        emit messageReceived(message, QHostAddress(datagram.senderAddress().toIPv4Address()));
+    }
+}
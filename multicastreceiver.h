@@ -0,0 +1,45 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QObject>
+#include <QHostAddress>
+
+#include "protocol.h"
+
+QT_FORWARD_DECLARE_CLASS(QUdpSocket)
+
+
+class MulticastReceiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit MulticastReceiver(QObject *parent = nullptr);
+    bool listen(const QHostAddress& group, quint16 port, const QString& sInterface = QString());
+
+signals:
+    void messageReceived(ProtocolMessage message, QHostAddress sender);
+
+private slots:
+    void onReadyRead();
+
+private:
+    QUdpSocket* pSocket;
+};
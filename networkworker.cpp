@@ -0,0 +1,434 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QHostInfo>
+#include <QTimer>
+#include <QUrl>
+#include <QWebSocket>
+
+#include "networkworker.h"
+#include "controllerdiscovery.h"
+#include "multicastreceiver.h"
+#include "metrics.h"
+#include "trace.h"
+
+
+#define CONNECTION_RETRY 1000 // msec between two connection attempts
+#define RESYNC_INTERVAL  250000 // usec between two status requests for gaps
+#define SEQ_RESTART      1000 // A sequence going back more than this is a controller restart
+
+
+namespace {
+
+/*!
+ * \brief utf8Length The bytes of the message on the wire
+ *
+ * QString::size() counts UTF-16 code units; counted here without
+ * converting the message (a surrogate pair is 4 bytes, 2 per unit).
+ */
+quint64
+utf8Length(const QString& sMessage) {
+    quint64 nBytes = 0;
+    for(const QChar& c : sMessage) {
+        ushort u = c.unicode();
+        if(u < 0x80)
+            nBytes += 1;
+        else if(u < 0x800 || c.isSurrogate())
+            nBytes += 2;
+        else
+            nBytes += 3;
+    }
+    return nBytes;
+}
+
+} // namespace
+
+
+/*!
+ * \brief NetworkWorker::NetworkWorker The connection with the controller
+ * \param sNewServerUrl
+ * \param parent
+ *
+ * It lives in its own thread: the socket is read, the heartbeat answered
+ * and the messages parsed and validated whatever the GUI thread is doing.
+ * The GUI receives the parsed messages with queued signals.
+ */
+NetworkWorker::NetworkWorker(QString sNewServerUrl, QObject *parent)
+    : QObject(parent)
+    , sServerUrl(sNewServerUrl)
+    , pSocket(nullptr)          // Created in the network thread
+    , pConnectionTimer(nullptr)
+    , pRefreshTimer(nullptr)
+    , bStillConnected(false)
+    , discoveryPort(0)
+    , pDiscovery(nullptr)
+    , multicastPort(0)
+    , pMulticast(nullptr)
+    , lastSeq(-1)
+    , lastResync(-RESYNC_INTERVAL) // The first gap is always resynced
+{
+    qRegisterMetaType<ProtocolMessage>("ProtocolMessage");
+    qRegisterMetaType<ClockSync>("ClockSync");
+}
+
+
+NetworkWorker::~NetworkWorker() {
+    stop();
+}
+
+
+/*!
+ * \brief NetworkWorker::setDiscovery Where the controllers announce themselves
+ * \param port The UDP port (0 to use only the configured server)
+ * \param group A multicast group (a null address for broadcast only)
+ *
+ * To be called before start().
+ */
+void
+NetworkWorker::setDiscovery(quint16 port, QHostAddress group) {
+    discoveryPort  = port;
+    discoveryGroup = group;
+}
+
+
+/*!
+ * \brief NetworkWorker::setMulticast The (optional) multicast score channel
+ * \param group The multicast group (a null address to disable it)
+ * \param port
+ * \param sInterface Where to join the group (empty: chosen by the system)
+ *
+ * To be called before start().
+ */
+void
+NetworkWorker::setMulticast(QHostAddress group, quint16 port, QString sInterface) {
+    multicastGroup      = group;
+    multicastPort       = port;
+    sMulticastInterface = sInterface;
+}
+
+
+void
+NetworkWorker::start() {
+    if(pSocket)
+        return;
+    pSocket = new QWebSocket(QString(), QWebSocketProtocol::VersionLatest, this);
+    pSocket->ignoreSslErrors(); // To silent some warnings
+    connect(pSocket, SIGNAL(textMessageReceived(QString)),
+            this, SLOT(onTextMessageReceived(QString)));
+    connect(pSocket, SIGNAL(binaryMessageReceived(QByteArray)),
+            this, SLOT(onBinaryMessageReceived(QByteArray)));
+    connect(pSocket, SIGNAL(connected()),
+            this, SLOT(onConnected()));
+    connect(pSocket, SIGNAL(error(QAbstractSocket::SocketError)),
+            this, SLOT(onSocketError(QAbstractSocket::SocketError)));
+
+    pRefreshTimer = new QTimer(this);
+    pRefreshTimer->setSingleShot(false);
+    connect(pRefreshTimer, SIGNAL(timeout()),
+            this, SLOT(onTimeToRefreshStatus()));
+
+    // The configured server is the first choice, the announced ones the standby
+    pDiscovery = new ControllerDiscovery(this);
+    pDiscovery->addStatic(QUrl(sServerUrl));
+    connect(pDiscovery, SIGNAL(controllerFound(QUrl)),
+            this, SLOT(onControllerFound(QUrl)));
+    if(discoveryPort > 0 && !pDiscovery->listen(discoveryPort, discoveryGroup))
+        emit statusMessage(QString("Unable to listen for controllers on port %1").arg(discoveryPort));
+
+    if(!multicastGroup.isNull() && multicastPort > 0) {
+        pMulticast = new MulticastReceiver(this);
+        connect(pMulticast, SIGNAL(messageReceived(ProtocolMessage,QHostAddress)),
+                this, SLOT(onMulticastMessage(ProtocolMessage,QHostAddress)));
+        if(!pMulticast->listen(multicastGroup, multicastPort, sMulticastInterface))
+            emit statusMessage(QString("Unable to join %1:%2")
+                               .arg(multicastGroup.toString())
+                               .arg(multicastPort));
+    }
+
+    // Let's Start to try to connect to Panel Server
+    pConnectionTimer = new QTimer(this);
+    connect(pConnectionTimer, SIGNAL(timeout()),
+            this, SLOT(onConnectionTimeExpired()));
+    pConnectionTimer->start(CONNECTION_RETRY);
+}
+
+
+/*!
+ * \brief NetworkWorker::stop Stops the timers and closes the connection
+ *
+ * To be called in the network thread (or with a blocking connection).
+ */
+void
+NetworkWorker::stop() {
+    if(pConnectionTimer)
+        pConnectionTimer->stop();
+    if(pRefreshTimer)
+        pRefreshTimer->stop();
+    if(pSocket) {
+        pSocket->disconnect();
+        pSocket->close();
+        delete pSocket;
+        pSocket = nullptr;
+    }
+}
+
+
+void
+NetworkWorker::closeConnection(QString sReason) {
+    if(!pSocket)
+        return;
+    pSocket->disconnect();
+    pSocket->close(QWebSocketProtocol::CloseCodeNormal, sReason);
+}
+
+
+void
+NetworkWorker::sendTextMessage(QString sMessage) {
+    if(!send(sMessage))
+        emit sendFailed(sMessage);
+}
+
+
+bool
+NetworkWorker::send(const QString& sMessage) {
+    if(!pSocket || !pSocket->isValid())
+        return false;
+    return pSocket->sendTextMessage(sMessage) == sMessage.length();
+}
+
+
+void
+NetworkWorker::onConnectionTimeExpired() {
+    connectToBest();
+}
+
+
+/*!
+ * \brief NetworkWorker::connectToBest (Re)Open the socket with the best controller
+ */
+void
+NetworkWorker::connectToBest() {
+    currentUrl = pDiscovery->best();
+    if(currentUrl.isEmpty())
+        return;
+    pSocket->open(currentUrl);
+}
+
+
+/*!
+ * \brief NetworkWorker::onControllerFound A new (or returning) controller
+ *
+ * If we are still waiting for a connection there is no need to wait
+ * for the next attempt.
+ */
+void
+NetworkWorker::onControllerFound(QUrl url) {
+    emit statusMessage(QString("Controller found: %1").arg(url.toString()));
+    if(pRefreshTimer->isActive() || // Already connected
+       pSocket->state() != QAbstractSocket::UnconnectedState)
+        return;
+    connectToBest();
+}
+
+
+/*!
+ * \brief NetworkWorker::failOver The current controller is gone: try the next one now
+ *
+ * With a single controller the retry timer does the job.
+ */
+void
+NetworkWorker::failOver() {
+    pDiscovery->setFailed(currentUrl);
+    pConnectionTimer->start(CONNECTION_RETRY);
+    if(!pDiscovery->hasAlternative(currentUrl))
+        return;
+    Metrics::failovers.add();
+    emit statusMessage(QString("Failing over from %1 (%2)")
+                       .arg(currentUrl.toString(), pDiscovery->description()));
+    connectToBest();
+}
+
+
+void
+NetworkWorker::onConnected() {
+    pConnectionTimer->stop();
+    Metrics::reconnections.add();
+    connect(pSocket, SIGNAL(disconnected()),
+            this, SLOT(onDisconnected()));
+    QString sMessage = statusRequest();
+    if(!send(sMessage))
+        emit sendFailed(sMessage);
+    // A new controller may have a different clock
+    clockSync.reset();
+    emit clockSyncChanged(clockSync);
+    lastSeq = -1; // and restart its numbering
+    send(clockSync.request());
+    bStillConnected = false;
+    pRefreshTimer->start(rand()%2000+3000);
+    emit statusMessage(QString("Connected to %1").arg(currentUrl.toString()));
+    emit connected();
+}
+
+
+void
+NetworkWorker::onDisconnected() {
+    pRefreshTimer->stop();
+    disconnect(pSocket, SIGNAL(disconnected()),
+               this, SLOT(onDisconnected()));
+    emit disconnected();
+    failOver();
+}
+
+
+void
+NetworkWorker::onSocketError(QAbstractSocket::SocketError error) {
+    Q_UNUSED(error)
+    if(pRefreshTimer->isActive()) // onDisconnected() will follow
+        return;
+    failOver();
+}
+
+
+/*!
+ * \brief NetworkWorker::onTimeToRefreshStatus The heartbeat
+ *
+ * If nothing arrived since the last heartbeat the controller is gone:
+ * switch to another controller, if any, or give up.
+ */
+void
+NetworkWorker::onTimeToRefreshStatus() {
+    QString sMessage = statusRequest();
+    if(!bStillConnected || !send(sMessage)) {
+        if(pDiscovery->hasAlternative(currentUrl)) {
+            pRefreshTimer->stop();
+            disconnect(pSocket, SIGNAL(disconnected()),
+                       this, SLOT(onDisconnected()));
+            pSocket->abort();
+            emit disconnected();
+            failOver();
+            return;
+        }
+        stop();
+        emit serverLost();
+        return;
+    }
+    // Every heartbeat refines the controller clock offset
+    send(clockSync.request());
+    bStillConnected = false;
+}
+
+
+void
+NetworkWorker::stillAlive() {
+    pRefreshTimer->start(rand()%2000+3000);
+    bStillConnected = true;
+}
+
+
+void
+NetworkWorker::onTextMessageReceived(QString sMessage) {
+    TRACE_SCOPE("NetworkWorker::onTextMessageReceived");
+    // The receive time of the clock samples matters: take it first
+    qint64 receiveTime = ClockSync::localTime();
+    stillAlive();
+    Metrics::messages.add();
+    Metrics::messageBytes.add(utf8Length(sMessage));
+    ProtocolMessage message;
+    message.parse(sMessage);
+    if(message.has(Protocol::Tag::TimeSyncReply)) {
+        if(clockSync.processReply(message.text(Protocol::Tag::TimeSyncReply), receiveTime))
+            emit clockSyncChanged(clockSync);
+    }
+    // The same state may have already arrived by multicast
+    if(message.isMergeable() && !acceptSequence(message))
+        return;
+    emit messageReceived(message);
+}
+
+
+/*!
+ * \brief NetworkWorker::onMulticastMessage A numbered state message by multicast
+ * \param message
+ * \param sender
+ *
+ * Only the controller we are connected to drives the Panel.
+ */
+void
+NetworkWorker::onMulticastMessage(ProtocolMessage message, QHostAddress sender) {
+    if(!pRefreshTimer || !pRefreshTimer->isActive())
+        return;
+    // The url host may be a name: the address of the live socket is not
+    if(sender != QHostAddress(pSocket->peerAddress().toIPv4Address()))
+        return;
+    if(!acceptSequence(message))
+        return;
+    emit messageReceived(message);
+}
+
+
+/*!
+ * \brief NetworkWorker::acceptSequence Checks the numbering of the state messages
+ * \return false for a message already received (by the other channel)
+ *
+ * A gap means that some multicast datagram has been lost: the whole
+ * status is asked again through the WebSocket.
+ */
+bool
+NetworkWorker::acceptSequence(const ProtocolMessage& message) {
+    if(!message.has(Protocol::Tag::Seq))
+        return true;
+    qint64 seq = message.number(Protocol::Tag::Seq);
+    if(lastSeq >= 0) {
+        if(seq <= lastSeq && lastSeq-seq < SEQ_RESTART) {
+            Metrics::duplicateMessages.add();
+            return false;
+        }
+        if(seq > lastSeq+1) {
+            Metrics::multicastGaps.add();
+            Metrics::multicastLost.add(quint64(seq-lastSeq-1));
+            requestResync();
+        }
+    }
+    lastSeq = seq;
+    return true;
+}
+
+
+void
+NetworkWorker::requestResync() {
+    qint64 now = ClockSync::localTime();
+    if(now-lastResync < RESYNC_INTERVAL)
+        return;
+    lastResync = now;
+    send(statusRequest());
+}
+
+
+QString
+NetworkWorker::statusRequest() const {
+    return QString("<getStatus>%1</getStatus>").arg(QHostInfo::localHostName());
+}
+
+
+void
+NetworkWorker::onBinaryMessageReceived(QByteArray baMessage) {
+    stillAlive();
+    Metrics::binaryMessages.add();
+    Metrics::messageBytes.add(quint64(baMessage.size()));
+    emit binaryMessageReceived(baMessage);
+}
@@ -0,0 +1,99 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QObject>
+#include <QAbstractSocket>
+#include <QByteArray>
+#include <QHostAddress>
+#include <QUrl>
+
+#include "clocksync.h"
+#include "protocol.h"
+
+QT_FORWARD_DECLARE_CLASS(QWebSocket)
+QT_FORWARD_DECLARE_CLASS(QTimer)
+QT_FORWARD_DECLARE_CLASS(ControllerDiscovery)
+QT_FORWARD_DECLARE_CLASS(MulticastReceiver)
+
+
+class NetworkWorker : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit NetworkWorker(QString sNewServerUrl, QObject *parent = nullptr);
+    ~NetworkWorker();
+    void setDiscovery(quint16 port, QHostAddress group);
+    void setMulticast(QHostAddress group, quint16 port, QString sInterface = QString());
+
+public slots:
+    void start();
+    void stop();
+    void sendTextMessage(QString sMessage);
+    void closeConnection(QString sReason);
+
+signals:
+    void connected();
+    void disconnected();
+    void serverLost();
+    void messageReceived(ProtocolMessage message);
+    void binaryMessageReceived(QByteArray baMessage);
+    void clockSyncChanged(ClockSync newClockSync);
+    void sendFailed(QString sMessage);
+    void statusMessage(QString sMessage);
+
+private slots:
+    void onConnectionTimeExpired();
+    void onControllerFound(QUrl url);
+    void onConnected();
+    void onDisconnected();
+    void onSocketError(QAbstractSocket::SocketError error);
+    void onTextMessageReceived(QString sMessage);
+    void onBinaryMessageReceived(QByteArray baMessage);
+    void onTimeToRefreshStatus();
+    void onMulticastMessage(ProtocolMessage message, QHostAddress sender);
+
+private:
+    void stillAlive();
+    void connectToBest();
+    void failOver();
+    bool send(const QString& sMessage);
+    bool acceptSequence(const ProtocolMessage& message);
+    void requestResync();
+    QString statusRequest() const;
+
+private:
+    QString              sServerUrl;
+    QWebSocket*          pSocket;
+    QTimer*              pConnectionTimer;
+    QTimer*              pRefreshTimer;
+    ClockSync            clockSync;
+    bool                 bStillConnected;
+    quint16              discoveryPort;
+    QHostAddress         discoveryGroup;
+    ControllerDiscovery* pDiscovery;
+    QUrl                 currentUrl;
+    QHostAddress         multicastGroup;
+    quint16              multicastPort;
+    QString              sMulticastInterface;
+    MulticastReceiver*   pMulticast;
+    qint64               lastSeq;
+    qint64               lastResync;
+};
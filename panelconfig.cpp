@@ -0,0 +1,193 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "panelconfig.h"
+#include "utility.h"
+
+#include <QCoreApplication>
+#include <QDir>
+#include <QFile>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QSaveFile>
+#include <QSettings>
+#include <QStandardPaths>
+#include <QThread>
+
+
+#define FLUSH_DELAY 2000 // msec: a burst of changes is written once
+
+
+/*!
+ * \brief PanelConfig::instance The configuration of the Panel
+ * \return The only store, loaded on first use
+ *
+ * It must be used from the GUI thread only.
+ */
+PanelConfig*
+PanelConfig::instance() {
+    static PanelConfig* pInstance = Q_NULLPTR;
+    if(!pInstance)
+        pInstance = new PanelConfig(QCoreApplication::instance());
+    return pInstance;
+}
+
+
+PanelConfig::PanelConfig(QObject *parent)
+    : QObject(parent)
+    , bDirty(false)
+{
+    QString sConfigDir = QStandardPaths::writableLocation(QStandardPaths::GenericConfigLocation) +
+                         QString("/VolleyPanel");
+    QDir().mkpath(sConfigDir);
+    sFileName = sConfigDir + QString("/panel.json");
+
+    flushTimer.setSingleShot(true);
+    flushTimer.setInterval(FLUSH_DELAY);
+    connect(&flushTimer, SIGNAL(timeout()),
+            this, SLOT(flush()));
+
+    // The SD card may be slow: the writes never block the GUI thread
+    pWriterThread = new QThread();
+    pWriterThread->setObjectName(QString("Config"));
+    pWriter = new QObject();
+    pWriter->moveToThread(pWriterThread);
+    connect(pWriterThread, SIGNAL(finished()),
+            pWriter, SLOT(deleteLater()));
+    pWriterThread->start(QThread::LowestPriority);
+
+    load();
+}
+
+
+PanelConfig::~PanelConfig() {
+    flush();
+    // Wait for the pending writes before stopping the writer
+    QMetaObject::invokeMethod(pWriter, []() {}, Qt::BlockingQueuedConnection);
+    pWriterThread->quit();
+    pWriterThread->wait();
+    delete pWriterThread;
+}
+
+
+/*!
+ * \brief PanelConfig::load Reads the whole configuration in memory
+ *
+ * The first time the values of the old QSettings stores are imported.
+ */
+void
+PanelConfig::load() {
+    QFile configFile(sFileName);
+    if(configFile.open(QIODevice::ReadOnly)) {
+        QJsonParseError error;
+        QJsonDocument document = QJsonDocument::fromJson(configFile.readAll(), &error);
+        if(error.error == QJsonParseError::NoError && document.isObject()) {
+            values = document.object().toVariantMap();
+            return;
+        }
+        logMessage(Q_NULLPTR,
+                   Q_FUNC_INFO,
+                   QString("Corrupted %1: %2").arg(sFileName, error.errorString()));
+    }
+    if(migrate()) {
+        bDirty = true;
+        flushTimer.start();
+    }
+}
+
+
+/*!
+ * \brief PanelConfig::migrate Imports the old QSettings stores
+ * \return true if some value has been imported
+ *
+ * The language was read from "Volley Panel": it wins over the others.
+ */
+bool
+PanelConfig::migrate() {
+    const QStringList legacyStores = {
+        QString("Segnapunti Volley"),
+        QString("Score Panel"),
+        QString("Volley Panel")
+    };
+    for(const QString& sStore : legacyStores) {
+        QSettings settings("Gabriele Salvato", sStore);
+        const QStringList keys = settings.allKeys();
+        for(const QString& sKey : keys)
+            values.insert(sKey, settings.value(sKey));
+    }
+    return !values.isEmpty();
+}
+
+
+QVariant
+PanelConfig::value(const QString& sKey, const QVariant& defaultValue) const {
+    return values.value(sKey, defaultValue);
+}
+
+
+/*!
+ * \brief PanelConfig::setValue Changes a value in memory
+ *
+ * The file is written (once) when no more changes arrive for FLUSH_DELAY.
+ */
+void
+PanelConfig::setValue(const QString& sKey, const QVariant& newValue) {
+    QVariantMap::const_iterator it = values.constFind(sKey);
+    if(it != values.constEnd() && it.value() == newValue)
+        return;
+    values.insert(sKey, newValue);
+    bDirty = true;
+    flushTimer.start();
+}
+
+
+/*!
+ * \brief PanelConfig::flush Hands a snapshot of the values to the writer thread
+ */
+void
+PanelConfig::flush() {
+    if(!bDirty)
+        return;
+    bDirty = false;
+    flushTimer.stop();
+    QByteArray baContent = QJsonDocument(QJsonObject::fromVariantMap(values)).toJson();
+    QString sFile = sFileName;
+    QMetaObject::invokeMethod(pWriter,
+                              [sFile, baContent]() {
+                                  writeFile(sFile, baContent);
+                              },
+                              Qt::QueuedConnection);
+}
+
+
+/*!
+ * \brief PanelConfig::writeFile Replaces the file atomically (temporary file + rename)
+ */
+void
+PanelConfig::writeFile(QString sFileName, QByteArray baContent) {
+    QSaveFile configFile(sFileName);
+    if(!configFile.open(QIODevice::WriteOnly) ||
+       configFile.write(baContent) != baContent.size() ||
+       !configFile.commit())
+    {
+        logMessage(Q_NULLPTR,
+                   Q_FUNC_INFO,
+                   QString("Unable to write %1: %2")
+                   .arg(sFileName, configFile.errorString()));
+    }
+}
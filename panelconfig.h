@@ -0,0 +1,54 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QObject>
+#include <QVariantMap>
+#include <QTimer>
+
+QT_FORWARD_DECLARE_CLASS(QThread)
+
+
+class PanelConfig : public QObject
+{
+    Q_OBJECT
+
+public:
+    static PanelConfig* instance();
+    QVariant value(const QString& sKey, const QVariant& defaultValue = QVariant()) const;
+    void setValue(const QString& sKey, const QVariant& newValue);
+
+public slots:
+    void flush();
+
+private:
+    explicit PanelConfig(QObject *parent = nullptr);
+    ~PanelConfig();
+    void load();
+    bool migrate();
+    static void writeFile(QString sFileName, QByteArray baContent);
+
+private:
+    QString     sFileName;
+    QVariantMap values;
+    QTimer      flushTimer;
+    bool        bDirty;
+    QThread*    pWriterThread;
+    QObject*    pWriter;
+};
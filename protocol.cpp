@@ -0,0 +1,158 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include "protocol.h"
+
+
+using namespace Protocol;
+
+
+#define MAX_DIGITS 18 // No overflow in a qint64
+
+
+ProtocolMessage::ProtocolMessage()
+    : present(0)
+    , rejected(0)
+    , nTags(0)
+{
+}
+
+
+/*!
+ * \brief ProtocolMessage::parse Decodes all the <tag>value</tag> of a message
+ * \param sNewMessage
+ *
+ * The message is scanned once: every name is hashed while it is read and
+ * identified by Protocol::lookup(). Values are checked and, if needed,
+ * replaced by the fallback of the schema. Only the first occurrence of a
+ * tag is used; unknown tags are ignored.
+ */
+void
+ProtocolMessage::parse(const QString& sNewMessage) {
+    sMessage = sNewMessage;
+    present  = 0;
+    rejected = 0;
+    nTags    = 0;
+    const QChar* p = sMessage.constData();
+    int n = sMessage.size();
+    int i = 0;
+    while(i < n) {
+        if(p[i] != QLatin1Char('<')) {
+            i++;
+            continue;
+        }
+        // Opening tag
+        int nameStart = i+1;
+        int j = nameStart;
+        quint32 h = hashOffset;
+        while(j < n && p[j] != QLatin1Char('>') && p[j] != QLatin1Char('<') && p[j] != QLatin1Char('/')) {
+            h = (h ^ quint32(p[j].unicode())) * hashPrime;
+            j++;
+        }
+        if(j >= n || j == nameStart || p[j] != QLatin1Char('>')) {
+            i = qMax(j, i+1);
+            continue;
+        }
+        int nameLength = j-nameStart;
+        // Value
+        int valueStart = j+1;
+        int k = valueStart;
+        while(k < n && p[k] != QLatin1Char('<'))
+            k++;
+        // Closing tag (it must have the same name)
+        if(k+1 >= n || p[k+1] != QLatin1Char('/')) {
+            i = k;
+            continue;
+        }
+        int m = k+2;
+        quint32 hClose = hashOffset;
+        while(m < n && p[m] != QLatin1Char('>')) {
+            hClose = (hClose ^ quint32(p[m].unicode())) * hashPrime;
+            m++;
+        }
+        if(m >= n || hClose != h || m-(k+2) != nameLength) {
+            i = k;
+            continue;
+        }
+        Tag tag = lookup(h, nameLength);
+        if(tag != Tag::Unknown && !has(tag) && !(rejected & bit(tag)))
+            store(tag, valueStart, k-valueStart);
+        i = m+1;
+    }
+}
+
+
+/*!
+ * \brief ProtocolMessage::store Validate and keep the value of a tag
+ */
+void
+ProtocolMessage::store(Tag tag, int valueStart, int valueLength) {
+    const TagSpec& tagSpec = spec(tag);
+    if(tagSpec.type == Type::Text) {
+        textStart[int(tag)]  = valueStart;
+        textLength[int(tag)] = int(qMin(qint64(valueLength), tagSpec.max));
+        numbers[int(tag)]    = 0;
+    }
+    else {
+        const QChar* p = sMessage.constData() + valueStart;
+        int first = 0;
+        int last  = valueLength;
+        while(first < last && p[first].isSpace()) first++;
+        while(last > first && p[last-1].isSpace()) last--;
+        bool bNegative = false;
+        if(first < last && (p[first] == QLatin1Char('-') || p[first] == QLatin1Char('+'))) {
+            bNegative = (p[first] == QLatin1Char('-'));
+            first++;
+        }
+        qint64 number = 0;
+        bool bParsed = (last > first) && (last-first <= MAX_DIGITS);
+        for(int i=first; bParsed && i<last; i++) {
+            ushort c = p[i].unicode();
+            if(c < '0' || c > '9')
+                bParsed = false;
+            else
+                number = 10*number + (c-'0');
+        }
+        Value value = validate(tag, bParsed, bNegative ? -number : number);
+        if(!value.accepted) {
+            rejected |= bit(tag);
+            return;
+        }
+        numbers[int(tag)] = value.number;
+    }
+    present |= bit(tag);
+    order[nTags++] = tag;
+}
+
+
+/*!
+ * \brief ProtocolMessage::isMergeable
+ * \return true if the message only carries score state
+ */
+bool
+ProtocolMessage::isMergeable() const {
+    return present != 0 && ((present | rejected) & ~mergeableTags()) == 0;
+}
+
+
+QString
+ProtocolMessage::text(Tag tag) const {
+    if(!has(tag) || spec(tag).type != Type::Text)
+        return QString();
+    return sMessage.mid(textStart[int(tag)], textLength[int(tag)]);
+}
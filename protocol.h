@@ -0,0 +1,328 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QString>
+#include <QMetaType>
+#include <limits>
+
+
+namespace Protocol {
+
+enum class Type {
+    Flag, // Only its presence matters
+    Int,  // An integer in [min, max]
+    Bool, // Any integer: 0 = false
+    Text  // At most max characters
+};
+
+constexpr qint64 Max    = std::numeric_limits<qint64>::max();
+constexpr qint64 Reject = std::numeric_limits<qint64>::min(); // Fallback: discard the tag
+
+
+/*!
+ * \brief PROTOCOL_SCHEMA The messages exchanged with the controller
+ *
+ * One line for each tag: identifier, tag, type, min, max, fallback
+ * (the value used when the received one is missing or out of range)
+ * and whether the tag carries score state (and may be merged with the
+ * same tag of a newer message).
+ */
+#define PROTOCOL_SCHEMA(X) \
+    /* Score */ \
+    X(Team0,           "team0",           Text, 0,  40,    0,      true)  \
+    X(Team1,           "team1",           Text, 0,  40,    0,      true)  \
+    X(Set0,            "set0",            Int,  0,  3,     8,      true)  \
+    X(Set1,            "set1",            Int,  0,  3,     8,      true)  \
+    X(Timeout0,        "timeout0",        Int,  0,  2,     8,      true)  \
+    X(Timeout1,        "timeout1",        Int,  0,  2,     8,      true)  \
+    X(Score0,          "score0",          Int,  0,  99,    99,     true)  \
+    X(Score1,          "score1",          Int,  0,  99,    99,     true)  \
+    X(Servizio,        "servizio",        Int,  -1, 1,     0,      true)  \
+    X(Seq,             "seq",             Int,  0,  Max,   Reject, true)  \
+    X(StartTimeout,    "startTimeout",    Int,  0,  86400, 30,     false) \
+    X(TimeoutDeadline, "timeoutDeadline", Int,  0,  Max,   Reject, false) \
+    X(StopTimeout,     "stopTimeout",     Flag, 0,  0,     0,      false) \
+    /* Panel commands */ \
+    X(Kill,            "kill",            Int,  0,  1,     0,      false) \
+    X(SpotDir,         "spotdir",         Text, 0,  4096,  0,      false) \
+    X(SpotLoop,        "spotloop",        Flag, 0,  0,     0,      false) \
+    X(EndSpotLoop,     "endspotloop",     Flag, 0,  0,     0,      false) \
+    X(SlideDir,        "slidedir",        Text, 0,  4096,  0,      false) \
+    X(SlideShow,       "slideshow",       Flag, 0,  0,     0,      false) \
+    X(EndSlideShow,    "endslideshow",    Flag, 0,  0,     0,      false) \
+    X(Live,            "live",            Flag, 0,  0,     0,      false) \
+    X(EndLive,         "endlive",         Flag, 0,  0,     0,      false) \
+    X(Pan,             "pan",             Flag, 0,  0,     0,      false) \
+    X(Tilt,            "tilt",            Flag, 0,  0,     0,      false) \
+    X(GetPanTilt,      "getPanTilt",      Flag, 0,  0,     0,      false) \
+    X(GetOrientation,  "getOrientation",  Flag, 0,  0,     0,      false) \
+    X(SetOrientation,  "setOrientation",  Int,  0,  1,     Reject, false) \
+    X(GetScoreOnly,    "getScoreOnly",    Flag, 0,  0,     0,      false) \
+    X(SetScoreOnly,    "setScoreOnly",    Bool, 0,  1,     Reject, false) \
+    X(Trace,           "trace",           Int,  0,  1,     0,      false) \
+    X(GetMetrics,      "getMetrics",      Flag, 0,  0,     0,      false) \
+    X(Overlay,         "overlay",         Bool, 0,  1,     Reject, false) \
+    X(Language,        "language",        Text, 0,  64,    0,      false) \
+    X(TimeSyncReply,   "timeSyncReply",   Text, 0,  128,   0,      false) \
+    /* Controller discovery (UDP) */ \
+    X(Controller,      "controller",      Int,  1,  65535, Reject, false) \
+    X(DiscoveryProbe,  "discoveryProbe",  Int,  0,  Max,   Reject, false) \
+    X(DiscoveryReply,  "discoveryReply",  Int,  0,  Max,   Reject, false) \
+    /* Panel replies */ \
+    X(Orientation,     "orientation",     Int,  0,  1,     0,      false) \
+    X(IsScoreOnly,     "isScoreOnly",     Int,  0,  1,     0,      false) \
+    X(ClosedSpot,      "closed_spot",     Int,  0,  1,     0,      false) \
+    X(ClosedLive,      "closed_live",     Int,  0,  1,     0,      false)
+
+
+#define PROTOCOL_ENUM(id, tag, type, min, max, fallback, merge) id,
+enum class Tag : int {
+    PROTOCOL_SCHEMA(PROTOCOL_ENUM)
+    Count,
+    Unknown = -1
+};
+#undef PROTOCOL_ENUM
+
+
+struct TagSpec {
+    const char* name;
+    int         length;
+    Type        type;
+    qint64      min;
+    qint64      max;
+    qint64      fallback;
+    bool        merge;
+};
+
+
+constexpr quint32 hashOffset = 2166136261u;
+constexpr quint32 hashPrime  = 16777619u;
+
+
+constexpr int
+length(const char* sText) {
+    int n = 0;
+    while(sText[n] != '\0')
+        n++;
+    return n;
+}
+
+
+/*!
+ * \brief hash FNV-1a of a tag name
+ */
+constexpr quint32
+hash(const char* sText) {
+    quint32 h = hashOffset;
+    for(int i=0; sText[i] != '\0'; i++)
+        h = (h ^ quint32(uchar(sText[i]))) * hashPrime;
+    return h;
+}
+
+
+#define PROTOCOL_SPEC(id, tag, type, min, max, fallback, merge) \
+    TagSpec{ tag, length(tag), Type::type, min, max, fallback, merge },
+inline constexpr TagSpec schema[] = {
+    PROTOCOL_SCHEMA(PROTOCOL_SPEC)
+};
+#undef PROTOCOL_SPEC
+
+constexpr int nTags = int(Tag::Count);
+static_assert(nTags <= 64, "The tags must fit in a 64 bit mask");
+
+
+constexpr const TagSpec&
+spec(Tag tag) {
+    return schema[int(tag)];
+}
+
+
+constexpr quint64
+bit(Tag tag) {
+    return quint64(1) << int(tag);
+}
+
+
+constexpr bool
+hashesAreUnique() {
+    for(int i=0; i<nTags; i++)
+        for(int j=i+1; j<nTags; j++)
+            if(hash(schema[i].name) == hash(schema[j].name))
+                return false;
+    return true;
+}
+static_assert(hashesAreUnique(), "Two protocol tags have the same hash: rename one");
+
+
+constexpr quint64
+mergeableTags() {
+    quint64 mask = 0;
+    for(int i=0; i<nTags; i++)
+        if(schema[i].merge)
+            mask |= quint64(1) << i;
+    return mask;
+}
+
+
+/*!
+ * \brief lookup Perfect hash of the tag names
+ * \param h FNV-1a of the received name
+ * \param nameLength Length of the received name
+ * \return The tag or Tag::Unknown
+ *
+ * The hashes are unique (see above) so a tag is identified by its hash;
+ * the length check rejects most of the unknown names that could collide.
+ */
+#define PROTOCOL_CASE(id, tag, type, min, max, fallback, merge) \
+    case hash(tag): return (nameLength == length(tag)) ? Tag::id : Tag::Unknown;
+constexpr Tag
+lookup(quint32 h, int nameLength) {
+    switch(h) {
+        PROTOCOL_SCHEMA(PROTOCOL_CASE)
+        default: return Tag::Unknown;
+    }
+}
+#undef PROTOCOL_CASE
+
+
+/*!
+ * \brief The result of the validation of a received value
+ */
+struct Value {
+    bool   accepted;
+    qint64 number;
+};
+
+
+/*!
+ * \brief validate Apply the range and the fallback of the schema
+ * \param tag
+ * \param bParsed true if the received value is a valid number
+ * \param number The received value
+ */
+constexpr Value
+validate(Tag tag, bool bParsed, qint64 number) {
+    const TagSpec& tagSpec = spec(tag);
+    if(tagSpec.type == Type::Flag)
+        return Value{ true, 0 };
+    if(tagSpec.type == Type::Bool && bParsed)
+        return Value{ true, number != 0 ? 1 : 0 };
+    if(tagSpec.type == Type::Int && bParsed &&
+       number >= tagSpec.min && number <= tagSpec.max)
+        return Value{ true, number };
+    if(tagSpec.fallback == Reject)
+        return Value{ false, 0 };
+    return Value{ true, tagSpec.fallback };
+}
+
+static_assert(validate(Tag::Set0,  true,  5).number == 8,  "set fallback");
+static_assert(validate(Tag::Score0, false, 0).number == 99, "score fallback");
+static_assert(!validate(Tag::SetOrientation, true, 2).accepted, "orientation reject");
+
+
+/*!
+ * \brief A serialized message: no heap allocation
+ */
+struct Buffer {
+    char data[64];
+    int  length;
+    QString toString() const {
+        return QString::fromLatin1(data, length);
+    }
+};
+
+
+/*!
+ * \brief serialize Builds <tag>number</tag>
+ */
+template<Tag T>
+Buffer
+serialize(qint64 number) {
+    constexpr const TagSpec& tagSpec = spec(T);
+    static_assert(tagSpec.type != Type::Text, "Text tags are not serialized here");
+    static_assert(2*tagSpec.length+5+20 <= int(sizeof(Buffer::data)), "Tag too long");
+    Buffer buffer;
+    int n = 0;
+    buffer.data[n++] = '<';
+    for(int i=0; i<tagSpec.length; i++)
+        buffer.data[n++] = tagSpec.name[i];
+    buffer.data[n++] = '>';
+    char digits[20];
+    int nDigits = 0;
+    bool bNegative = number < 0;
+    quint64 magnitude = bNegative ? quint64(0)-quint64(number) : quint64(number);
+    do {
+        digits[nDigits++] = char('0' + magnitude%10);
+        magnitude /= 10;
+    } while(magnitude > 0);
+    if(bNegative)
+        buffer.data[n++] = '-';
+    while(nDigits > 0)
+        buffer.data[n++] = digits[--nDigits];
+    buffer.data[n++] = '<';
+    buffer.data[n++] = '/';
+    for(int i=0; i<tagSpec.length; i++)
+        buffer.data[n++] = tagSpec.name[i];
+    buffer.data[n++] = '>';
+    buffer.length = n;
+    return buffer;
+}
+
+} // namespace Protocol
+
+
+/*!
+ * \brief A received message parsed with the protocol schema
+ */
+class ProtocolMessage
+{
+public:
+    ProtocolMessage();
+    void parse(const QString& sNewMessage);
+    bool has(Protocol::Tag tag) const {
+        return (present & Protocol::bit(tag)) != 0;
+    }
+    bool hasAny(quint64 tags) const {
+        return (present & tags) != 0;
+    }
+    bool isEmpty() const { return present == 0; }
+    bool isMergeable() const;
+    int count() const { return nTags; }
+    Protocol::Tag tag(int index) const { return order[index]; }
+    qint64 number(Protocol::Tag tag) const { return numbers[int(tag)]; }
+    QString text(Protocol::Tag tag) const;
+    const QString& message() const { return sMessage; }
+    quint64 rejectedTags() const { return rejected; }
+
+private:
+    void store(Protocol::Tag tag, int valueStart, int valueLength);
+
+private:
+    QString        sMessage;
+    quint64        present;
+    quint64        rejected;
+    int            nTags;
+    Protocol::Tag  order[Protocol::nTags];
+    qint64         numbers[Protocol::nTags];
+    int            textStart[Protocol::nTags];
+    int            textLength[Protocol::nTags];
+};
+
+Q_DECLARE_METATYPE(ProtocolMessage)
@@ -0,0 +1,89 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QFileInfo>
+#include <QDateTime>
+#include <QImage>
+
+#include "resourcecache.h"
+#include "imageresampler.h"
+#include "metrics.h"
+
+
+QHash<QString, ResourceCache::Entry> ResourceCache::entries;
+
+
+qint64
+ResourceCache::lastModified(const QString& sFileName) {
+    if(sFileName.startsWith(QString(":/"))) // Built in: never changes
+        return 0;
+    return QFileInfo(sFileName).lastModified().toMSecsSinceEpoch();
+}
+
+
+/*!
+ * \brief ResourceCache::pixmap
+ * \param sFileName A file or a resource (":/...")
+ * \return The image of the file (a null pixmap if it cannot be read)
+ */
+QPixmap
+ResourceCache::pixmap(const QString& sFileName) {
+    qint64 modified = lastModified(sFileName);
+    auto entry = entries.find(sFileName);
+    if(entry != entries.end() && entry->modified == modified)
+        return entry->pixmap;
+    entries.insert(sFileName, Entry{modified, QPixmap(sFileName)});
+    Metrics::cachedImageBytes.set(double(cacheBytes()));
+    return entries.value(sFileName).pixmap;
+}
+
+
+/*!
+ * \brief ResourceCache::pixmap
+ * \param sFileName A file or a resource (":/...")
+ * \param size The size of the scaled image
+ * \return The scaled image
+ */
+QPixmap
+ResourceCache::pixmap(const QString& sFileName, QSize size) {
+    QString sKey = QString("%1@%2x%3").arg(sFileName).arg(size.width()).arg(size.height());
+    qint64 modified = lastModified(sFileName);
+    auto entry = entries.find(sKey);
+    if(entry != entries.end() && entry->modified == modified)
+        return entry->pixmap;
+    QPixmap scaled = QPixmap::fromImage(ImageResampler::scaled(QImage(sFileName), size));
+    entries.insert(sKey, Entry{modified, scaled});
+    Metrics::cachedImageBytes.set(double(cacheBytes()));
+    return scaled;
+}
+
+
+void
+ResourceCache::clear() {
+    entries.clear();
+    Metrics::cachedImageBytes.set(0.0);
+}
+
+
+qint64
+ResourceCache::cacheBytes() {
+    qint64 nBytes = 0;
+    for(const Entry& entry : qAsConst(entries))
+        nBytes += qint64(entry.pixmap.width())*entry.pixmap.height()*entry.pixmap.depth()/8;
+    return nBytes;
+}
@@ -0,0 +1,50 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QHash>
+#include <QPixmap>
+#include <QString>
+
+
+/*!
+ * \brief The images (logos, icons) shared by the windows of the Panel
+ *
+ * The cache owns one QPixmap for each file (and size): the windows get
+ * implicitly shared copies, so nothing has to be deleted by them.
+ * A file changed on disk (e.g. an uploaded logo) replaces its entry.
+ * To be used in the GUI thread only and cleared before the QApplication
+ * is destroyed (see ~VolleyApplication).
+ */
+class ResourceCache
+{
+public:
+    static QPixmap pixmap(const QString& sFileName);
+    static QPixmap pixmap(const QString& sFileName, QSize size);
+    static void clear();
+    static qint64 cacheBytes();
+
+private:
+    struct Entry {
+        qint64  modified;
+        QPixmap pixmap;
+    };
+    static qint64 lastModified(const QString& sFileName);
+    static QHash<QString, Entry> entries;
+};
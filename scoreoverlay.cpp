@@ -0,0 +1,171 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QApplication>
+#include <QScreen>
+#include <QPainter>
+#include <QFontMetrics>
+
+#include "scoreoverlay.h"
+
+
+#define OVERLAY_ROWS      18  // The bug row is 1/OVERLAY_ROWS of the screen height
+#define OVERLAY_OPACITY   200 // Alpha of the bug background
+#define TEAM_CHARS        14  // Width of the team column in characters
+
+
+/*!
+ * \brief ScoreOverlay::ScoreOverlay A small score "bug" shown on top of the videos
+ * \param parent
+ *
+ * The bug is rendered in a cached pixmap only when the score changes.
+ * It is shown either as a frameless window floating above the external
+ * player or drawn by the LiveWindow over the camera frames.
+ */
+ScoreOverlay::ScoreOverlay(QWidget *parent)
+    : QWidget(parent)
+    , sFontName(QString("Liberation Sans Bold"))
+    , rowHeight(32)
+    , margin(16)
+{
+    setWindowFlags(Qt::FramelessWindowHint |
+                   Qt::WindowStaysOnTopHint |
+                   Qt::X11BypassWindowManagerHint |
+                   Qt::Tool);
+    setAttribute(Qt::WA_TranslucentBackground);
+    setAttribute(Qt::WA_ShowWithoutActivating);
+    setAttribute(Qt::WA_TransparentForMouseEvents);
+    setFocusPolicy(Qt::NoFocus);
+
+    QRect screenres = QApplication::primaryScreen()->geometry();
+    QList<QScreen*> screens = QApplication::screens();
+    if(screens.count() > 1)
+        screenres = screens.at(1)->geometry();
+    rowHeight = qMax(16, screenres.height()/OVERLAY_ROWS);
+    margin    = rowHeight/2;
+    render();
+    move(screenres.topLeft() + position());
+}
+
+
+/*!
+ * \brief ScoreOverlay::setState Render the bug again only if the score changed
+ * \param newState
+ */
+void
+ScoreOverlay::setState(const ScoreState& newState) {
+    if(newState == state)
+        return;
+    state = newState;
+    render();
+    update();
+    emit changed();
+}
+
+
+const QPixmap&
+ScoreOverlay::pixmap() const {
+    return bug;
+}
+
+
+/*!
+ * \brief ScoreOverlay::position
+ * \return The top left corner of the bug relative to the screen
+ */
+QPoint
+ScoreOverlay::position() const {
+    return QPoint(margin, margin);
+}
+
+
+/*!
+ * \brief ScoreOverlay::showOnTop Show the bug above any other window
+ *
+ * To be called again once the external player has opened its window.
+ */
+void
+ScoreOverlay::showOnTop() {
+    show();
+    raise();
+}
+
+
+void
+ScoreOverlay::paintEvent(QPaintEvent *event) {
+    Q_UNUSED(event)
+    QPainter painter(this);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.drawPixmap(0, 0, bug);
+}
+
+
+/*!
+ * \brief ScoreOverlay::render Draw the bug in the cached pixmap
+ *
+ * One row for each team: serve marker, name, sets and points.
+ */
+void
+ScoreOverlay::render() {
+    QFont font(sFontName, 10, QFont::Black);
+    font.setPixelSize(rowHeight*2/3);
+    QFontMetrics metrics(font);
+    int pad       = rowHeight/4;
+    int markWidth = rowHeight/2;
+    int teamWidth = metrics.averageCharWidth()*TEAM_CHARS;
+    int setWidth  = metrics.horizontalAdvance(QString("8"))+2*pad;
+    int scoreWidth= metrics.horizontalAdvance(QString("88"))+2*pad;
+    int width     = pad+markWidth+pad+teamWidth+setWidth+scoreWidth;
+
+    bug = QPixmap(width, 2*rowHeight);
+    bug.fill(Qt::transparent);
+    QPainter painter(&bug);
+    painter.setRenderHint(QPainter::Antialiasing);
+    painter.setPen(Qt::NoPen);
+    painter.setBrush(QColor(0, 0, 64, OVERLAY_OPACITY));
+    painter.drawRoundedRect(bug.rect(), pad, pad);
+    painter.setFont(font);
+
+    for(int i=0; i<2; i++) {
+        int top = i*rowHeight;
+        int x = pad;
+        if(state.servizio == i) {
+            painter.setPen(Qt::NoPen);
+            painter.setBrush(Qt::yellow);
+            painter.drawEllipse(QRect(x, top+(rowHeight-markWidth)/2, markWidth, markWidth));
+        }
+        x += markWidth+pad;
+        painter.setPen(Qt::white);
+        painter.drawText(QRect(x, top, teamWidth, rowHeight),
+                         Qt::AlignLeft|Qt::AlignVCenter,
+                         metrics.elidedText(state.team[i], Qt::ElideRight, teamWidth));
+        x += teamWidth;
+        painter.setPen(Qt::yellow);
+        painter.drawText(QRect(x, top, setWidth, rowHeight),
+                         Qt::AlignCenter,
+                         QString::number(state.set[i]));
+        x += setWidth;
+        painter.fillRect(QRect(x, top+1, scoreWidth, rowHeight-2), QColor(255, 255, 255, OVERLAY_OPACITY));
+        painter.setPen(Qt::black);
+        painter.drawText(QRect(x, top, scoreWidth, rowHeight),
+                         Qt::AlignCenter,
+                         QString::number(state.score[i]));
+    }
+    painter.end();
+    setFixedSize(bug.size());
+}
@@ -0,0 +1,55 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QWidget>
+#include <QPixmap>
+
+#include "scorestate.h"
+
+
+class ScoreOverlay : public QWidget
+{
+    Q_OBJECT
+
+public:
+    explicit ScoreOverlay(QWidget *parent = nullptr);
+    void setState(const ScoreState& newState);
+    const QPixmap& pixmap() const;
+    QPoint position() const;
+
+public slots:
+    void showOnTop();
+
+signals:
+    void changed(); /*!< \brief emitted when the overlay has been rendered again */
+
+protected:
+    void paintEvent(QPaintEvent *event);
+
+private:
+    void render();
+
+private:
+    ScoreState state;
+    QPixmap    bug;
+    QString    sFontName;
+    int        rowHeight;
+    int        margin;
+};
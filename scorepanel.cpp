@@ -21,33 +21,70 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QtNetwork>
 #include <QtWidgets>
 #include <QProcess>
-#include <QWebSocket>
 #include <QVBoxLayout>
-#include <QSettings>
 #include <QDebug>
 
 
 #include "slidewindow.h"
 #include "scorepanel.h"
+#include "cameraingest.h"
+#include "livewindow.h"
+#include "scoreoverlay.h"
+#include "uploadreceiver.h"
+#include "metrics.h"
+#include "metricsserver.h"
+#include "networkworker.h"
+#include "panelconfig.h"
+#include "trace.h"
+#include "stallwatchdog.h"
+#include "frameexport.h"
+#include "mjpegserver.h"
 #include "utility.h"
 #include "panelorientation.h"
 #include "volleyapplication.h"
+#include "startuptrace.h"
 
 
 #define SERVER_PORT           45454
+#define OVERLAY_RAISE_DELAY   1000 // msec for the player to open its window
+#define METRICS_PORT          9180 // Prometheus endpoint (0 to disable)
+#define DISCOVERY_PORT           0 // Controller announcements (opt-in, e.g. 45455)
+#define MULTICAST_PORT       45456 // Score channel (only with a multicast/group)
+#define FRAME_EXPORT_NAME    "/volleypanel" // Shared memory with the rendered frames
+#define STREAM_FPS               5 // Maximum frame rate of the MJPEG stream
+#define STREAM_QUALITY          75 // JPEG quality of the MJPEG stream
 
 
 ScorePanel::ScorePanel(QFile *myLogFile, QWidget *parent)
     : QMainWindow(parent)
     , isMirrored(false)
     , isScoreOnly(false)
-    , pPanelServerSocket(new QWebSocket())
+    , pNetworkThread(nullptr)
+    , pNetworkWorker(nullptr)
+    , bConnected(false)
     , logFile(myLogFile)
+    , bClosing(false)
     , videoPlayer(nullptr)
-    , cameraPlayer(nullptr)
     , iCurrentSpot(0)
     , iCurrentSlide(0)
-    , pMySlideWindow(new SlideWindow())
+    , pMySlideWindow(nullptr) // Created on first use
+    , pIngestThread(nullptr)  // Created on first use
+    , pCameraIngest(nullptr)
+    , pLiveWindow(nullptr)
+    , bOverlay(false)
+    , pScoreOverlay(nullptr) // Created on first use
+    , pUploadThread(nullptr)  // Created on the first upload
+    , pUploadReceiver(nullptr)
+    , pMetricsServer(nullptr)
+    , pWatchdog(nullptr)
+    , pFrameExport(nullptr)
+    , bExportOverlay(false)
+    , bFrameExported(false)
+    , pStreamThread(nullptr)
+    , pMjpegServer(nullptr)
+    , pStreamTimer(nullptr)
+    , bStreamDirty(false)
+    , bFlushScheduled(false)
     , pPanel(nullptr)
 #ifdef Q_OS_WINDOWS
     , sPlayer(QString("ffplay.exe"))
@@ -74,60 +111,132 @@ ScorePanel::ScorePanel(QFile *myLogFile, QWidget *parent)
     qApp->setOverrideCursor(Qt::BlankCursor);
     // We don't want windows decorations
     setWindowFlags(Qt::CustomizeWindowHint);
+    StartupTrace::mark("screens");
 
     serverUrl = QString("ws://localhost:%1").arg(SERVER_PORT);
 
-    pSettings = new QSettings("Gabriele Salvato", "Score Panel");
+    pSettings = PanelConfig::instance();
     isScoreOnly = pSettings->value("panel/scoreOnly",  false).toBool();
     isMirrored  = pSettings->value("panel/orientation",  false).toBool();
-
-    // Connect the RefreshTimer timeout() with its SLOT()
-    connect(&refreshTimer, SIGNAL(timeout()),
-            this, SLOT(onTimeToRefreshStatus()));
+    bOverlay    = pSettings->value("panel/overlay",  false).toBool();
 
     QString sBaseDir;
     sBaseDir = QDir::homePath();
     if(!sBaseDir.endsWith(QString("/"))) sBaseDir+= QString("/");
 
+    // The score shown before a restart (loaded by the derived panel)
+    QString sDataDir = QStandardPaths::writableLocation(QStandardPaths::GenericDataLocation);
+    if(!snapshot.open(sDataDir + QString("/VolleyPanel/score.snapshot")))
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Unable to open the score snapshot"));
+
     sSpotDir = QString("%1spots/").arg(sBaseDir);
     sSlideDir= QString("%1slides/").arg(sBaseDir);
 
     // Camera management
     initCamera();
 
-    // We are Ready to Connect to the Panel Server
-    pPanelServerSocket->ignoreSslErrors(); // To silent some warnings
-    // Events from the Panel Server WebSocket
-    connect(pPanelServerSocket, SIGNAL(connected()),
-            this, SLOT(onPanelServerConnected()));
-    connect(pPanelServerSocket, SIGNAL(error(QAbstractSocket::SocketError)),
-            this, SLOT(onPanelServerSocketError(QAbstractSocket::SocketError)));
+    // Metrics for the monitoring (loopback only, unless configured)
+    int iMetricsPort = pSettings->value("metrics/port", METRICS_PORT).toInt();
+    if(iMetricsPort > 0) {
+        QHostAddress metricsAddress(pSettings->value("metrics/address",
+                                                     QString("127.0.0.1")).toString());
+        pMetricsServer = new MetricsServer(logFile, this);
+        pMetricsServer->listen(metricsAddress, quint16(iMetricsPort));
+    }
 
-    // Let's Start to try to connect to Panel Server
-    connect(&connectionTimer, SIGNAL(timeout()),
-            this, SLOT(onConnectionTimeExipred()));
-    connectionTimer.start(1000);
+    // Stalls of the event loop (they delay the Panel updates)
+    pWatchdog = new StallWatchdog();
+    connect(pWatchdog, SIGNAL(stallDetected(QString,qint64)),
+            this, SLOT(onStallDetected(QString,qint64)));
+    pWatchdog->start();
+
+    initFrameExport();
+    initStream();
+
+    // We are Ready to Connect to the Panel Server: the socket, the
+    // heartbeat and the parsing live in their own thread
+    pNetworkThread = new QThread();
+    pNetworkThread->setObjectName(QString("Network"));
+    pNetworkWorker = new NetworkWorker(serverUrl);
+    pNetworkWorker->setDiscovery(quint16(pSettings->value("discovery/port", DISCOVERY_PORT).toInt()),
+                                 QHostAddress(pSettings->value("discovery/group", QString()).toString()));
+    pNetworkWorker->setMulticast(QHostAddress(pSettings->value("multicast/group", QString()).toString()),
+                                 quint16(pSettings->value("multicast/port", MULTICAST_PORT).toInt()),
+                                 pSettings->value("multicast/interface", QString()).toString());
+    pNetworkWorker->moveToThread(pNetworkThread);
+    // The socket and the timers must be destroyed in their own thread
+    connect(pNetworkThread, SIGNAL(finished()),
+            pNetworkWorker, SLOT(deleteLater()));
+    connect(pNetworkWorker, SIGNAL(messageReceived(ProtocolMessage)),
+            this, SLOT(onMessageReceived(ProtocolMessage)));
+    connect(pNetworkWorker, SIGNAL(connected()),
+            this, SLOT(onPanelServerConnected()));
+    connect(pNetworkWorker, SIGNAL(disconnected()),
+            this, SLOT(onPanelServerDisconnected()));
+    connect(pNetworkWorker, SIGNAL(serverLost()),
+            this, SLOT(onPanelServerLost()));
+    connect(pNetworkWorker, SIGNAL(clockSyncChanged(ClockSync)),
+            this, SLOT(onClockSyncChanged(ClockSync)));
+    connect(pNetworkWorker, SIGNAL(sendFailed(QString)),
+            this, SLOT(onSendFailed(QString)));
+    connect(pNetworkWorker, SIGNAL(statusMessage(QString)),
+            this, SLOT(onNetworkStatus(QString)));
+    pNetworkThread->start(QThread::HighPriority);
+    QMetaObject::invokeMethod(pNetworkWorker, "start", Qt::QueuedConnection);
+    StartupTrace::mark("score panel");
 }
 
 
 ScorePanel::~ScorePanel() {
-    refreshTimer.disconnect();
-    refreshTimer.stop();
-    if(pPanelServerSocket)
-        pPanelServerSocket->disconnect();
-    if(pSettings) delete pSettings;
-    pSettings = Q_NULLPTR;
-
+    if(pWatchdog) {
+        pWatchdog->stop();
+        delete pWatchdog;
+        pWatchdog = Q_NULLPTR;
+    }
     doProcessCleanup();
-
-    if(pPanelServerSocket)
-        delete pPanelServerSocket;
-    pPanelServerSocket = Q_NULLPTR;
+    if(pIngestThread) {
+        pIngestThread->quit();
+        pIngestThread->wait();
+        delete pIngestThread;
+        pIngestThread = Q_NULLPTR;
+    }
+    if(pLiveWindow)
+        delete pLiveWindow;
+    pLiveWindow = Q_NULLPTR;
+    if(pScoreOverlay)
+        delete pScoreOverlay;
+    pScoreOverlay = Q_NULLPTR;
+    if(pUploadThread) {
+        pUploadThread->quit();
+        pUploadThread->wait();
+        delete pUploadReceiver;
+        pUploadReceiver = Q_NULLPTR;
+        delete pUploadThread;
+        pUploadThread = Q_NULLPTR;
+    }
+    if(pStreamThread) {
+        QMetaObject::invokeMethod(pMjpegServer, "stop", Qt::BlockingQueuedConnection);
+        pStreamThread->quit();
+        pStreamThread->wait(); // pMjpegServer deleted on finished()
+        pMjpegServer = Q_NULLPTR;
+        delete pStreamThread;
+        pStreamThread = Q_NULLPTR;
+    }
+    if(pNetworkThread) {
+        pNetworkThread->quit();
+        pNetworkThread->wait(); // pNetworkWorker deleted on finished()
+        pNetworkWorker = Q_NULLPTR;
+        delete pNetworkThread;
+        pNetworkThread = Q_NULLPTR;
+    }
 }
 
 
 void
 ScorePanel::buildLayout() {
+    GUI_PHASE("ScorePanel::buildLayout");
     QWidget* oldPanel = pPanel;
     pPanel = new QWidget(this);
     QVBoxLayout *panelLayout = new QVBoxLayout();
@@ -163,12 +272,8 @@ ScorePanel::setScoreOnly(bool bScoreOnly) {
             videoPlayer->deleteLater();
             videoPlayer = Q_NULLPTR;
         }
-        if(cameraPlayer) {
-            cameraPlayer->close();
-            cameraPlayer->waitForFinished(3000);
-            cameraPlayer->deleteLater();
-            cameraPlayer = Q_NULLPTR;
-        }
+        closeLiveCamera();
+        hideOverlay();
     }
 }
 
@@ -180,86 +285,101 @@ ScorePanel::getScoreOnly() {
 
 
 void
-ScorePanel::onConnectionTimeExipred() {
-    // Try to (Re)Open the Server socket to talk to
-    pPanelServerSocket->open(QUrl(serverUrl));
+ScorePanel::onPanelServerConnected() {
+    bConnected = true;
 }
 
 
 void
-ScorePanel::onPanelServerConnected() {
-    connectionTimer.stop();
-    connect(pPanelServerSocket, SIGNAL(disconnected()),
-            this, SLOT(onPanelServerDisconnected()));
-    QString sMessage = QString("<getStatus>%1</getStatus>")
-                          .arg(QHostInfo::localHostName());
-    qint64 bytesSent = pPanelServerSocket->sendTextMessage(sMessage);
-    if(bytesSent != sMessage.length()) {
-        logMessage(logFile,
-                   Q_FUNC_INFO,
-                   QString("Unable to ask the initial status"));
-    }
-    bStillConnected = false;
-    refreshTimer.start(rand()%2000+3000);
+ScorePanel::onPanelServerDisconnected() {
+    bConnected = false;
 }
 
 
+/*!
+ * \brief ScorePanel::onPanelServerLost The controller stopped answering the heartbeat
+ */
 void
-ScorePanel::onTimeToRefreshStatus() {
-    if(!bStillConnected) {
+ScorePanel::onPanelServerLost() {
 #ifdef LOG_VERBOSE
-        logMessage(logFile,
-                   Q_FUNC_INFO,
-                   QString("Panel Server Disconnected"));
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               QString("Panel Server Disconnected"));
 #endif
-        if(pPanelServerSocket)
-            pPanelServerSocket->deleteLater();
-        pPanelServerSocket =Q_NULLPTR;
-        doProcessCleanup();
-        close();
-        emit panelClosed();
+    bConnected = false;
+    doProcessCleanup();
+    close();
+    emit panelClosed();
+}
+
+
+void
+ScorePanel::onClockSyncChanged(ClockSync newClockSync) {
+    clockSync = newClockSync;
+}
+
+
+/*!
+ * \brief ScorePanel::sendMessage Sends a message to the controller
+ * \param sMessage
+ *
+ * The message is queued to the network thread: a failure is reported
+ * later by onSendFailed().
+ */
+void
+ScorePanel::sendMessage(QString sMessage) {
+    if(!pNetworkWorker)
         return;
-    }
-    QString sMessage;
-    sMessage = QString("<getStatus>%1</getStatus>").arg(QHostInfo::localHostName());
-    qint64 bytesSent = pPanelServerSocket->sendTextMessage(sMessage);
-    if(bytesSent != sMessage.length()) {
+    QMetaObject::invokeMethod(pNetworkWorker,
+                              "sendTextMessage",
+                              Qt::QueuedConnection,
+                              Q_ARG(QString, sMessage));
 #ifdef LOG_VERBOSE
-        logMessage(logFile,
-                   Q_FUNC_INFO,
-                   QString("Unable to refresh the Panel status"));
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               QString("Sent %1")
+               .arg(sMessage));
 #endif
-        if(pPanelServerSocket)
-            pPanelServerSocket->deleteLater();
-        pPanelServerSocket =Q_NULLPTR;
-        doProcessCleanup();
-        close();
-        emit panelClosed();
-    }
-    bStillConnected = false;
 }
 
 
 void
-ScorePanel::onPanelServerDisconnected() {
-    refreshTimer.stop();
-    disconnect(pPanelServerSocket, SIGNAL(disconnected()),
-               this, SLOT(onPanelServerDisconnected()));
-    connectionTimer.start(1000);
+ScorePanel::onSendFailed(QString sMessage) {
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               QString("Unable to send %1")
+               .arg(sMessage));
+}
+
+
+void
+ScorePanel::onNetworkStatus(QString sMessage) {
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               sMessage);
+}
+
+
+/*!
+ * \brief ScorePanel::stopNetwork Closes the connection and stops the heartbeat
+ */
+void
+ScorePanel::stopNetwork() {
+    bConnected = false;
+    if(pNetworkThread && pNetworkThread->isRunning())
+        QMetaObject::invokeMethod(pNetworkWorker, "stop", Qt::BlockingQueuedConnection);
 }
 
 
 void
 ScorePanel::doProcessCleanup() {
+    WATCHDOG_PHASE("ScorePanel::doProcessCleanup");
 #ifdef LOG_VERBOSE
     logMessage(logFile,
                Q_FUNC_INFO,
                QString("Cleaning all processes"));
 #endif
-    connectionTimer.disconnect();
-    refreshTimer.disconnect();
-    connectionTimer.stop();
-    refreshTimer.stop();
+    stopNetwork();
 
     if(pMySlideWindow) {
         pMySlideWindow->close();
@@ -274,29 +394,52 @@ ScorePanel::doProcessCleanup() {
         videoPlayer->deleteLater();
         videoPlayer = Q_NULLPTR;
     }
-    if(cameraPlayer) {
-        cameraPlayer->close();
-        cameraPlayer->waitForFinished(3000);
-        cameraPlayer->deleteLater();
-        cameraPlayer = Q_NULLPTR;
-    }
+    closeLiveCamera();
+    hideOverlay();
 }
 
 
-void
-ScorePanel::onPanelServerSocketError(QAbstractSocket::SocketError error) {
-    Q_UNUSED(error)
-    refreshTimer.stop();
-    if(pPanelServerSocket->isValid())
-        pPanelServerSocket->close();
-    connectionTimer.start(1000);
+
+/*!
+ * \brief ScorePanel::event Measures the repaint of the whole window
+ * \param event
+ * \return
+ *
+ * The children are repainted while processing the UpdateRequest event.
+ */
+bool
+ScorePanel::event(QEvent *event) {
+    if(event->type() != QEvent::UpdateRequest)
+        return QMainWindow::event(event);
+    WATCHDOG_PHASE("ScorePanel::repaint");
+    QElapsedTimer repaintTimer;
+    repaintTimer.start();
+    bool bResult = QMainWindow::event(event);
+    Metrics::repaintTime.observe(repaintTimer.nsecsElapsed()/1000);
+    bFrameExported = pFrameExport && !bExportOverlay && pFrameExport->publish(this);
+    if(pMjpegServer && pMjpegServer->hasClients())
+        streamFrame();
+    return bResult;
 }
 
 
+/*!
+ * \brief ScorePanel::paintEvent Closes the start-up trace at the first frame
+ * \param event
+ */
+void
+ScorePanel::paintEvent(QPaintEvent *event) {
+    QMainWindow::paintEvent(event);
+    if(!StartupTrace::isDone())
+        StartupTrace::firstFrame(logFile);
+}
+
 
 void
 ScorePanel::closeEvent(QCloseEvent *event) {
+    bClosing = true;
     pSettings->setValue("panel/orientation", isMirrored);
+    pSettings->flush();
     doProcessCleanup();
     event->accept();
 }
@@ -305,11 +448,11 @@ ScorePanel::closeEvent(QCloseEvent *event) {
 void
 ScorePanel::keyPressEvent(QKeyEvent *event) {
     if(event->key() == Qt::Key_Escape) {
-        if(pPanelServerSocket) {
-            pPanelServerSocket->disconnect();
-            pPanelServerSocket->close(QWebSocketProtocol::CloseCodeNormal,
-                                      tr("Il Client ha chiuso il collegamento"));
-        }
+        if(pNetworkWorker)
+            QMetaObject::invokeMethod(pNetworkWorker,
+                                      "closeConnection",
+                                      Qt::QueuedConnection,
+                                      Q_ARG(QString, tr("Il Client ha chiuso il collegamento")));
         close();
     }
 }
@@ -317,6 +460,7 @@ ScorePanel::keyPressEvent(QKeyEvent *event) {
 
 void
 ScorePanel::onSpotClosed(int exitCode, QProcess::ExitStatus exitStatus) {
+    WATCHDOG_PHASE("ScorePanel::onSpotClosed");
     Q_UNUSED(exitCode);
     Q_UNUSED(exitStatus);
     if(videoPlayer) {
@@ -324,59 +468,16 @@ ScorePanel::onSpotClosed(int exitCode, QProcess::ExitStatus exitStatus) {
         videoPlayer->close();// Closes all communication with the process and kills it.
         delete videoPlayer;
         videoPlayer = Q_NULLPTR;
-        QString sMessage = "<closed_spot>1</closed_spot>";
-        qint64 bytesSent = pPanelServerSocket->sendTextMessage(sMessage);
-        if(bytesSent != sMessage.length()) {
-            logMessage(logFile,
-                       Q_FUNC_INFO,
-                       QString("Unable to send %1")
-                       .arg(sMessage));
-        }
-#ifdef LOG_VERBOSE
-        else {
-            logMessage(logFile,
-                       Q_FUNC_INFO,
-                       QString("Sent %1")
-                       .arg(sMessage));
-        }
-#endif
+        sendMessage(Protocol::serialize<Protocol::Tag::ClosedSpot>(1).toString());
     } // if(videoPlayer)
-    showFullScreen(); // Restore the Score Panel
-}
-
-
-void
-ScorePanel::onLiveClosed(int exitCode, QProcess::ExitStatus exitStatus) {
-    Q_UNUSED(exitCode);
-    Q_UNUSED(exitStatus);
-    if(cameraPlayer) {
-        cameraPlayer->disconnect();
-        cameraPlayer->close();
-        delete cameraPlayer;
-        cameraPlayer = Q_NULLPTR;
-        QString sMessage = "<closed_live>1</closed_live>";
-        qint64 bytesSent = pPanelServerSocket->sendTextMessage(sMessage);
-        if(bytesSent != sMessage.length()) {
-            logMessage(logFile,
-                       Q_FUNC_INFO,
-                       QString("Unable to send %1")
-                       .arg(sMessage));
-        }
-#ifdef LOG_VERBOSE
-        else {
-            logMessage(logFile,
-                       Q_FUNC_INFO,
-                       QString("Sent %1")
-                       .arg(sMessage));
-        }
-#endif
-    } // if(cameraPlayer)
+    hideOverlay();
     showFullScreen(); // Restore the Score Panel
 }
 
 
 void
 ScorePanel::onStartNextSpot(int exitCode, QProcess::ExitStatus exitStatus) {
+    GUI_PHASE("ScorePanel::onStartNextSpot");
     Q_UNUSED(exitCode);
     Q_UNUSED(exitStatus);
     showFullScreen(); // Ripristina lo Score Panel
@@ -397,15 +498,9 @@ ScorePanel::onStartNextSpot(int exitCode, QProcess::ExitStatus exitStatus) {
             videoPlayer->disconnect();
             delete videoPlayer;
             videoPlayer = Q_NULLPTR;
-            QString sMessage = "<closed_spot>1</closed_spot>";
-            qint64 bytesSent = pPanelServerSocket->sendTextMessage(sMessage);
-            if(bytesSent != sMessage.length()) {
-                logMessage(logFile,
-                           Q_FUNC_INFO,
-                           QString("Unable to send %1")
-                           .arg(sMessage));
-            }
+            sendMessage(Protocol::serialize<Protocol::Tag::ClosedSpot>(1).toString());
         }
+        hideOverlay();
         return;
     }
 
@@ -452,254 +547,618 @@ ScorePanel::onStartNextSpot(int exitCode, QProcess::ExitStatus exitStatus) {
         videoPlayer->disconnect();
         delete videoPlayer;
         videoPlayer = Q_NULLPTR;
+        hideOverlay();
         return;
     }
+    Metrics::processStarts.add();
     hide();
+    showOverlay();
 }
 
 
+/*!
+ * \brief ScorePanel::onMessageReceived Collects the messages of a burst
+ * \param message Already parsed and validated by the network thread
+ *
+ * The messages are dispatched all together when the event loop has
+ * processed all the pending network events: a burst of score messages
+ * then costs a single dispatch and a single repaint.
+ */
 void
-ScorePanel::onBinaryMessageReceived(QByteArray baMessage) {
-    logMessage(logFile,
-               Q_FUNC_INFO,
-               QString("Received %1 bytes").arg(baMessage.size()));
-}
-
-
-void
-ScorePanel::onTextMessageReceived(QString sMessage) {
-    refreshTimer.start(rand()%2000+3000);
-    bStillConnected = true;
-    QString sToken;
-    bool ok;
-    int iVal;
-    QString sNoData = QString("NoData");
-
-    sToken = XML_Parse(sMessage, "kill");
-    if(sToken != sNoData) {
-        iVal = sToken.toInt(&ok);
-        if(!ok || iVal<0 || iVal>1)
-            iVal = 0;
-        if(iVal == 1) {
-            pPanelServerSocket->disconnect();
-            #ifdef Q_PROCESSOR_ARM
-            system("sudo halt");
-            #endif
-            close();// emit the QCloseEvent that is responsible
-                    // to clean up all pending processes
-        }
-    }// kill
-
-    sToken = XML_Parse(sMessage, "spotdir");
-    if(sToken != sNoData){
-        sSpotDir = sToken;
-    }// slideshow
-
-    sToken = XML_Parse(sMessage, "spotloop");
-    if(sToken != sNoData && !isScoreOnly) {
-        startSpotLoop();
-    }// spotloop
-
-    sToken = XML_Parse(sMessage, "endspotloop");
-    if(sToken != sNoData) {
-        stopSpotLoop();
-    }// endspoloop
-
-    sToken = XML_Parse(sMessage, "slidedir");
-    if(sToken != sNoData){
-        sSlideDir = sToken;
-    }// slideshow
-
-    sToken = XML_Parse(sMessage, "slideshow");
-    if(sToken != sNoData && !isScoreOnly){
-        startSlideShow();
-    }// slideshow
-
-    sToken = XML_Parse(sMessage, "endslideshow");
-    if(sToken != sNoData) {
-        stopSlideShow();
-    }// endslideshow
-
-    sToken = XML_Parse(sMessage, "live");
-    if(sToken != sNoData && !isScoreOnly) {
-        startLiveCamera();
-    }// live
-
-    sToken = XML_Parse(sMessage, "endlive");
-    if(sToken != sNoData) {
-        stopLiveCamera();
-    }// endlive
-
-    sToken = XML_Parse(sMessage, "pan");
-    if(sToken != sNoData) {
-    }// pan
-
-    sToken = XML_Parse(sMessage, "tilt");
-    if(sToken != sNoData) {
-    }// tilt
-
-    sToken = XML_Parse(sMessage, "getPanTilt");
-    if(sToken != sNoData) {
-        if(pPanelServerSocket->isValid()) {
+ScorePanel::onMessageReceived(ProtocolMessage message) {
+    if(message.rejectedTags() != 0) {
+        logMessage(logFile,
+                   Q_FUNC_INFO,
+                   QString("Illegal values received: %1").arg(message.message()));
+    }
+    pendingMessages.append(message);
+    if(!bFlushScheduled) {
+        bFlushScheduled = true;
+        QMetaObject::invokeMethod(this, "onFlushMessages", Qt::QueuedConnection);
+    }
+}
+
+
+/*!
+ * \brief ScorePanel::onFlushMessages Dispatch the messages of the last burst
+ *
+ * Consecutive score messages are merged, the newest first: the parser
+ * keeps the first occurrence of a tag, i.e. its latest value. Commands
+ * (timeouts, spots, ...) are executed in the order they were sent.
+ */
+void
+ScorePanel::onFlushMessages() {
+    WATCHDOG_PHASE("ScorePanel::onFlushMessages");
+    bFlushScheduled = false;
+    QVector<ProtocolMessage> messages;
+    messages.swap(pendingMessages);
+    int iFirstMerged = -1;
+    for(int i=0; i<=messages.count(); i++) {
+        bool bMergeable = (i < messages.count()) && messages.at(i).isMergeable();
+        if(bMergeable) {
+            if(iFirstMerged < 0)
+                iFirstMerged = i;
+            continue;
         }
-    }// getPanTilt
-
-    sToken = XML_Parse(sMessage, "getOrientation");
-    if(sToken != sNoData) {
-        if(pPanelServerSocket->isValid()) {
-            QString sMessage;
-            if(isMirrored)
-                sMessage = QString("<orientation>%1</orientation>").arg(static_cast<int>(PanelOrientation::Reflected));
-            else
-                sMessage = QString("<orientation>%1</orientation>").arg(static_cast<int>(PanelOrientation::Normal));
-            qint64 bytesSent = pPanelServerSocket->sendTextMessage(sMessage);
-            if(bytesSent != sMessage.length()) {
-                logMessage(logFile,
-                           Q_FUNC_INFO,
-                           QString("Unable to send orientation value."));
+        if(iFirstMerged >= 0) {
+            int nMerged = i-iFirstMerged;
+            if(nMerged == 1) {
+                dispatchMessage(messages.at(iFirstMerged), 1);
             }
+            else {
+                QString sMerged;
+                for(int j=i-1; j>=iFirstMerged; j--)
+                    sMerged.append(messages.at(j).message());
+                ProtocolMessage merged;
+                merged.parse(sMerged);
+                dispatchMessage(merged, nMerged);
+            }
+            iFirstMerged = -1;
         }
-    }// getOrientation
-
-    sToken = XML_Parse(sMessage, "setOrientation");
-    if(sToken != sNoData) {
-        bool ok;
-        int iVal = sToken.toInt(&ok);
-        if(!ok) {
-            logMessage(logFile,
-                       Q_FUNC_INFO,
-                       QString("Illegal orientation value received: %1")
-                               .arg(sToken));
-            return;
-        }
-        try {
-            PanelOrientation newOrientation = static_cast<PanelOrientation>(iVal);
-            if(newOrientation == PanelOrientation::Reflected)
-                isMirrored = true;
-            else
-                isMirrored = false;
-        } catch(...) {
-            logMessage(logFile,
-                       Q_FUNC_INFO,
-                       QString("Illegal orientation value received: %1")
-                               .arg(sToken));
+        if(i == messages.count())
+            break;
+        dispatchMessage(messages.at(i), 1);
+        if(bClosing) // The Panel has been closed
             return;
-        }
-        pSettings->setValue("panel/orientation", isMirrored);
+    }
+}
+
+
+void
+ScorePanel::dispatchMessage(const ProtocolMessage& message, int nMessages) {
+    QElapsedTimer dispatchTimer;
+    dispatchTimer.start();
+    applyMessage(message);
+    Metrics::dispatches.add();
+    if(nMessages > 1) {
+        Metrics::coalescedMessages.add(quint64(nMessages-1));
+        // Every merged message would have cost about a whole dispatch
+        Metrics::coalescingSavedTime.add(quint64((nMessages-1)*(dispatchTimer.nsecsElapsed()/1000)));
+    }
+}
+
+
+/*!
+ * \brief ScorePanel::onBinaryMessageReceived The binary channel carries the uploads
+ * \param baMessage
+ *
+ * The message is only handed over (without copies) to the upload thread.
+ */
+void
+ScorePanel::onBinaryMessageReceived(QByteArray baMessage) {
+    QMetaObject::invokeMethod(uploadReceiver(),
+                              "onBinaryMessage",
+                              Qt::QueuedConnection,
+                              Q_ARG(QByteArray, baMessage));
+}
+
+
+/*!
+ * \brief ScorePanel::uploadReceiver
+ * \return The UploadReceiver, created (in its own thread) on first use
+ */
+UploadReceiver*
+ScorePanel::uploadReceiver() {
+    if(!pUploadReceiver) {
+        pUploadThread = new QThread();
+        pUploadThread->setObjectName(QString("Upload"));
+        pUploadReceiver = new UploadReceiver();
+        pUploadReceiver->setSlideDir(sSlideDir);
+        pUploadReceiver->setSpotDir(sSpotDir);
+        pUploadReceiver->moveToThread(pUploadThread);
+        // The replies go straight to the network thread
+        connect(pUploadReceiver, SIGNAL(replyReady(QString)),
+                pNetworkWorker, SLOT(sendTextMessage(QString)));
+        connect(pUploadReceiver, SIGNAL(uploadCompleted(QString,QString)),
+                this, SLOT(onUploadCompleted(QString,QString)));
+        pUploadThread->start(QThread::LowestPriority);
+    }
+    return pUploadReceiver;
+}
+
+
+/*!
+ * \brief ScorePanel::onUploadCompleted A new file is in place
+ * \param sTarget "slide" or "logo"
+ * \param sPath The new file
+ *
+ * New slides are picked up by the slide show at its next refresh,
+ * new logos require to rebuild the Panel.
+ */
+void
+ScorePanel::onUploadCompleted(QString sTarget, QString sPath) {
+#ifdef LOG_VERBOSE
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               QString("Received %1").arg(sPath));
+#else
+    Q_UNUSED(sPath)
+#endif
+    if(sTarget == QString("logo"))
         buildLayout();
-    }// setOrientation
-
-    sToken = XML_Parse(sMessage, "getScoreOnly");
-    if(sToken != sNoData) {
-        getPanelScoreOnly();
-    }// getScoreOnly
-
-    sToken = XML_Parse(sMessage, "setScoreOnly");
-    if(sToken != sNoData) {
-        bool ok;
-        int iVal = sToken.toInt(&ok);
-        if(!ok) {
-            logMessage(logFile,
-                       Q_FUNC_INFO,
-                       QString("Illegal value fo ScoreOnly received: %1")
-                               .arg(sToken));
-            return;
-        }
-        if(iVal==0) {
-            setScoreOnly(false);
-        }
-        else {
-            setScoreOnly(true);
-        }
-        pSettings->setValue("panel/scoreOnly", isScoreOnly);
-    }// setScoreOnly
+}
 
-    sToken = XML_Parse(sMessage, "language");
-    if(sToken != sNoData) {
-        VolleyApplication* application = static_cast<VolleyApplication *>(QApplication::instance());
 
-        QCoreApplication::removeTranslator(&application->Translator);
-        if(sToken == QString("English")) {
-            if(application->Translator.load(":/panelChooser_en"))
-                QCoreApplication::installTranslator(&application->Translator);
-        }
-        else {
-            sToken = QString("Italiano");
-        }
-        pSettings->setValue("language/current", sToken);
+/*!
+ * \brief ScorePanel::applyMessage Executes the Panel commands of a message
+ * \param message Already parsed and validated
+ *
+ * The commands are executed in the order they appear in the message.
+ */
+void
+ScorePanel::applyMessage(const ProtocolMessage& message) {
+    GUI_PHASE("ScorePanel::applyMessage");
+    // The derived panel has already updated the score
+    if(pScoreOverlay)
+        pScoreOverlay->setState(scoreState);
+    if(scoreState != savedState) {
+        snapshot.save(scoreState);
+        savedState = scoreState;
+    }
+
+    for(int i=0; i<message.count(); i++) {
+        const Protocol::Tag tag = message.tag(i);
+        switch(tag) {
+        case Protocol::Tag::Kill:
+            if(message.number(tag) == 1) {
+                stopNetwork();
+                #ifdef Q_PROCESSOR_ARM
+                system("sudo halt");
+                #endif
+                close();// emit the QCloseEvent that is responsible
+                        // to clean up all pending processes
+                return;
+            }
+            break;
+
+        case Protocol::Tag::SpotDir:
+            sSpotDir = message.text(tag);
+            if(pUploadReceiver)
+                QMetaObject::invokeMethod(pUploadReceiver,
+                                          "setSpotDir",
+                                          Qt::QueuedConnection,
+                                          Q_ARG(QString, sSpotDir));
+            break;
+
+        case Protocol::Tag::SpotLoop:
+            if(!isScoreOnly)
+                startSpotLoop();
+            break;
+
+        case Protocol::Tag::EndSpotLoop:
+            stopSpotLoop();
+            break;
+
+        case Protocol::Tag::SlideDir:
+            sSlideDir = message.text(tag);
+            if(pUploadReceiver)
+                QMetaObject::invokeMethod(pUploadReceiver,
+                                          "setSlideDir",
+                                          Qt::QueuedConnection,
+                                          Q_ARG(QString, sSlideDir));
+            break;
+
+        case Protocol::Tag::SlideShow:
+            if(!isScoreOnly)
+                startSlideShow();
+            break;
+
+        case Protocol::Tag::EndSlideShow:
+            stopSlideShow();
+            break;
+
+        case Protocol::Tag::Live:
+            if(!isScoreOnly)
+                startLiveCamera();
+            break;
+
+        case Protocol::Tag::EndLive:
+            stopLiveCamera();
+            break;
+
+        case Protocol::Tag::Pan:
+        case Protocol::Tag::Tilt:
+        case Protocol::Tag::GetPanTilt:
+            break;
+
+        case Protocol::Tag::GetOrientation:
+            if(bConnected) {
+                PanelOrientation orientation = isMirrored ? PanelOrientation::Reflected
+                                                          : PanelOrientation::Normal;
+                sendMessage(Protocol::serialize<Protocol::Tag::Orientation>(static_cast<int>(orientation)).toString());
+            }
+            break;
+
+        case Protocol::Tag::SetOrientation:
+            isMirrored = (static_cast<PanelOrientation>(message.number(tag)) == PanelOrientation::Reflected);
+            pSettings->setValue("panel/orientation", isMirrored);
+            buildLayout();
+            break;
+
+        case Protocol::Tag::GetScoreOnly:
+            getPanelScoreOnly();
+            break;
+
+        case Protocol::Tag::SetScoreOnly:
+            setScoreOnly(message.number(tag) != 0);
+            pSettings->setValue("panel/scoreOnly", isScoreOnly);
+            break;
+
+        case Protocol::Tag::Trace:
+            if(message.number(tag) == 1) {
+                Trace::setEnabled(true);
+            }
+            else if(Trace::isEnabled()) {
+                // Stop and write the events collected so far
+                Trace::setEnabled(false);
+                QString sTraceFile = QDir::homePath() + QString("/volley_panel_trace.json");
+                if(!Trace::flush(sTraceFile)) {
+                    logMessage(logFile,
+                               Q_FUNC_INFO,
+                               QString("Unable to write %1").arg(sTraceFile));
+                }
+                else if(bConnected) {
+                    sendMessage(QString("<traceFile>%1</traceFile>")
+                                .arg(sTraceFile));
+                }
+            }
+            break;
+
+        case Protocol::Tag::GetMetrics:
+            if(bConnected) {
+                sendMessage(QString("<metrics>%1</metrics>")
+                            .arg(QString::fromLatin1(Metrics::exposition())));
+            }
+            break;
+
+        case Protocol::Tag::Overlay:
+            bOverlay = (message.number(tag) != 0);
+            pSettings->setValue("panel/overlay", bOverlay);
+            if(videoPlayer && bOverlay)
+                showOverlay();
+            else if(!bOverlay)
+                hideOverlay();
+            if(pLiveWindow)
+                pLiveWindow->setOverlay(bOverlay ? scoreOverlay() : Q_NULLPTR);
+            break;
+
+        case Protocol::Tag::Language: {
+            QString sLanguage = message.text(tag);
+            VolleyApplication* application = static_cast<VolleyApplication *>(QApplication::instance());
+            QCoreApplication::removeTranslator(&application->Translator);
+            if(sLanguage == QString("English")) {
+                if(application->Translator.load(QString("VolleyPanel_en_US"), QString(":/i18n")))
+                    QCoreApplication::installTranslator(&application->Translator);
+            }
+            else {
+                sLanguage = QString("Italiano");
+            }
+            pSettings->setValue("language/current", sLanguage);
 #ifdef LOG_VERBOSE
             logMessage(logFile,
                        Q_FUNC_INFO,
                        QString("New language: %1")
-                       .arg(sToken));
+                       .arg(sLanguage));
 #endif
-    }// language
+            break;
+        }
+
+        default: // Score tags are handled by the derived panel
+            break;
+        }
+    }
 }
 
 
+/*!
+ * \brief ScorePanel::initCamera Read the live camera configuration
+ *
+ * Nothing is created here: the ingest thread and the live window are
+ * created the first time the live view is requested.
+ */
 void
 ScorePanel::initCamera() {
+    sCameraSource   = pSettings->value("camera/source", QString("v4l2")).toString();
+    sCameraDevice   = pSettings->value("camera/device", QString("/dev/video0")).toString();
+    cameraFrameSize = QSize(pSettings->value("camera/width",  1280).toInt(),
+                            pSettings->value("camera/height", 720).toInt());
 }
 
 
+/*!
+ * \brief ScorePanel::startLiveCamera Show the live camera on the Panel
+ *
+ * The source is selected by the "camera/source" setting:
+ * "v4l2" (the default) for a capture device, "pipe" to loop a video file
+ * through ffmpeg and "test" for a test pattern.
+ */
 void
 ScorePanel::startLiveCamera() {
-    startSpotLoop();
+    GUI_PHASE("ScorePanel::startLiveCamera");
+    if(pCameraIngest)
+        return;
+    if(!pIngestThread) {
+        pIngestThread = new QThread();
+        pIngestThread->setObjectName(QString("CameraIngest"));
+        pIngestThread->start(QThread::HighPriority);
+    }
+    if(!pLiveWindow)
+        pLiveWindow = new LiveWindow(logFile);
+
+    CameraIngest::sourceType source = CameraIngest::source_V4L2;
+    if(sCameraSource == QString("pipe"))
+        source = CameraIngest::source_Pipe;
+    else if(sCameraSource == QString("test"))
+        source = CameraIngest::source_TestPattern;
+    pCameraIngest = new CameraIngest();
+    pCameraIngest->setSource(source, sCameraDevice, cameraFrameSize);
+    pCameraIngest->moveToThread(pIngestThread);
+    connect(pCameraIngest, SIGNAL(ingestError(QString)),
+            this, SLOT(onCameraError(QString)));
+    pLiveWindow->setIngest(pCameraIngest);
+    // Drawn over the frames: no extra window on top of the live view
+    pLiveWindow->setOverlay(bOverlay ? scoreOverlay() : Q_NULLPTR);
+    QMetaObject::invokeMethod(pCameraIngest, "start", Qt::QueuedConnection);
+
+    pLiveWindow->showFullScreen();
+    hide(); // Hide the Score Panel
+#ifdef LOG_VERBOSE
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               QString("Live camera started from %1").arg(sCameraDevice));
+#endif
 }
 
 
+/*!
+ * \brief ScorePanel::closeLiveCamera Stop the ingest and hide the live window
+ */
 void
-ScorePanel::stopLiveCamera() {
-    if(cameraPlayer) {
-        cameraPlayer->disconnect();
-        connect(cameraPlayer, SIGNAL(finished(int,QProcess::ExitStatus)),
-                this, SLOT(onLiveClosed(int,QProcess::ExitStatus)));
-        cameraPlayer->terminate();
-#ifdef LOG_VERBOSE
+ScorePanel::closeLiveCamera() {
+    GUI_PHASE("ScorePanel::closeLiveCamera");
+    if(pLiveWindow) {
+        pLiveWindow->setIngest(nullptr); // Releases the shown frame
+        pLiveWindow->hide();
+    }
+    if(pCameraIngest) {
+        pCameraIngest->disconnect();
+        QMetaObject::invokeMethod(pCameraIngest, "stop", Qt::BlockingQueuedConnection);
+        pCameraIngest->deleteLater();
+        pCameraIngest = Q_NULLPTR;
+    }
+}
+
+
+/*!
+ * \brief ScorePanel::scoreOverlay
+ * \return The score overlay, created on first use
+ */
+ScoreOverlay*
+ScorePanel::scoreOverlay() {
+    if(!pScoreOverlay) {
+        pScoreOverlay = new ScoreOverlay();
+        pScoreOverlay->setState(scoreState);
+    }
+    return pScoreOverlay;
+}
+
+
+/*!
+ * \brief ScorePanel::showOverlay Float the score over the spot player
+ *
+ * The overlay is raised again when the player window should be open.
+ */
+void
+ScorePanel::showOverlay() {
+    if(!bOverlay)
+        return;
+    scoreOverlay()->showOnTop();
+    QTimer::singleShot(OVERLAY_RAISE_DELAY, this, [this]() {
+        if(videoPlayer && bOverlay)
+            pScoreOverlay->showOnTop();
+    });
+}
+
+
+void
+ScorePanel::hideOverlay() {
+    if(pScoreOverlay)
+        pScoreOverlay->hide();
+}
+
+
+/*!
+ * \brief ScorePanel::initFrameExport Publish the frames for the local consumers
+ *
+ * With export/mode "panel" the whole Panel is rendered after each
+ * repaint, with "overlay" only the score bug (with its alpha channel)
+ * when the score changes. Nothing is rendered while no reader is attached.
+ */
+void
+ScorePanel::initFrameExport() {
+    QString sMode = pSettings->value("export/mode", QString()).toString();
+    if(sMode != QString("panel") && sMode != QString("overlay"))
+        return;
+    bExportOverlay = (sMode == QString("overlay"));
+    QSize frameSize = QApplication::screens().at(1)->geometry().size();
+    if(bExportOverlay)
+        frameSize = scoreOverlay()->pixmap().size();
+    QString sName = pSettings->value("export/name", QString(FRAME_EXPORT_NAME)).toString();
+    pFrameExport = new FrameExport(this);
+    if(!pFrameExport->open(sName, frameSize)) {
         logMessage(logFile,
                    Q_FUNC_INFO,
-                   QString("Live Show has been closed."));
-#endif
-    }
-    else {
-        QString sMessage = "<closed_live>1</closed_live>";
-        qint64 bytesSent = pPanelServerSocket->sendTextMessage(sMessage);
-        if(bytesSent != sMessage.length()) {
-            logMessage(logFile,
-                       Q_FUNC_INFO,
-                       QString("Unable to send %1")
-                       .arg(sMessage));
-        }
-#ifdef LOG_VERBOSE
-        else {
-            logMessage(logFile,
-                       Q_FUNC_INFO,
-                       QString("Sent %1")
-                       .arg(sMessage));
-        }
-#endif
-        stopSpotLoop();
+                   QString("Unable to create the shared memory %1").arg(sName));
+        delete pFrameExport;
+        pFrameExport = nullptr;
+        return;
     }
+    connect(pFrameExport, SIGNAL(readerAttached()),
+            this, SLOT(onExportFrame()));
+    if(bExportOverlay)
+        connect(pScoreOverlay, SIGNAL(changed()),
+                this, SLOT(onExportFrame()));
+}
+
+
+void
+ScorePanel::onExportFrame() {
+    if(!pFrameExport->isReaderAttached())
+        return;
+    if(bExportOverlay)
+        pFrameExport->publish(pScoreOverlay->pixmap().toImage());
+    else
+        pFrameExport->publish(this);
+}
+
+
+/*!
+ * \brief ScorePanel::initStream The optional MJPEG stream (stream/port)
+ *
+ * The encoding and the clients are handled in the "Stream" thread.
+ */
+void
+ScorePanel::initStream() {
+    int iStreamPort = pSettings->value("stream/port", 0).toInt();
+    if(iStreamPort <= 0)
+        return;
+    QHostAddress streamAddress(pSettings->value("stream/address",
+                                                QString("127.0.0.1")).toString());
+    int iFps = qBound(1, pSettings->value("stream/fps", STREAM_FPS).toInt(), 30);
+
+    pStreamTimer = new QTimer(this);
+    pStreamTimer->setSingleShot(true);
+    pStreamTimer->setInterval(1000/iFps);
+    connect(pStreamTimer, SIGNAL(timeout()),
+            this, SLOT(onStreamTimer()));
+
+    pStreamThread = new QThread();
+    pStreamThread->setObjectName(QString("Stream"));
+    pMjpegServer = new MjpegServer();
+    pMjpegServer->setAddress(streamAddress, quint16(iStreamPort));
+    pMjpegServer->setQuality(pSettings->value("stream/quality", STREAM_QUALITY).toInt());
+    pMjpegServer->moveToThread(pStreamThread);
+    connect(pStreamThread, SIGNAL(finished()),
+            pMjpegServer, SLOT(deleteLater()));
+    connect(pMjpegServer, SIGNAL(clientConnected()),
+            this, SLOT(onStreamClientConnected()));
+    connect(pMjpegServer, SIGNAL(statusMessage(QString)),
+            this, SLOT(onNetworkStatus(QString)));
+    pStreamThread->start(QThread::LowPriority);
+    QMetaObject::invokeMethod(pMjpegServer, "start", Qt::QueuedConnection);
+}
+
+
+/*!
+ * \brief ScorePanel::streamFrame The Panel has been repainted
+ *
+ * The frames are rate limited: a change arriving too early is sent
+ * when the interval expires.
+ */
+void
+ScorePanel::streamFrame() {
+    bStreamDirty = true;
+    if(pStreamTimer->isActive())
+        return;
+    sendStreamFrame();
+}
+
+
+void
+ScorePanel::onStreamTimer() {
+    if(bStreamDirty)
+        sendStreamFrame();
+}
+
+
+void
+ScorePanel::onStreamClientConnected() {
+    streamFrame();
+}
+
+
+void
+ScorePanel::sendStreamFrame() {
+    bStreamDirty = false;
+    if(!pMjpegServer->hasClients())
+        return;
+    // A new buffer only if the Stream thread is still encoding the last one
+    if(streamBuffer.size() != size() || !streamBuffer.isDetached())
+        streamBuffer = QImage(size(), QImage::Format_RGB32);
+    // The exported frame, with its window background, is the same picture:
+    // copying it is cheaper
+    if(!bFrameExported || !pFrameExport->copyLatest(streamBuffer))
+        render(&streamBuffer);
+    // Implicitly shared: the Stream thread encodes it
+    pMjpegServer->submitFrame(streamBuffer);
+    pStreamTimer->start();
+}
+
+
+/*!
+ * \brief ScorePanel::onStallDetected The event loop has been blocked
+ * \param sPhase The work that was running
+ * \param msec How long
+ */
+void
+ScorePanel::onStallDetected(QString sPhase, qint64 msec) {
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               QString("Event loop blocked for %1 ms in %2")
+               .arg(msec)
+               .arg(sPhase));
+}
+
+
+void
+ScorePanel::onCameraError(QString sError) {
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               sError);
+    stopLiveCamera();
+}
+
+
+void
+ScorePanel::stopLiveCamera() {
+    bool bWasLive = (pCameraIngest != Q_NULLPTR);
+    closeLiveCamera();
+    sendMessage(Protocol::serialize<Protocol::Tag::ClosedLive>(1).toString());
+    if(bWasLive)
+        showFullScreen(); // Restore the Score Panel
 }
 
 
 void
 ScorePanel::getPanelScoreOnly() {
-    if(pPanelServerSocket->isValid()) {
-        QString sMessage;
-        sMessage = QString("<isScoreOnly>%1</isScoreOnly>").arg(static_cast<int>(getScoreOnly()));
-        qint64 bytesSent = pPanelServerSocket->sendTextMessage(sMessage);
-        if(bytesSent != sMessage.length()) {
-            logMessage(logFile,
-                       Q_FUNC_INFO,
-                       QString("Unable to send scoreOnly configuration"));
-        }
-    }
+    if(bConnected)
+        sendMessage(Protocol::serialize<Protocol::Tag::IsScoreOnly>(getScoreOnly()).toString());
 }
 
 
 void
 ScorePanel::startSpotLoop() {
+    GUI_PHASE("ScorePanel::startSpotLoop");
     QDir spotDir(sSpotDir);
     spotList = QFileInfoList();
     if(spotDir.exists()) {
@@ -758,7 +1217,9 @@ ScorePanel::startSpotLoop() {
                 videoPlayer = Q_NULLPTR;
                 return;
             }
-            hide(); // Hide the Score Panel
+            Metrics::processStarts.add();
+            hide(); // Hide the Score Panel...
+            showOverlay(); // ...but not the score, if so configured
         } // if(!videoPlayer)
     }
 }
@@ -766,6 +1227,7 @@ ScorePanel::startSpotLoop() {
 
 void
 ScorePanel::stopSpotLoop() {
+    GUI_PHASE("ScorePanel::stopSpotLoop");
     if(videoPlayer) {
         videoPlayer->disconnect();
         connect(videoPlayer, SIGNAL(finished(int,QProcess::ExitStatus)),
@@ -777,8 +1239,11 @@ ScorePanel::stopSpotLoop() {
 
 void
 ScorePanel::startSlideShow() {
-    if(videoPlayer || cameraPlayer)
+    GUI_PHASE("ScorePanel::startSlideShow");
+    if(videoPlayer || pCameraIngest)
         return;// No Slide Show if movies are playing or camera is active
+    if(!pMySlideWindow)
+        pMySlideWindow = new SlideWindow();
     if(pMySlideWindow) {
         pMySlideWindow->setSlideDir(sSlideDir);
         pMySlideWindow->showFullScreen();
@@ -795,6 +1260,7 @@ ScorePanel::startSlideShow() {
 
 void
 ScorePanel::stopSlideShow() {
+    GUI_PHASE("ScorePanel::stopSlideShow");
     if(pMySlideWindow) {
         pMySlideWindow->stopSlideShow();
         showFullScreen(); // Show the Score Panel
@@ -22,6 +22,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QMainWindow>
 #include <QProcess>
 #include <QFileInfoList>
+#include <QImage>
 #include <QUrl>
 #include <QtGlobal>
 #include <QTranslator>
@@ -29,6 +30,10 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QAbstractSocket>
 
 #include "slidewindow.h"
+#include "clocksync.h"
+#include "scorestate.h"
+#include "scoresnapshot.h"
+#include "protocol.h"
 
 #if (QT_VERSION < QT_VERSION_CHECK(5, 11, 0))
     #define horizontalAdvance width
@@ -36,14 +41,22 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 
 QT_BEGIN_NAMESPACE
-QT_FORWARD_DECLARE_CLASS(QSettings)
+QT_FORWARD_DECLARE_CLASS(PanelConfig)
 QT_FORWARD_DECLARE_CLASS(QFile)
-QT_FORWARD_DECLARE_CLASS(QUdpSocket)
-QT_FORWARD_DECLARE_CLASS(QWebSocket)
+QT_FORWARD_DECLARE_CLASS(NetworkWorker)
 QT_FORWARD_DECLARE_CLASS(SlideWindow)
 QT_FORWARD_DECLARE_CLASS(QGridLayout)
 QT_FORWARD_DECLARE_CLASS(UpdaterThread)
 QT_FORWARD_DECLARE_CLASS(FileUpdater)
+QT_FORWARD_DECLARE_CLASS(QThread)
+QT_FORWARD_DECLARE_CLASS(CameraIngest)
+QT_FORWARD_DECLARE_CLASS(LiveWindow)
+QT_FORWARD_DECLARE_CLASS(ScoreOverlay)
+QT_FORWARD_DECLARE_CLASS(UploadReceiver)
+QT_FORWARD_DECLARE_CLASS(MetricsServer)
+QT_FORWARD_DECLARE_CLASS(StallWatchdog)
+QT_FORWARD_DECLARE_CLASS(FrameExport)
+QT_FORWARD_DECLARE_CLASS(MjpegServer)
 QT_END_NAMESPACE
 
 
@@ -59,43 +72,60 @@ public:
     void setScoreOnly(bool bScoreOnly);
     bool getScoreOnly();
 
+protected:
+    bool event(QEvent *event);
+    void paintEvent(QPaintEvent *event);
+
 signals:
     void panelClosed(); /*!< \brief emitted to signal that the Panel has been closed */
 
 protected slots:
-    void onTextMessageReceived(QString sMessage);
     void onBinaryMessageReceived(QByteArray baMessage);
 
 
 private slots:
-    void onConnectionTimeExipred();
+    void onMessageReceived(ProtocolMessage message);
+    void onFlushMessages();
     void onPanelServerConnected();
     void onPanelServerDisconnected();
-    void onPanelServerSocketError(QAbstractSocket::SocketError error);
-    void onTimeToRefreshStatus();
+    void onPanelServerLost();
+    void onClockSyncChanged(ClockSync newClockSync);
+    void onSendFailed(QString sMessage);
+    void onNetworkStatus(QString sMessage);
     void onSpotClosed(int exitCode, QProcess::ExitStatus exitStatus);
-    void onLiveClosed(int exitCode, QProcess::ExitStatus exitStatus);
+    void onCameraError(QString sError);
+    void onStallDetected(QString sPhase, qint64 msec);
+    void onExportFrame();
+    void onStreamTimer();
+    void onStreamClientConnected();
+    void onUploadCompleted(QString sTarget, QString sPath);
     void onStartNextSpot(int exitCode, QProcess::ExitStatus exitStatus);
 
 protected:
     virtual QGridLayout* createPanel();
+    virtual void applyMessage(const ProtocolMessage& message);
     void buildLayout();
     void doProcessCleanup();
+    void sendMessage(QString sMessage);
+    void stopNetwork();
 
 protected:
     QString            serverUrl;
     bool               isMirrored;
     bool               isScoreOnly;
-    QWebSocket        *pPanelServerSocket;
+    QThread           *pNetworkThread;
+    NetworkWorker     *pNetworkWorker;
+    bool               bConnected;
     QFile             *logFile;
     QTranslator        Translator;
-    QTimer             connectionTimer;
+    ClockSync          clockSync;
+    ScoreState         scoreState;
+    ScoreSnapshot      snapshot;   // The last score shown, survives a restart
+    ScoreState         savedState; // What the snapshot holds
 
 private:
-    bool               bStillConnected;
-    QTimer             refreshTimer;
+    bool               bClosing;
     QProcess          *videoPlayer;
-    QProcess          *cameraPlayer;
     QString            sProcess;
     QString            sProcessArguments;
 
@@ -123,10 +153,55 @@ private:
 
     SlideWindow       *pMySlideWindow;
 
+    // Live camera management
+    QString            sCameraSource;
+    QString            sCameraDevice;
+    QSize              cameraFrameSize;
+    QThread           *pIngestThread;
+    CameraIngest      *pCameraIngest;
+    LiveWindow        *pLiveWindow;
+
+    // Score overlay on spots and live video
+    bool               bOverlay;
+    ScoreOverlay      *pScoreOverlay;
+
+    // Slides and logos upload
+    QThread           *pUploadThread;
+    UploadReceiver    *pUploadReceiver;
+
+    MetricsServer     *pMetricsServer;
+    StallWatchdog     *pWatchdog;
+
+    // The rendered Panel (or the overlay only) in shared memory
+    FrameExport       *pFrameExport;
+    bool               bExportOverlay;
+    bool               bFrameExported; // The last repaint is in the export ring
+
+    // MJPEG stream of the Panel for the remote monitors
+    QThread           *pStreamThread;
+    MjpegServer       *pMjpegServer;
+    QTimer            *pStreamTimer;
+    bool               bStreamDirty;
+    QImage             streamBuffer;   // Reused while the Stream thread does not hold it
+
+    // Messages received in the same event loop turn
+    QVector<ProtocolMessage> pendingMessages;
+    bool               bFlushScheduled;
+
 private:
     void               initCamera();
+    void               initFrameExport();
+    void               initStream();
+    void               streamFrame();
+    void               sendStreamFrame();
     void               startLiveCamera();
     void               stopLiveCamera();
+    void               closeLiveCamera();
+    ScoreOverlay*      scoreOverlay();
+    void               showOverlay();
+    void               hideOverlay();
+    UploadReceiver*    uploadReceiver();
+    void               dispatchMessage(const ProtocolMessage& message, int nMessages);
     void               startSpotLoop();
     void               stopSpotLoop();
     void               startSlideShow();
@@ -134,7 +209,7 @@ private:
     void               getPanelScoreOnly();
 
 private:
-    QSettings         *pSettings;
+    PanelConfig       *pSettings;
     QWidget           *pPanel;
     QString            sPlayer;
 };
@@ -0,0 +1,185 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QDataStream>
+#include <QDir>
+#include <QFileInfo>
+#include <cstddef>
+#include <cstring>
+
+#ifdef Q_OS_UNIX
+    #include <sys/mman.h>
+#endif
+
+#include "scoresnapshot.h"
+
+
+#define SNAPSHOT_MAGIC 0x56505353 // "VPSS"
+#define SLOT_DATA      480        // Bytes for a serialized ScoreState
+
+
+namespace {
+
+struct SnapshotSlot {
+    quint32 magic;
+    quint32 crc;        // Of generation, length and data
+    quint32 generation;
+    quint32 length;
+    uchar   data[SLOT_DATA];
+};
+
+const qint64 mapSize = 2*qint64(sizeof(SnapshotSlot));
+
+
+/*!
+ * \brief crc32 The IEEE 802.3 CRC
+ */
+quint32
+crc32(const uchar* data, int length) {
+    static const struct Table {
+        quint32 entry[256];
+        Table() {
+            for(quint32 i=0; i<256; i++) {
+                quint32 c = i;
+                for(int k=0; k<8; k++)
+                    c = (c & 1) ? (0xEDB88320u ^ (c >> 1)) : (c >> 1);
+                entry[i] = c;
+            }
+        }
+    } table;
+    quint32 crc = 0xFFFFFFFFu;
+    for(int i=0; i<length; i++)
+        crc = table.entry[(crc ^ data[i]) & 0xFF] ^ (crc >> 8);
+    return crc ^ 0xFFFFFFFFu;
+}
+
+
+quint32
+slotCrc(const SnapshotSlot& slot) {
+    // generation, length and data are contiguous
+    int length = int(offsetof(SnapshotSlot, data) - offsetof(SnapshotSlot, generation)) +
+                 int(slot.length);
+    return crc32(reinterpret_cast<const uchar*>(&slot.generation), length);
+}
+
+} // namespace
+
+
+/*!
+ * \brief ScoreSnapshot::ScoreSnapshot The last score shown, kept on disk
+ *
+ * The file is mapped in memory and holds two slots: every save goes in
+ * the older one, so that a crash (or a power loss) while writing can
+ * only spoil that slot. The newest slot with a valid CRC is loaded.
+ */
+ScoreSnapshot::ScoreSnapshot()
+    : pMap(nullptr)
+    , generation(0)
+{
+}
+
+
+ScoreSnapshot::~ScoreSnapshot() {
+    if(pMap)
+        file.unmap(pMap);
+}
+
+
+bool
+ScoreSnapshot::open(QString sFileName) {
+    QDir().mkpath(QFileInfo(sFileName).absolutePath());
+    file.setFileName(sFileName);
+    if(!file.open(QIODevice::ReadWrite))
+        return false;
+    if(file.size() != mapSize && !file.resize(mapSize))
+        return false;
+    pMap = file.map(0, mapSize);
+    return pMap != nullptr;
+}
+
+
+/*!
+ * \brief ScoreSnapshot::load
+ * \param pState The last saved score
+ * \return false if there is no valid snapshot
+ */
+bool
+ScoreSnapshot::load(ScoreState* pState) {
+    if(!pMap)
+        return false;
+    SnapshotSlot slots[2];
+    int iBest = -1;
+    for(int i=0; i<2; i++) {
+        std::memcpy(&slots[i], pMap + i*sizeof(SnapshotSlot), sizeof(SnapshotSlot));
+        if(slots[i].magic != SNAPSHOT_MAGIC ||
+           slots[i].length > SLOT_DATA ||
+           slots[i].crc != slotCrc(slots[i]))
+            continue;
+        if(iBest < 0 || slots[i].generation > slots[iBest].generation)
+            iBest = i;
+    }
+    if(iBest < 0)
+        return false;
+    generation = slots[iBest].generation;
+    QByteArray baState(reinterpret_cast<const char*>(slots[iBest].data), int(slots[iBest].length));
+    QDataStream stream(baState);
+    stream.setVersion(QDataStream::Qt_5_0); // Same encoding of these types up to Qt 6
+    ScoreState state;
+    stream >> state.team[0] >> state.team[1]
+           >> state.score[0] >> state.score[1]
+           >> state.set[0] >> state.set[1]
+           >> state.timeout[0] >> state.timeout[1]
+           >> state.servizio;
+    if(stream.status() != QDataStream::Ok)
+        return false;
+    *pState = state;
+    return true;
+}
+
+
+/*!
+ * \brief ScoreSnapshot::save Writes the score in the older slot
+ *
+ * It costs a copy in the page cache; the write back is started at once.
+ */
+void
+ScoreSnapshot::save(const ScoreState& state) {
+    if(!pMap)
+        return;
+    QByteArray baState;
+    QDataStream stream(&baState, QIODevice::WriteOnly);
+    stream.setVersion(QDataStream::Qt_5_0); // Same encoding of these types up to Qt 6
+    stream << state.team[0] << state.team[1]
+           << state.score[0] << state.score[1]
+           << state.set[0] << state.set[1]
+           << state.timeout[0] << state.timeout[1]
+           << state.servizio;
+    if(baState.size() > SLOT_DATA)
+        return;
+    SnapshotSlot slot;
+    std::memset(&slot, 0, sizeof(slot));
+    slot.magic      = SNAPSHOT_MAGIC;
+    slot.generation = ++generation;
+    slot.length     = quint32(baState.size());
+    std::memcpy(slot.data, baState.constData(), size_t(baState.size()));
+    slot.crc        = slotCrc(slot);
+    std::memcpy(pMap + (generation%2)*sizeof(SnapshotSlot), &slot, sizeof(slot));
+#ifdef Q_OS_UNIX
+    msync(pMap, size_t(mapSize), MS_ASYNC);
+#endif
+}
@@ -0,0 +1,48 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QString>
+
+
+/*!
+ * \brief The match data shown outside the Score Panel (e.g. on the overlay)
+ */
+struct ScoreState
+{
+    QString team[2];
+    int     score[2] = { 0, 0 };
+    int     set[2]   = { 0, 0 };
+    int     timeout[2] = { 0, 0 };
+    int     servizio = -1; /*!< Serving team (-1 = none) */
+
+    bool operator==(const ScoreState& other) const {
+        for(int i=0; i<2; i++) {
+            if(team[i]  != other.team[i]  ||
+               score[i] != other.score[i] ||
+               set[i]   != other.set[i]   ||
+               timeout[i] != other.timeout[i])
+                return false;
+        }
+        return servizio == other.servizio;
+    }
+    bool operator!=(const ScoreState& other) const {
+        return !(*this == other);
+    }
+};
@@ -0,0 +1,252 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QJsonDocument>
+#include <QJsonObject>
+#include <QJsonArray>
+
+#include "slideplaylist.h"
+#include "utility.h"
+
+
+#define PLAYLIST_FILE   "playlist.json" // The optional manifest in the slide directory
+#define MAX_WEIGHT      100
+#define MAX_SEQUENCE    1000
+
+
+/*!
+ * \brief SlidePlaylist::SlidePlaylist The ordered sequence of slides to show
+ *
+ * The sequence is taken from the optional PLAYLIST_FILE manifest:
+ *
+ * {
+ *   "defaultDuration": 5000,
+ *   "defaultTransition": "fade",
+ *   "slides": [
+ *     { "file": "sponsor.jpg", "duration": 8000, "transition": "kenburns", "weight": 2 },
+ *     { "file": "team.png" }
+ *   ]
+ * }
+ *
+ * or, when there is no valid manifest, from the images of the directory.
+ * The manifest is parsed only when it (or the directory) changes.
+ */
+SlidePlaylist::SlidePlaylist()
+    : bManifestExists(false)
+    , manifestSize(-1)
+    , bHasManifest(false)
+    , iDefaultDuration(-1)
+{
+}
+
+
+/*!
+ * \brief SlidePlaylist::setDirectory
+ * \param sNewDir The slide directory
+ */
+void
+SlidePlaylist::setDirectory(QString sNewDir) {
+    if(sNewDir == sDir)
+        return;
+    sDir = sNewDir;
+    bManifestExists = false;
+    manifestTime = QDateTime();
+    manifestSize = -1;
+    dirTime = QDateTime();
+    bHasManifest = false;
+    sequence.clear();
+}
+
+
+/*!
+ * \brief SlidePlaylist::refresh Reload the sequence if something changed on disk
+ * \return true if the sequence has been rebuilt
+ */
+bool
+SlidePlaylist::refresh() {
+    QDir slideDir(sDir);
+    QFileInfo manifestInfo(slideDir.filePath(PLAYLIST_FILE));
+    QFileInfo dirInfo(sDir);
+    bool bChanged = (manifestInfo.exists() != bManifestExists) ||
+                    (dirInfo.lastModified() != dirTime) ||
+                    !dirTime.isValid();
+    if(manifestInfo.exists()) {
+        bChanged |= (manifestInfo.lastModified() != manifestTime) ||
+                    (manifestInfo.size() != manifestSize);
+    }
+    if(!bChanged)
+        return false;
+
+    bManifestExists = manifestInfo.exists();
+    manifestTime    = manifestInfo.lastModified();
+    manifestSize    = manifestInfo.size();
+    dirTime         = dirInfo.lastModified();
+    bHasManifest    = bManifestExists && loadManifest(manifestInfo.absoluteFilePath());
+    if(!bHasManifest)
+        listDirectory();
+    return true;
+}
+
+
+int
+SlidePlaylist::count() const {
+    return sequence.count();
+}
+
+
+const SlidePlaylist::Entry&
+SlidePlaylist::at(int index) const {
+    return sequence.at(index);
+}
+
+
+int
+SlidePlaylist::defaultDuration() const {
+    return iDefaultDuration;
+}
+
+
+QString
+SlidePlaylist::defaultTransition() const {
+    return sDefaultTransition;
+}
+
+
+/*!
+ * \brief SlidePlaylist::loadManifest
+ * \param sManifest The manifest file
+ * \return false if the manifest is not valid or it lists no existing slide
+ *
+ * The entries that resolve outside the slide directory are skipped.
+ */
+bool
+SlidePlaylist::loadManifest(QString sManifest) {
+    QFile manifestFile(sManifest);
+    if(!manifestFile.open(QIODevice::ReadOnly)) {
+        logMessage(Q_NULLPTR,
+                   Q_FUNC_INFO,
+                   QString("Unable to open %1").arg(sManifest));
+        return false;
+    }
+    QJsonParseError parseError;
+    QJsonDocument document = QJsonDocument::fromJson(manifestFile.readAll(), &parseError);
+    manifestFile.close();
+    if(!document.isObject()) {
+        logMessage(Q_NULLPTR,
+                   Q_FUNC_INFO,
+                   QString("Invalid playlist %1: %2")
+                   .arg(sManifest, parseError.errorString()));
+        return false;
+    }
+    QJsonObject manifest = document.object();
+    iDefaultDuration   = manifest.value("defaultDuration").toInt(-1);
+    sDefaultTransition = manifest.value("defaultTransition").toString();
+
+    QDir slideDir(sDir);
+    // The slides must be in the slide directory (no "../", no absolute
+    // paths, no links to elsewhere)
+    QString sRoot = QFileInfo(sDir).canonicalFilePath() + QString("/");
+    QVector<Entry> entries;
+    const QJsonArray slides = manifest.value("slides").toArray();
+    for(const QJsonValue& value : slides) {
+        QJsonObject slide = value.toObject();
+        Entry entry;
+        QString sFile = slideDir.absoluteFilePath(slide.value("file").toString());
+        if(!QFileInfo(sFile).isFile()) {
+            logMessage(Q_NULLPTR,
+                       Q_FUNC_INFO,
+                       QString("Missing slide %1").arg(sFile));
+            continue;
+        }
+        entry.fileName = QFileInfo(sFile).canonicalFilePath();
+        if(!entry.fileName.startsWith(sRoot)) {
+            logMessage(Q_NULLPTR,
+                       Q_FUNC_INFO,
+                       QString("Slide %1 outside of %2 refused").arg(sFile, sDir));
+            continue;
+        }
+        entry.duration   = slide.value("duration").toInt(-1);
+        entry.transition = slide.value("transition").toString();
+        entry.weight     = qBound(1, slide.value("weight").toInt(1), MAX_WEIGHT);
+        entries.append(entry);
+    }
+    if(entries.isEmpty())
+        return false;
+    buildSequence(entries);
+    return true;
+}
+
+
+/*!
+ * \brief SlidePlaylist::listDirectory Build the sequence from the images in the directory
+ */
+void
+SlidePlaylist::listDirectory() {
+    iDefaultDuration   = -1;
+    sDefaultTransition = QString();
+    QVector<Entry> entries;
+    QDir slideDir(sDir);
+    if(slideDir.exists()) {
+        QStringList nameFilter = QStringList()
+                << "*.jpg" << "*.jpeg" << "*.png"
+                << "*.JPG" << "*.JPEG" << "*.PNG";
+        slideDir.setNameFilters(nameFilter);
+        slideDir.setFilter(QDir::Files);
+        const QFileInfoList slideList = slideDir.entryInfoList();
+        for(const QFileInfo& slideInfo : slideList) {
+            Entry entry;
+            entry.fileName = slideInfo.absoluteFilePath();
+            entry.duration = -1;
+            entry.weight   = 1;
+            entries.append(entry);
+        }
+    }
+    buildSequence(entries);
+}
+
+
+/*!
+ * \brief SlidePlaylist::buildSequence Expand the weights into the showing order
+ * \param entries The playlist entries
+ *
+ * A smooth weighted round robin spreads the repetitions of the heavier
+ * (sponsor) slides along the cycle; with all the weights equal to 1 the
+ * sequence is the manifest order.
+ */
+void
+SlidePlaylist::buildSequence(const QVector<Entry>& entries) {
+    sequence.clear();
+    int totalWeight = 0;
+    for(const Entry& entry : entries)
+        totalWeight += entry.weight;
+    int sequenceLength = qMin(totalWeight, MAX_SEQUENCE);
+    QVector<int> current(entries.count(), 0);
+    for(int k=0; k<sequenceLength; k++) {
+        int iBest = 0;
+        for(int i=0; i<entries.count(); i++) {
+            current[i] += entries.at(i).weight;
+            if(current.at(i) > current.at(iBest))
+                iBest = i;
+        }
+        current[iBest] -= totalWeight;
+        sequence.append(entries.at(iBest));
+    }
+}
@@ -0,0 +1,63 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QString>
+#include <QVector>
+#include <QDateTime>
+
+
+class SlidePlaylist
+{
+public:
+    /*!
+     * \brief One slide of the playlist
+     */
+    struct Entry {
+        QString fileName;   /*!< Absolute path of the slide */
+        int     duration;   /*!< Show time in msec (-1 = default) */
+        QString transition; /*!< Transition name (empty = default) */
+        int     weight;     /*!< Relative number of appearances */
+    };
+
+public:
+    SlidePlaylist();
+    void setDirectory(QString sNewDir);
+    bool refresh();
+    int count() const;
+    const Entry& at(int index) const;
+    int defaultDuration() const;
+    QString defaultTransition() const;
+
+private:
+    bool loadManifest(QString sManifest);
+    void listDirectory();
+    void buildSequence(const QVector<Entry>& entries);
+
+private:
+    QString         sDir;
+    bool            bManifestExists;
+    QDateTime       manifestTime;
+    qint64          manifestSize;
+    QDateTime       dirTime;
+    bool            bHasManifest;
+    int             iDefaultDuration;
+    QString         sDefaultTransition;
+    QVector<Entry>  sequence;
+};
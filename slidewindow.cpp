@@ -20,31 +20,39 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QDebug>
 #include <QPainter>
 #include <QApplication>
+#include <QImageReader>
+#include <QScreen>
 
 #include "slidewindow.h"
+#include "imageresampler.h"
 #include "utility.h"
+#include "metrics.h"
+#include "trace.h"
+#include "stallwatchdog.h"
 
 
 #define STEADY_SHOW_TIME       5000 // Change slide time
 #define TRANSITION_TIME        3000 // Transition duration
 #define TRANSITION_GRANULARITY 30   // Steps to complete transition
+#define DECODE_QUALITY         90   // Above 50 the jpeg plugin scales smoothly
+#define KENBURNS_TIME          6000 // Pan and zoom duration
+#define KENBURNS_GRANULARITY   150  // Frames of the pan and zoom
+#define KENBURNS_ZOOM          1.5  // Initial magnification of the pan and zoom
+#define KENBURNS_FADE          0.15 // Fraction of the pan and zoom spent fading in
 
 
 SlideWindow::SlideWindow(QWidget *parent)
     : QLabel(tr("Nessuna Slide Presente"))
-    , pPresentImage(nullptr)
-    , pNextImage(nullptr)
-    , pPresentImageToShow(nullptr)
-    , pNextImageToShow(nullptr)
-    , pShownImage(nullptr)
     , iCurrentSlide(0)
     , steadyShowTime(STEADY_SHOW_TIME)
+    , nextShowTime(STEADY_SHOW_TIME)
     , transitionTime(TRANSITION_TIME)
     , transitionGranularity(TRANSITION_GRANULARITY)
     , transitionStepNumber(0)
-//    , transitionType(transition_Abrupt)
-//    , transitionType(transition_FromLeft)
-    , transitionType(transition_Fade)
+//    , defaultTransition(transition_Abrupt)
+//    , defaultTransition(transition_FromLeft)
+    , defaultTransition(transition_Fade)
+    , transitionType(defaultTransition)
     , bRunning(false)
 {
     Q_UNUSED(parent);
@@ -52,6 +60,7 @@ SlideWindow::SlideWindow(QWidget *parent)
     sSlideDir = QDir::homePath();// Just to have a default location
     setAlignment(Qt::AlignCenter);
     setMinimumSize(QSize(320, 240));
+    setTransitionType(defaultTransition);
 
     connect(&transitionTimer, SIGNAL(timeout()),
             this, SLOT(onTransitionTimeElapsed()));
@@ -81,11 +90,6 @@ SlideWindow::SlideWindow(QWidget *parent)
 
 
 SlideWindow::~SlideWindow() {
-    if(pPresentImageToShow) delete pPresentImageToShow;
-    if(pNextImageToShow)    delete pNextImageToShow;
-    if(pShownImage)         delete pShownImage;
-    if(pPresentImage)       delete pPresentImage;
-    if(pNextImage)          delete pNextImage;
 }
 
 
@@ -93,60 +97,278 @@ void
 SlideWindow::setSlideDir(QString sNewDir) {
     if(sNewDir != sSlideDir) {
         sSlideDir = sNewDir;
-        updateSlideList();
+        playlist.setDirectory(sSlideDir);
+        playlist.refresh();
         iCurrentSlide = 0;
-        if(pPresentImage) delete pPresentImage;
-        pPresentImage = nullptr;
-        if(pNextImage) delete pNextImage;
-        pNextImage = nullptr;
+        presentImage = QImage();
+        nextImage    = QImage();
     }
 }
 
 
 bool
 SlideWindow::isReady() {
-    return (pPresentImage != nullptr && pNextImage != nullptr);
+    return (!presentImage.isNull() && !nextImage.isNull());
 }
 
 
+/*!
+ * \brief SlideWindow::transitionFromName
+ * \param sName The transition name used in the playlist
+ * \return The corresponding transition (the default one if unknown)
+ */
+SlideWindow::transitionMode
+SlideWindow::transitionFromName(QString sName) {
+    if(sName == QString("abrupt"))   return transition_Abrupt;
+    if(sName == QString("fromleft")) return transition_FromLeft;
+    if(sName == QString("fade"))     return transition_Fade;
+    if(sName == QString("kenburns")) return transition_KenBurns;
+    return defaultTransition;
+}
+
+
+/*!
+ * \brief SlideWindow::loadSlide Prefetch a slide of the playlist
+ * \param index The position of the slide in the playlist
+ * \return The decoded slide
+ *
+ * The transition used to enter the slide and its show time are taken
+ * from the playlist before decoding, so that the image is prepared
+ * exactly for the way it will be shown.
+ */
+QImage
+SlideWindow::loadSlide(int index) {
+    TRACE_SCOPE("SlideWindow::loadSlide");
+    const SlidePlaylist::Entry& entry = playlist.at(index);
+    QString sTransition = entry.transition;
+    if(sTransition.isEmpty())
+        sTransition = playlist.defaultTransition();
+    setTransitionType(transitionFromName(sTransition));
+    nextShowTime = entry.duration;
+    if(nextShowTime <= 0)
+        nextShowTime = playlist.defaultDuration();
+    if(nextShowTime <= 0)
+        nextShowTime = STEADY_SHOW_TIME;
+    return loadImage(entry.fileName);
+}
+
+
+/*!
+ * \brief SlideWindow::loadNextSlide Prefetch the next slide that can be decoded
+ * \return The decoded slide (a null image if none of the playlist can be)
+ *
+ * A slide that cannot be decoded (e.g. corrupted or still uploading) is
+ * skipped: a null next image would stop the show.
+ */
+QImage
+SlideWindow::loadNextSlide() {
+    for(int i=0; i<playlist.count(); i++) {
+        iCurrentSlide = (iCurrentSlide+1) % playlist.count();
+        QImage image = loadSlide(iCurrentSlide);
+        if(!image.isNull())
+            return image;
+    }
+    return QImage();
+}
+
+
+/*!
+ * \brief SlideWindow::targetSize
+ * \return The size of the screen where the slides will be shown
+ */
+QSize
+SlideWindow::targetSize() {
+    QList<QScreen*> screens = QApplication::screens();
+    if(screens.count() > 1)
+        return screens.at(1)->geometry().size();
+    return size();
+}
+
+
+/*!
+ * \brief SlideWindow::loadImage Decode an image just large enough to fit the screen
+ * \param sFileName The image file to load
+ * \return The decoded image (a null image on error)
+ *
+ * The header is read first to know the original size; the decoder is then
+ * asked for an aspect-fit reduced image so that, for jpeg files, libjpeg
+ * can skip most of the work through its DCT scaling.
+ */
+QImage
+SlideWindow::loadImage(QString sFileName) {
+    QImageReader reader(sFileName);
+    reader.setAutoTransform(true);
+    QSize imageSize = reader.size();
+    if(imageSize.isValid()) {
+        // Phone photos are often stored rotated with an EXIF orientation tag
+        if(reader.transformation() & QImageIOHandler::TransformationRotate90)
+            imageSize.transpose();
+        QSize screenSize = targetSize();
+        if(transitionType == transition_KenBurns) // Room for the initial zoom
+            screenSize = screenSize * KENBURNS_ZOOM;
+        QSize fitSize = imageSize.scaled(screenSize, Qt::KeepAspectRatio);
+        if(fitSize.width()  < imageSize.width() &&
+           fitSize.height() < imageSize.height())
+        {
+            if(reader.transformation() & QImageIOHandler::TransformationRotate90)
+                fitSize.transpose();
+            reader.setQuality(DECODE_QUALITY);
+            reader.setScaledSize(fitSize);
+        }
+    }
+    QImage image = reader.read();
+    if(image.isNull()) {
+        logMessage(Q_NULLPTR,
+                   Q_FUNC_INFO,
+                   QString("Unable to load %1: %2")
+                   .arg(sFileName, reader.errorString()));
+    }
+    return image;
+}
+
+
+/*!
+ * \brief SlideWindow::setTransitionType
+ * \param newType The transition to use from the next slide change
+ */
+void
+SlideWindow::setTransitionType(transitionMode newType) {
+    transitionType = newType;
+    if(transitionType == transition_KenBurns) {
+        transitionTime        = KENBURNS_TIME;
+        transitionGranularity = KENBURNS_GRANULARITY;
+    }
+    else {
+        transitionTime        = TRANSITION_TIME;
+        transitionGranularity = TRANSITION_GRANULARITY;
+    }
+}
+
+
+/*!
+ * \brief SlideWindow::buildKenBurnsCanvas Prepare the slide for the pan and zoom
+ * \param image The (next) slide
+ *
+ * The slide is fitted, once, on a white canvas KENBURNS_ZOOM times
+ * larger than the window. The frames never shrink the canvas more than
+ * KENBURNS_ZOOM times (less than 2): a bilinear sample of this single
+ * level does not alias, so no smaller mip level is needed.
+ */
 void
-SlideWindow::updateSlideList() {
-    slideList = QFileInfoList();
-    QDir slideDir(sSlideDir);
-    if(slideDir.exists()) {
-        QStringList nameFilter = QStringList()
-                << "*.jpg" << "*.jpeg" << "*.png"
-                << "*.JPG" << "*.JPEG" << "*.PNG";
-        slideDir.setNameFilters(nameFilter);
-        slideDir.setFilter(QDir::Files);
-        slideList = slideDir.entryInfoList();
+SlideWindow::buildKenBurnsCanvas(const QImage& image) {
+    TRACE_SCOPE("SlideWindow::buildKenBurnsCanvas");
+    QSize canvasSize = size() * KENBURNS_ZOOM;
+    QImage canvas(canvasSize, QImage::Format_ARGB32_Premultiplied);
+    QImage scaledImage = ImageResampler::scaled(image, canvasSize, Qt::KeepAspectRatio);
+    QPainter painter(&canvas);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(canvas.rect(), Qt::white);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    painter.drawImage((canvasSize.width()-scaledImage.width())/2,
+                      (canvasSize.height()-scaledImage.height())/2,
+                      scaledImage);
+    painter.end();
+    kenBurnsCanvas = canvas;
+    kenBurnsAnchor = QPointF(double(rand()%3)/2.0, double(rand()%3)/2.0);
+}
+
+
+/*!
+ * \brief SlideWindow::renderKenBurnsFrame Render a pan and zoom frame into shownImage
+ * \param progress The transition progress in [0, 1]
+ *
+ * The view zooms out from KENBURNS_ZOOM to the fitted slide while
+ * drifting from kenBurnsAnchor to the whole canvas. Every frame is
+ * bilinearly sampled from the canvas.
+ */
+void
+SlideWindow::renderKenBurnsFrame(double progress) {
+    if(kenBurnsCanvas.isNull())
+        return;
+    double ease = progress*progress*(3.0-2.0*progress);
+    double zoom = KENBURNS_ZOOM - (KENBURNS_ZOOM-1.0)*ease;
+    // Canvas pixels for each window pixel
+    double scale = KENBURNS_ZOOM / zoom;
+    QSize canvasSize = kenBurnsCanvas.size();
+    double x0 = (canvasSize.width()  - width()*scale)  * kenBurnsAnchor.x();
+    double y0 = (canvasSize.height() - height()*scale) * kenBurnsAnchor.y();
+
+    const uchar* pLevelBits = kenBurnsCanvas.constBits();
+    int levelStride = kenBurnsCanvas.bytesPerLine();
+    int maxU = kenBurnsCanvas.width()  - 2;
+    int maxV = kenBurnsCanvas.height() - 2;
+    // 16.16 fixed point sampling coordinates
+    qint64 du = qint64(scale * 65536.0);
+    qint64 u0 = qint64((x0 + 0.5*scale - 0.5) * 65536.0);
+    double v0 = y0 + 0.5*scale - 0.5;
+    double dv = scale;
+
+    uchar* pShownBits = shownImage.bits();
+    int shownStride = shownImage.bytesPerLine();
+    int w = qMin(width(), shownImage.width());
+    int h = qMin(height(), shownImage.height());
+
+    ImageResampler::forEachBand(h, w, [&](int first, int last) {
+        for(int y=first; y<last; y++) {
+            qint64 v = qint64((v0 + y*dv) * 65536.0);
+            int iv = qBound(0, int(v >> 16), maxV);
+            uint fv = uint(v >> 8) & 0xFF;
+            const quint32* pRow0 = reinterpret_cast<const quint32*>(pLevelBits + iv*levelStride);
+            const quint32* pRow1 = reinterpret_cast<const quint32*>(pLevelBits + (iv+1)*levelStride);
+            quint32* pDst = reinterpret_cast<quint32*>(pShownBits + y*shownStride);
+            qint64 u = u0;
+            for(int x=0; x<w; x++, u+=du) {
+                int iu = qBound(0, int(u >> 16), maxU);
+                uint fu = uint(u >> 8) & 0xFF;
+                // Two channels at a time: 0x00RR00BB and 0x00AA00GG
+                quint32 tl = pRow0[iu], tr = pRow0[iu+1];
+                quint32 bl = pRow1[iu], br = pRow1[iu+1];
+                quint32 topRB = (((tl & 0xFF00FF)*(256-fu) + (tr & 0xFF00FF)*fu) >> 8) & 0xFF00FF;
+                quint32 topAG = ((((tl >> 8) & 0xFF00FF)*(256-fu) + ((tr >> 8) & 0xFF00FF)*fu) >> 8) & 0xFF00FF;
+                quint32 botRB = (((bl & 0xFF00FF)*(256-fu) + (br & 0xFF00FF)*fu) >> 8) & 0xFF00FF;
+                quint32 botAG = ((((bl >> 8) & 0xFF00FF)*(256-fu) + ((br >> 8) & 0xFF00FF)*fu) >> 8) & 0xFF00FF;
+                quint32 rb = ((topRB*(256-fv) + botRB*fv) >> 8) & 0xFF00FF;
+                quint32 ag = ((topAG*(256-fv) + botAG*fv) >> 8) & 0xFF00FF;
+                pDst[x] = rb | (ag << 8);
+            }
+        }
+    });
+
+    if(progress < KENBURNS_FADE) {
+        QPainter painter(&shownImage);
+        painter.setOpacity(1.0 - progress/KENBURNS_FADE);
+        painter.drawImage(0, 0, presentImageToShow);
+        painter.end();
     }
 }
 
 
 void
 SlideWindow::startSlideShow() {
+    WATCHDOG_PHASE("SlideWindow::startSlideShow");
     if(bRunning) // Already Running...Nothing to do
         return;
-    updateSlideList();
-    if(slideList.count() == 0) {
+    playlist.setDirectory(sSlideDir);
+    playlist.refresh();
+    if(playlist.count() == 0) {
         showTimer.start(steadyShowTime);
         bRunning = true;
         return;
     }
-    if(pPresentImage == nullptr) {// That's the first image...
-        iCurrentSlide = iCurrentSlide % slideList.count();
-        QImage* pImage = new QImage(slideList.at(iCurrentSlide).absoluteFilePath());
-        if(pImage == nullptr)
+    if(presentImage.isNull()) {// That's the first image...
+        iCurrentSlide = iCurrentSlide % playlist.count();
+        QImage image = loadSlide(iCurrentSlide);
+        if(image.isNull())
+            image = loadNextSlide();
+        if(image.isNull()) {// Nothing can be shown yet: retried by onNewSlideTimer()
+            showTimer.start(steadyShowTime);
+            bRunning = true;
             return;
-        addFirstImage(*pImage);
-        iCurrentSlide++;
-        iCurrentSlide= iCurrentSlide % slideList.count();
-        QImage* pNextImage = new QImage(slideList.at(iCurrentSlide).absoluteFilePath());
-        if(pNextImage)
-            addNewImage(*pNextImage);
-        else
-            addNewImage(*pImage);
+        }
+        addFirstImage(image);
+        steadyShowTime = nextShowTime;
+        QImage nextSlide = loadNextSlide();
+        addNewImage(nextSlide.isNull() ? image : nextSlide);
     }
     showTimer.start(steadyShowTime);
     bRunning = true;
@@ -155,71 +377,118 @@ SlideWindow::startSlideShow() {
 
 void
 SlideWindow::addFirstImage(QImage image) {
-    QImage* pImage = new QImage(image);
-    pPresentImage = pImage;
-    pNextImage    = nullptr;
+    presentImage = image;
+    nextImage    = QImage();
 }
 
 
 void
 SlideWindow::addNewImage(QImage image) {
-    QImage* pImage = new QImage(image);
-    if(pNextImage == nullptr) {
-        pNextImage = pImage;
-        QImage scaledPresentImage, scaledNextImage;
-        if(pPresentImage)
-            scaledPresentImage = pPresentImage->scaled(size(), Qt::KeepAspectRatio);
-        if(pNextImage)
-            scaledNextImage    = pNextImage->scaled(size(), Qt::KeepAspectRatio);
-
-        if(pPresentImageToShow) delete pPresentImageToShow;
-        if(pNextImageToShow)    delete pNextImageToShow;
-        if(pShownImage)         delete pShownImage;
-
-        pPresentImageToShow = new QImage(size(), QImage::Format_ARGB32_Premultiplied);
-        pNextImageToShow    = new QImage(size(), QImage::Format_ARGB32_Premultiplied);
-        pShownImage         = new QImage(size(), QImage::Format_ARGB32_Premultiplied);
-
-        int x = (size().width()-scaledPresentImage.width())/2;
-        int y = (size().height()-scaledPresentImage.height())/2;
-
-        QPainter presentPainter(pPresentImageToShow);
-        presentPainter.setCompositionMode(QPainter::CompositionMode_Source);
-        presentPainter.fillRect(rect(), Qt::white);
-        presentPainter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-        presentPainter.drawImage(x, y, scaledPresentImage);
-        presentPainter.end();
-
-        x = (size().width()-scaledNextImage.width())/2;
-        y = (size().height()-scaledNextImage.height())/2;
-
-        QPainter nextPainter(pNextImageToShow);
-        nextPainter.setCompositionMode(QPainter::CompositionMode_Source);
-        nextPainter.fillRect(rect(), Qt::white);
-        nextPainter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-        nextPainter.drawImage(x, y, scaledNextImage);
-        nextPainter.end();
-
-        computeRegions(&rectSourcePresent, &rectDestinationPresent,
-                       &rectSourceNext,    &rectDestinationNext);
-
-        QPainter painter(pShownImage);
-        painter.setCompositionMode(QPainter::CompositionMode_Source);
-        painter.drawImage(rectDestinationNext, *pNextImageToShow, rectSourceNext);
-        painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-        painter.drawImage(rectDestinationPresent, *pPresentImageToShow, rectSourcePresent);
-        painter.end();
-
-        setPixmap(QPixmap::fromImage(*pShownImage));
+    if(nextImage.isNull()) {
+        nextImage = image;
+        renderSlides();
     }
     else {
-        delete pPresentImage;
-        pPresentImage = pNextImage;
-        pNextImage = pImage;
+        presentImage = nextImage;
+        nextImage    = image;
     }
 }
 
 
+/*!
+ * \brief SlideWindow::renderSlides Fits the present and the next slide to the window
+ *
+ * The frame buffers are reused while the window size does not change.
+ */
+void
+SlideWindow::renderSlides() {
+    presentImageToShow = frameBuffer(presentImageToShow);
+    nextImageToShow    = frameBuffer(nextImageToShow);
+    shownImage         = frameBuffer(shownImage);
+
+    fitSlide(presentImage, &presentImageToShow);
+    fitSlide(nextImage, &nextImageToShow);
+    if(transitionType == transition_KenBurns)
+        buildKenBurnsCanvas(nextImage);
+
+    composeSlides();
+    setPixmap(QPixmap::fromImage(shownImage));
+}
+
+
+/*!
+ * \brief SlideWindow::advanceSlides The next slide becomes the present one
+ *
+ * The fitted next slide is kept as the present one and its old buffer
+ * receives the new next slide: nothing is allocated at each slide.
+ */
+void
+SlideWindow::advanceSlides() {
+    presentImageToShow.swap(nextImageToShow);
+    nextImageToShow = frameBuffer(nextImageToShow);
+    shownImage      = frameBuffer(shownImage);
+
+    fitSlide(nextImage, &nextImageToShow);
+    if(transitionType == transition_KenBurns)
+        buildKenBurnsCanvas(nextImage);
+
+    // The next slide may use a transition with no step 0 rendering
+    composeSlides();
+}
+
+
+/*!
+ * \brief SlideWindow::fitSlide Draws a slide, centered on white, in a frame buffer
+ * \param slide The slide (possibly null)
+ * \param pToShow A frame buffer of the window size
+ */
+void
+SlideWindow::fitSlide(const QImage& slide, QImage* pToShow) {
+    QImage scaledImage;
+    if(!slide.isNull())
+        scaledImage = ImageResampler::scaled(slide, size(), Qt::KeepAspectRatio);
+    int x = (size().width()-scaledImage.width())/2;
+    int y = (size().height()-scaledImage.height())/2;
+
+    QPainter painter(pToShow);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.fillRect(rect(), Qt::white);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    painter.drawImage(x, y, scaledImage);
+    painter.end();
+}
+
+
+/*!
+ * \brief SlideWindow::composeSlides Draws the present step of the transition in shownImage
+ */
+void
+SlideWindow::composeSlides() {
+    computeRegions(&rectSourcePresent, &rectDestinationPresent,
+                   &rectSourceNext,    &rectDestinationNext);
+
+    QPainter painter(&shownImage);
+    painter.setCompositionMode(QPainter::CompositionMode_Source);
+    painter.drawImage(rectDestinationNext, nextImageToShow, rectSourceNext);
+    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
+    painter.drawImage(rectDestinationPresent, presentImageToShow, rectSourcePresent);
+    painter.end();
+}
+
+
+/*!
+ * \brief SlideWindow::frameBuffer
+ * \param image A frame buffer (possibly null or of the wrong size)
+ * \return The same buffer if it already has the window size, a new one otherwise
+ */
+QImage
+SlideWindow::frameBuffer(const QImage& image) const {
+    if(image.size() == size() && !image.isNull())
+        return image;
+    return QImage(size(), QImage::Format_ARGB32_Premultiplied);
+}
+
+
 /*!
  * \brief SlideWindow::stopSlideShow
  */
@@ -299,53 +568,13 @@ SlideWindow::keyPressEvent(QKeyEvent *event) {
  */
 void
 SlideWindow::resizeEvent(QResizeEvent *event) {
+    WATCHDOG_PHASE("SlideWindow::resizeEvent");
     mySize = event->size();
-    if(pPresentImage==nullptr || pNextImage==nullptr) {
+    if(presentImage.isNull() || nextImage.isNull()) {
         event->accept();
         return;
     }
-    QImage scaledPresentImage = pPresentImage->scaled(size(), Qt::KeepAspectRatio);
-    QImage scaledNextImage    = pNextImage->scaled(size(), Qt::KeepAspectRatio);
-
-    if(pPresentImageToShow) delete pPresentImageToShow;
-    if(pNextImageToShow)    delete pNextImageToShow;
-    if(pShownImage)         delete pShownImage;
-
-    pPresentImageToShow = new QImage(size(), QImage::Format_ARGB32_Premultiplied);
-    pNextImageToShow    = new QImage(size(), QImage::Format_ARGB32_Premultiplied);
-    pShownImage         = new QImage(size(), QImage::Format_ARGB32_Premultiplied);
-
-    int x = (size().width()-scaledPresentImage.width())/2;
-    int y = (size().height()-scaledPresentImage.height())/2;
-
-    QPainter presentPainter(pPresentImageToShow);
-    presentPainter.setCompositionMode(QPainter::CompositionMode_Source);
-    presentPainter.fillRect(rect(), Qt::white);
-    presentPainter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-    presentPainter.drawImage(x, y, scaledPresentImage);
-    presentPainter.end();
-
-    x = (size().width()-scaledNextImage.width())/2;
-    y = (size().height()-scaledNextImage.height())/2;
-
-    QPainter nextPainter(pNextImageToShow);
-    nextPainter.setCompositionMode(QPainter::CompositionMode_Source);
-    nextPainter.fillRect(rect(), Qt::white);
-    nextPainter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-    nextPainter.drawImage(x, y, scaledNextImage);
-    nextPainter.end();
-
-    computeRegions(&rectSourcePresent, &rectDestinationPresent,
-                   &rectSourceNext,    &rectDestinationNext);
-
-    QPainter painter(pShownImage);
-    painter.setCompositionMode(QPainter::CompositionMode_Source);
-    painter.drawImage(rectDestinationNext, *pNextImageToShow, rectSourceNext);
-    painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-    painter.drawImage(rectDestinationPresent, *pPresentImageToShow, rectSourcePresent);
-    painter.end();
-
-    setPixmap(QPixmap::fromImage(*pShownImage));
+    renderSlides();
 }
 
 
@@ -354,20 +583,20 @@ SlideWindow::resizeEvent(QResizeEvent *event) {
  */
 void
 SlideWindow::onNewSlideTimer() {
-    updateSlideList();
-    if(slideList.count() == 0) {// Still no slides !
+    GUI_PHASE("SlideWindow::onNewSlideTimer");
+    playlist.refresh();
+    if(playlist.count() == 0) {// Still no slides !
         return;
     }
-    if(pPresentImage == nullptr) {// That's the first image...
-        addNewImage(QImage(slideList.at(0).absoluteFilePath()));
-        iCurrentSlide = 0;
-        if(slideList.count() > 1) {
-            addNewImage(QImage(slideList.at(1).absoluteFilePath()));
-            iCurrentSlide = 1;
-        }
-        else {// Only one image is in the directory
-            addNewImage(*pPresentImage);
-        }
+    if(presentImage.isNull()) {// That's the first image...
+        iCurrentSlide = playlist.count()-1;
+        QImage image = loadNextSlide();
+        if(image.isNull()) // None can be decoded (yet)
+            return;
+        addFirstImage(image);
+        steadyShowTime = nextShowTime;
+        QImage nextSlide = loadNextSlide(); // The same one if it is the only one
+        addNewImage(nextSlide.isNull() ? image : nextSlide);
     }
     if(transitionType == transition_FromLeft) {
         showTimer.stop();
@@ -376,42 +605,21 @@ SlideWindow::onNewSlideTimer() {
     }
     else if(transitionType == transition_Abrupt) {
         transitionStepNumber = 0;
-        if(pPresentImageToShow) delete pPresentImageToShow;
-        *pPresentImage = *pNextImage;
-        pPresentImageToShow = pNextImageToShow;
-        if(slideList.count() == 0) {
+        presentImage = nextImage;
+        if(playlist.count() == 0) {
             return;
         }
-        iCurrentSlide += 1;
-        iCurrentSlide = iCurrentSlide % slideList.count();
-        addNewImage(QImage(slideList.at(iCurrentSlide).absoluteFilePath()));
-        QImage scaledNextImage = pNextImage->scaled(size(), Qt::KeepAspectRatio);
-        pNextImageToShow = new QImage(size(), QImage::Format_ARGB32_Premultiplied);
-
-        if(pShownImage) delete pShownImage;
-        pShownImage = new QImage(size(), QImage::Format_ARGB32_Premultiplied);
-        int x = (size().width()-scaledNextImage.width())/2;
-        int y = (size().height()-scaledNextImage.height())/2;
-
-        QPainter nextPainter(pNextImageToShow);
-        nextPainter.setCompositionMode(QPainter::CompositionMode_Source);
-        nextPainter.fillRect(rect(), Qt::white);
-        nextPainter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-        nextPainter.drawImage(x, y, scaledNextImage);
-        nextPainter.end();
-
-        computeRegions(&rectSourcePresent, &rectDestinationPresent,
-                       &rectSourceNext,    &rectDestinationNext);
-        QPainter painter(pShownImage);
-        painter.setCompositionMode(QPainter::CompositionMode_Source);
-        painter.drawImage(rectDestinationNext, *pNextImageToShow, rectSourceNext);
-        painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-        painter.drawImage(rectDestinationPresent, *pPresentImageToShow, rectSourcePresent);
-        painter.end();
-
-        setPixmap(QPixmap::fromImage(*pShownImage));
+        steadyShowTime = nextShowTime;
+        showTimer.start(steadyShowTime);
+        QImage image = loadNextSlide();
+        // Nothing else can be decoded: the present slide stays
+        addNewImage(image.isNull() ? presentImage : image);
+        advanceSlides();
+        setPixmap(QPixmap::fromImage(shownImage));
+        updateImageMetrics();
     }
-    else if (transitionType == transition_Fade) {
+    else if (transitionType == transition_Fade ||
+             transitionType == transition_KenBurns) {
         showTimer.stop();
         transitionStepNumber = 0;
         transitionTimer.start(int(double(transitionTime)/double(transitionGranularity)));
@@ -425,60 +633,83 @@ SlideWindow::onNewSlideTimer() {
  */
 void
 SlideWindow::onTransitionTimeElapsed() {
-    if(pPresentImage == nullptr || pNextImage == nullptr || pShownImage == nullptr)
+    GUI_PHASE("SlideWindow::onTransitionTimeElapsed");
+    if(presentImage.isNull() || nextImage.isNull() || shownImage.isNull()) {
+        // Nothing to move to: back to the steady show, not a frozen one
+        transitionTimer.stop();
+        showTimer.start(steadyShowTime);
         return;
+    }
+    QElapsedTimer frameTimer;
+    frameTimer.start();
     transitionStepNumber++;
+    if(transitionStepNumber == 1)
+        transitionClock.start();
     if(transitionStepNumber > transitionGranularity) {
         transitionTimer.stop();
+        if(transitionClock.isValid()) {
+            qint64 elapsed = qMax(qint64(1), transitionClock.elapsed());
+            Metrics::transitionFps.set(1000.0*transitionGranularity/double(elapsed));
+            transitionClock.invalidate();
+        }
         transitionStepNumber = 0;
-        if(pPresentImageToShow) delete pPresentImageToShow;
-        *pPresentImage = *pNextImage;
-        pPresentImageToShow = pNextImageToShow;
-        updateSlideList();
-        if(slideList.count() == 0) {
+        presentImage = nextImage;
+        playlist.refresh();
+        if(playlist.count() == 0) {// Waits for new slides
+            showTimer.start(steadyShowTime);
             return;
         }
-        iCurrentSlide++;
-        iCurrentSlide = iCurrentSlide % slideList.count();
-        addNewImage(QImage(slideList.at(iCurrentSlide).absoluteFilePath()));
-
-        QImage scaledNextImage = pNextImage->scaled(size(), Qt::KeepAspectRatio);
-        pNextImageToShow = new QImage(size(), QImage::Format_ARGB32_Premultiplied);
-
-        if(pShownImage) delete pShownImage;
-        pShownImage = new QImage(size(), QImage::Format_ARGB32_Premultiplied);
-        int x = (size().width()-scaledNextImage.width())/2;
-        int y = (size().height()-scaledNextImage.height())/2;
-
-        QPainter nextPainter(pNextImageToShow);
-        nextPainter.setCompositionMode(QPainter::CompositionMode_Source);
-        nextPainter.fillRect(rect(), Qt::white);
-        nextPainter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-        nextPainter.drawImage(x, y, scaledNextImage);
-        nextPainter.end();
+        steadyShowTime = nextShowTime;
+        QImage image = loadNextSlide();
+        // Nothing else can be decoded: the present slide stays
+        addNewImage(image.isNull() ? presentImage : image);
+        advanceSlides();
+        updateImageMetrics();
 
         showTimer.start(steadyShowTime);
     }
     if(transitionType == transition_FromLeft) {
         computeRegions(&rectSourcePresent, &rectDestinationPresent,
                        &rectSourceNext,    &rectDestinationNext);
-        QPainter painter(pShownImage);
+        QPainter painter(&shownImage);
         painter.setCompositionMode(QPainter::CompositionMode_Source);
-        painter.drawImage(rectDestinationNext, *pNextImageToShow, rectSourceNext);
+        painter.drawImage(rectDestinationNext, nextImageToShow, rectSourceNext);
         painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-        painter.drawImage(rectDestinationPresent, *pPresentImageToShow, rectSourcePresent);
+        painter.drawImage(rectDestinationPresent, presentImageToShow, rectSourcePresent);
         painter.end();
     }
     else if (transitionType == transition_Fade) {
-        QPainter painter(pShownImage);
+        QPainter painter(&shownImage);
         qreal opacity = qreal(transitionStepNumber)/qreal(transitionGranularity);
         painter.setOpacity(opacity);
         painter.setCompositionMode(QPainter::CompositionMode_Source);
-        painter.drawImage(0, 0, *pNextImageToShow);
+        painter.drawImage(0, 0, nextImageToShow);
         painter.setOpacity(1.0-opacity);
         painter.setCompositionMode(QPainter::CompositionMode_SourceOver);
-        painter.drawImage(0, 0, *pPresentImageToShow);
+        painter.drawImage(0, 0, presentImageToShow);
         painter.end();
     }
-    setPixmap(QPixmap::fromImage(*pShownImage));
+    else if (transitionType == transition_KenBurns) {
+        if(transitionStepNumber > 0)
+            renderKenBurnsFrame(double(transitionStepNumber)/double(transitionGranularity));
+    }
+    setPixmap(QPixmap::fromImage(shownImage));
+    Metrics::transitionFrames.add();
+    Metrics::transitionFrameTime.observe(frameTimer.nsecsElapsed()/1000);
+}
+
+
+/*!
+ * \brief SlideWindow::updateImageMetrics Account for the memory held by the images
+ */
+void
+SlideWindow::updateImageMetrics() {
+    qint64 nBytes = 0;
+    const QImage* images[] = {
+        &presentImage, &nextImage, &presentImageToShow, &nextImageToShow, &shownImage
+    };
+    for(const QImage* pImage : images)
+        nBytes += pImage->sizeInBytes();
+    nBytes += kenBurnsCanvas.sizeInBytes();
+    Metrics::imageBytes.set(double(nBytes));
 }
@@ -22,9 +22,13 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QTimer>
 #include <QLabel>
 #include <QFileInfoList>
+#include <QImage>
+#include <QElapsedTimer>
 
 #include <qevent.h>
 
+#include "slideplaylist.h"
+
 
 class SlideWindow : public QLabel
 {
@@ -50,12 +54,26 @@ public:
     enum transitionMode {
         transition_Abrupt,/*!< Abrupt transition */
         transition_FromLeft,/*!< Enter from Left */
-        transition_Fade/*!< Fade Out - Fade In */
+        transition_Fade,/*!< Fade Out - Fade In */
+        transition_KenBurns/*!< Pan and Zoom */
     };
+    void setTransitionType(transitionMode newType);
 
 private:
     void computeRegions(QRect* sourcePresent, QRect* destinationPresent, QRect* sourceNext, QRect* destinationNext);
-    void updateSlideList();
+    transitionMode transitionFromName(QString sName);
+    QImage loadSlide(int index);
+    QImage loadNextSlide();
+    QSize targetSize();
+    QImage loadImage(QString sFileName);
+    void buildKenBurnsCanvas(const QImage& image);
+    void renderKenBurnsFrame(double progress);
+    void updateImageMetrics();
+    void renderSlides();
+    void advanceSlides();
+    void fitSlide(const QImage& slide, QImage* pToShow);
+    void composeSlides();
+    QImage frameBuffer(const QImage& image) const;
 
 public slots:
     void onNewSlideTimer();
@@ -64,18 +82,22 @@ public slots:
 
 private:
     QString sSlideDir;
-    QFileInfoList slideList;
-    QImage* pPresentImage;
-    QImage* pNextImage;
-    QImage* pPresentImageToShow;
-    QImage* pNextImageToShow;
-    QImage* pShownImage;
+    SlidePlaylist playlist;
+    QImage presentImage;
+    QImage nextImage;
+    QImage presentImageToShow;
+    QImage nextImageToShow;
+    QImage shownImage;
+    QImage kenBurnsCanvas;
+    QPointF kenBurnsAnchor;
 
     QTimer showTimer;
     QTimer transitionTimer;
+    QElapsedTimer transitionClock;
 
     int iCurrentSlide;
     int steadyShowTime;
+    int nextShowTime;
     int transitionTime;
     int transitionGranularity;
     int transitionStepNumber;
@@ -85,6 +107,7 @@ private:
     QRect rectDestinationPresent;
     QRect rectDestinationNext;
 
+    transitionMode defaultTransition;
     transitionMode transitionType;
     bool bRunning;
     QPalette           panelPalette;
@@ -0,0 +1,322 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QDir>
+#include <QFile>
+#include <QFileInfo>
+#include <QSaveFile>
+#include <QCryptographicHash>
+
+#include "spotsync.h"
+
+
+#define MIN_CHUNK    (16*1024)   // No cut point before this size
+#define MAX_CHUNK    (256*1024)  // Forced cut point
+#define CHUNK_MASK   0xFFFFull   // 16 bits: 64 KB average chunk
+#define READ_BLOCK   (1024*1024)
+#define GEAR_SEED    0x5650ull   // The controller must use the same table
+
+
+namespace {
+
+/*!
+ * \brief gearTable The random values of the rolling hash
+ *
+ * Generated with splitmix64 from GEAR_SEED, so that the controller
+ * can build the very same table and find the very same cut points.
+ */
+const quint64*
+gearTable() {
+    static const QVector<quint64> table = []() {
+        QVector<quint64> values(256);
+        quint64 state = GEAR_SEED;
+        for(int i=0; i<256; i++) {
+            quint64 z = (state += 0x9E3779B97F4A7C15ull);
+            z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ull;
+            z = (z ^ (z >> 27)) * 0x94D049BB133111EBull;
+            values[i] = z ^ (z >> 31);
+        }
+        return values;
+    }();
+    return table.constData();
+}
+
+} // namespace
+
+
+/*!
+ * \brief SpotSync::SpotSync Delta synchronization of the spot directory
+ * \param pChunkStore Where the received chunks are kept
+ *
+ * Spots are split in content defined chunks (a "gear" rolling hash picks
+ * the cut points) so that an edit in a file changes only the chunks
+ * around it. Only the chunks not found in the local spots, nor in the
+ * store, are requested to the controller.
+ * A new spot is assembled in a hidden temporary file (not matching *.mp4)
+ * and renamed over the old one: a running player keeps reading the old
+ * file and startSpotLoop() never sees a partial one.
+ * To be used from the upload thread only.
+ */
+SpotSync::SpotSync(ChunkStore* pChunkStore)
+    : pStore(pChunkStore)
+{
+    sSpotDir = QDir::homePath() + QString("/spots/");
+}
+
+
+void
+SpotSync::setSpotDir(QString sNewDir) {
+    if(!sNewDir.endsWith(QString("/"))) sNewDir+= QString("/");
+    if(sNewDir == sSpotDir)
+        return;
+    sSpotDir = sNewDir;
+    files.clear();
+    locations.clear();
+}
+
+
+/*!
+ * \brief SpotSync::chunkFile Split a file in content defined chunks
+ * \param sFileName
+ * \return The chunks in file order (empty on error)
+ */
+QVector<SpotSync::Chunk>
+SpotSync::chunkFile(QString sFileName) {
+    QVector<Chunk> chunks;
+    QFile file(sFileName);
+    if(!file.open(QIODevice::ReadOnly))
+        return chunks;
+    const quint64* gear = gearTable();
+    QCryptographicHash hasher(QCryptographicHash::Sha256);
+    qint64  offset = 0;
+    int     length = 0;
+    quint64 h      = 0;
+    QByteArray block;
+    while(!(block = file.read(READ_BLOCK)).isEmpty()) {
+        const uchar* p = reinterpret_cast<const uchar*>(block.constData());
+        int start = 0;
+        for(int i=0; i<block.size(); i++) {
+            h = (h << 1) + gear[p[i]];
+            length++;
+            if((length >= MIN_CHUNK && (h & CHUNK_MASK) == 0) || length >= MAX_CHUNK) {
+                hasher.addData(block.constData()+start, i+1-start);
+                chunks.append(Chunk{hasher.result(), offset, length});
+                hasher.reset();
+                offset += length;
+                length = 0;
+                h = 0;
+                start = i+1;
+            }
+        }
+        hasher.addData(block.constData()+start, block.size()-start);
+    }
+    if(length > 0)
+        chunks.append(Chunk{hasher.result(), offset, length});
+    return chunks;
+}
+
+
+/*!
+ * \brief SpotSync::refreshIndex Chunk the spots added or changed since the last call
+ */
+void
+SpotSync::refreshIndex() {
+    QDir spotDir(sSpotDir);
+    spotDir.setNameFilters(QStringList() << "*.mp4" << "*.MP4");
+    spotDir.setFilter(QDir::Files);
+    QFileInfoList spotList = spotDir.entryInfoList();
+    QSet<QString> present;
+    bool bChanged = false;
+    for(const QFileInfo& spot : qAsConst(spotList)) {
+        QString sName = spot.fileName();
+        present.insert(sName);
+        auto it = files.constFind(sName);
+        if(it != files.constEnd() &&
+           it->size == spot.size() &&
+           it->modified == spot.lastModified())
+            continue;
+        files.insert(sName, FileIndex{spot.size(),
+                                      spot.lastModified(),
+                                      chunkFile(spot.absoluteFilePath())});
+        bChanged = true;
+    }
+    for(auto it=files.begin(); it!=files.end();) {
+        if(!present.contains(it.key())) {
+            it = files.erase(it);
+            bChanged = true;
+        }
+        else
+            ++it;
+    }
+    if(bChanged)
+        rebuildLocations();
+}
+
+
+void
+SpotSync::rebuildLocations() {
+    locations.clear();
+    for(auto it=files.constBegin(); it!=files.constEnd(); ++it) {
+        for(const Chunk& chunk : it->chunks)
+            locations.insert(chunk.hash, Location{it.key(), chunk.offset, chunk.length});
+    }
+}
+
+
+/*!
+ * \brief SpotSync::isValidManifest Checks the chunks announced by the controller
+ * \param size The spot size
+ * \param chunks The spot chunks
+ * \return false if a chunk cannot have been cut by chunkFile() or if the
+ * chunks do not add up to the spot size
+ *
+ * To be called before addManifest(): no chunk is asked for a malformed spot.
+ */
+bool
+SpotSync::isValidManifest(qint64 size, const QVector<Chunk>& chunks) {
+    qint64 total = 0;
+    for(const Chunk& chunk : chunks) {
+        if(chunk.hash.size() != HASH_LENGTH ||
+           chunk.length <= 0 || chunk.length > MAX_CHUNK)
+            return false;
+        total += chunk.length;
+        if(total > size)
+            return false;
+    }
+    return total == size;
+}
+
+
+/*!
+ * \brief SpotSync::addManifest A spot the controller wants on the Panel
+ * \param sName The spot file name
+ * \param size The spot size
+ * \param chunks The spot chunks (offsets are recomputed)
+ * \return The indexes of the chunks to transfer
+ */
+QStringList
+SpotSync::addManifest(QString sName, qint64 size, const QVector<Chunk>& chunks) {
+    refreshIndex();
+    Pending spot;
+    spot.size = size;
+    spot.chunks = chunks;
+    qint64 offset = 0;
+    QStringList sMissing;
+    for(int i=0; i<spot.chunks.count(); i++) {
+        Chunk& chunk = spot.chunks[i];
+        chunk.offset = offset;
+        offset += chunk.length;
+        if(locations.contains(chunk.hash) || pStore->contains(chunk.hash))
+            continue;
+        if(!spot.missing.contains(chunk.hash))
+            sMissing.append(QString::number(i));
+        spot.missing.insert(chunk.hash);
+    }
+    pending.insert(sName, spot);
+    return sMissing;
+}
+
+
+/*!
+ * \brief SpotSync::chunkStored A new chunk is in the store
+ * \param chunkHash
+ * \return The spots that can now be completed
+ */
+QStringList
+SpotSync::chunkStored(const QByteArray& chunkHash) {
+    QStringList sReady;
+    for(auto it=pending.begin(); it!=pending.end(); ++it) {
+        if(it->missing.remove(chunkHash) && it->missing.isEmpty())
+            sReady.append(it.key());
+    }
+    return sReady;
+}
+
+
+/*!
+ * \brief SpotSync::uses
+ * \return true if a spot still to be completed needs the chunk
+ */
+bool
+SpotSync::uses(const QByteArray& chunkHash) const {
+    for(const Pending& spot : pending)
+        for(const Chunk& chunk : spot.chunks)
+            if(chunk.hash == chunkHash)
+                return true;
+    return false;
+}
+
+
+QByteArray
+SpotSync::readChunk(const Chunk& chunk) const {
+    auto it = locations.constFind(chunk.hash);
+    if(it != locations.constEnd()) {
+        QFile file(sSpotDir + it->fileName);
+        if(file.open(QIODevice::ReadOnly) && file.seek(it->offset)) {
+            QByteArray data = file.read(it->length);
+            if(ChunkStore::hash(data) == chunk.hash)
+                return data;
+        }
+    }
+    return pStore->read(chunk.hash);
+}
+
+
+/*!
+ * \brief SpotSync::complete Assemble a spot and swap it in
+ * \param sName The spot file name
+ * \return true on success
+ */
+bool
+SpotSync::complete(QString sName) {
+    auto it = pending.find(sName);
+    if(it == pending.end())
+        return false;
+    Pending spot = *it;
+    pending.erase(it);
+
+    QString sTemp = sSpotDir + QString(".") + sName + QString(".sync");
+    QSaveFile tempFile(sTemp);
+    if(!tempFile.open(QIODevice::WriteOnly))
+        return false;
+    qint64 written = 0;
+    for(const Chunk& chunk : qAsConst(spot.chunks)) {
+        QByteArray data = readChunk(chunk);
+        if(data.size() != chunk.length || ChunkStore::hash(data) != chunk.hash ||
+           tempFile.write(data) != data.size())
+        {
+            tempFile.cancelWriting();
+            return false;
+        }
+        written += data.size();
+    }
+    if(written != spot.size || !tempFile.commit())
+        return false;
+    if(!ChunkStore::replaceFile(sTemp, sSpotDir + sName)) {
+        QFile::remove(sTemp);
+        return false;
+    }
+    // The new spot is indexed from its manifest: no need to read it again
+    QFileInfo spotInfo(sSpotDir + sName);
+    files.insert(sName, FileIndex{spotInfo.size(), spotInfo.lastModified(), spot.chunks});
+    rebuildLocations();
+    // ...and its chunks need not be kept twice
+    for(const Chunk& chunk : qAsConst(spot.chunks))
+        pStore->remove(chunk.hash);
+    return true;
+}
@@ -0,0 +1,79 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QString>
+#include <QStringList>
+#include <QVector>
+#include <QHash>
+#include <QSet>
+#include <QDateTime>
+
+#include "chunkstore.h"
+
+
+class SpotSync
+{
+public:
+    /*!
+     * \brief A content defined chunk of a file
+     */
+    struct Chunk {
+        QByteArray hash;   /*!< SHA-256 of the chunk */
+        qint64     offset; /*!< Position in the file */
+        int        length; /*!< Size in bytes */
+    };
+
+public:
+    explicit SpotSync(ChunkStore* pChunkStore);
+    void setSpotDir(QString sNewDir);
+    static bool isValidManifest(qint64 size, const QVector<Chunk>& chunks);
+    QStringList addManifest(QString sName, qint64 size, const QVector<Chunk>& chunks);
+    QStringList chunkStored(const QByteArray& chunkHash);
+    bool uses(const QByteArray& chunkHash) const;
+    bool complete(QString sName);
+    static QVector<Chunk> chunkFile(QString sFileName);
+
+private:
+    struct Location {
+        QString fileName;
+        qint64  offset;
+        int     length;
+    };
+    struct FileIndex {
+        qint64          size;
+        QDateTime       modified;
+        QVector<Chunk>  chunks;
+    };
+    struct Pending {
+        qint64           size;
+        QVector<Chunk>   chunks;
+        QSet<QByteArray> missing;
+    };
+    void refreshIndex();
+    void rebuildLocations();
+    QByteArray readChunk(const Chunk& chunk) const;
+
+private:
+    ChunkStore*                 pStore;
+    QString                     sSpotDir;
+    QHash<QString, FileIndex>   files;
+    QHash<QByteArray, Location> locations;
+    QHash<QString, Pending>     pending;
+};
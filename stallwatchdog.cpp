@@ -0,0 +1,151 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QElapsedTimer>
+#include <QMap>
+#include <QMutex>
+#include <QMutexLocker>
+
+#include "stallwatchdog.h"
+#include "metrics.h"
+
+
+#define HEARTBEAT_INTERVAL  50 // msec between two ticks of the GUI thread
+#define CHECK_INTERVAL      20 // msec between two checks of the watchdog
+#define STALL_THRESHOLD    250 // msec without ticks to report a stall
+
+
+std::atomic<quint64>     StallWatchdog::tick(0);
+std::atomic<const char*> StallWatchdog::currentPhase(nullptr);
+
+
+namespace {
+
+QMutex&
+stallsMutex() {
+    static QMutex mutex;
+    return mutex;
+}
+
+
+QMap<QByteArray, quint64>&
+stallsByPhase() {
+    static QMap<QByteArray, quint64> stalls;
+    return stalls;
+}
+
+} // namespace
+
+
+/*!
+ * \brief StallWatchdog::StallWatchdog Watches the GUI thread event loop
+ * \param parent
+ *
+ * It must be created on the GUI thread: its heartbeat timer increments
+ * an atomic tick that the watchdog thread expects to change.
+ */
+StallWatchdog::StallWatchdog(QObject *parent)
+    : QThread(parent)
+    , bStop(false)
+{
+    setObjectName(QString("Watchdog"));
+    connect(&heartbeatTimer, SIGNAL(timeout()),
+            this, SLOT(onHeartbeat()));
+    heartbeatTimer.start(HEARTBEAT_INTERVAL);
+}
+
+
+void
+StallWatchdog::stop() {
+    heartbeatTimer.stop();
+    bStop.store(true);
+    wait();
+}
+
+
+void
+StallWatchdog::onHeartbeat() {
+    tick.fetch_add(1, std::memory_order_relaxed);
+}
+
+
+/*!
+ * \brief StallWatchdog::run Reports the periods without heartbeats
+ *
+ * The phase is sampled while the GUI thread is still blocked, i.e.
+ * the phase that is responsible for the stall.
+ */
+void
+StallWatchdog::run() {
+    QElapsedTimer clock;
+    clock.start();
+    quint64 lastTick = tick.load(std::memory_order_relaxed);
+    qint64 lastChange = clock.elapsed();
+    bool bStalled = false;
+    const char* sStallPhase = nullptr;
+    while(!bStop.load()) {
+        msleep(CHECK_INTERVAL);
+        quint64 currentTick = tick.load(std::memory_order_relaxed);
+        qint64 now = clock.elapsed();
+        if(currentTick != lastTick) {
+            if(bStalled)
+                record(sStallPhase, (now-lastChange-HEARTBEAT_INTERVAL)*1000);
+            lastTick = currentTick;
+            lastChange = now;
+            bStalled = false;
+            sStallPhase = nullptr;
+            continue;
+        }
+        if(now-lastChange > STALL_THRESHOLD) {
+            bStalled = true;
+            if(!sStallPhase)
+                sStallPhase = phase();
+        }
+    }
+}
+
+
+void
+StallWatchdog::record(const char* sPhase, qint64 usec) {
+    QByteArray sName(sPhase ? sPhase : "event loop");
+    Metrics::stalls.add();
+    Metrics::stallTime.observe(usec);
+    {
+        QMutexLocker locker(&stallsMutex());
+        stallsByPhase()[sName]++;
+    }
+    emit stallDetected(QString::fromLatin1(sName), usec/1000);
+}
+
+
+/*!
+ * \brief StallWatchdog::exposition
+ * \return The stalls of every phase in the Prometheus text format
+ */
+QByteArray
+StallWatchdog::exposition() {
+    QByteArray text;
+    text += "# HELP volleypanel_phase_stalls_total GUI thread stalls by phase\n";
+    text += "# TYPE volleypanel_phase_stalls_total counter\n";
+    QMutexLocker locker(&stallsMutex());
+    for(auto it = stallsByPhase().constBegin(); it != stallsByPhase().constEnd(); ++it) {
+        text += "volleypanel_phase_stalls_total{phase=\"" + it.key() + "\"} " +
+                QByteArray::number(it.value()) + "\n";
+    }
+    return text;
+}
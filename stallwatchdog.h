@@ -0,0 +1,100 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QThread>
+#include <QTimer>
+#include <atomic>
+
+#include "trace.h"
+
+
+#define WATCHDOG_CONCAT_(a, b) a##b
+#define WATCHDOG_CONCAT(a, b)  WATCHDOG_CONCAT_(a, b)
+/*!
+ * \brief WATCHDOG_PHASE Marks the GUI thread work done in the enclosing scope
+ * \param sName A string literal
+ *
+ * A stall of the event loop is attributed to the innermost phase.
+ */
+#define WATCHDOG_PHASE(sName) WatchdogPhase WATCHDOG_CONCAT(watchdogPhase_, __LINE__)(sName)
+/*!
+ * \brief GUI_PHASE Traces the enclosing scope and marks it as the GUI thread phase
+ * \param sName A string literal, used by both
+ */
+#define GUI_PHASE(sName) TRACE_SCOPE(sName); WATCHDOG_PHASE(sName)
+
+
+class StallWatchdog : public QThread
+{
+    Q_OBJECT
+
+public:
+    explicit StallWatchdog(QObject *parent = nullptr);
+    void stop();
+    static const char* phase() {
+        return currentPhase.load(std::memory_order_relaxed);
+    }
+    static void setPhase(const char* sPhase) {
+        currentPhase.store(sPhase, std::memory_order_relaxed);
+    }
+    static QByteArray exposition();
+
+signals:
+    void stallDetected(QString sPhase, qint64 msec);
+
+protected:
+    void run() override;
+
+private slots:
+    void onHeartbeat();
+
+private:
+    void record(const char* sPhase, qint64 usec);
+
+private:
+    QTimer                          heartbeatTimer;
+    std::atomic<bool>               bStop;
+    static std::atomic<quint64>     tick;
+    static std::atomic<const char*> currentPhase;
+};
+
+
+/*!
+ * \brief Sets the phase of the GUI thread from construction to destruction
+ *
+ * It costs two relaxed atomic stores: use it on the GUI thread only.
+ */
+class WatchdogPhase
+{
+public:
+    explicit WatchdogPhase(const char* sPhase)
+        : sPrevious(StallWatchdog::phase())
+    {
+        StallWatchdog::setPhase(sPhase);
+    }
+    ~WatchdogPhase() {
+        StallWatchdog::setPhase(sPrevious);
+    }
+    WatchdogPhase(const WatchdogPhase&) = delete;
+    WatchdogPhase& operator=(const WatchdogPhase&) = delete;
+
+private:
+    const char* sPrevious;
+};
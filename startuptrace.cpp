@@ -0,0 +1,78 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QFile>
+#include <QString>
+
+#include "startuptrace.h"
+#include "utility.h"
+
+
+QElapsedTimer                       StartupTrace::timer;
+QVector<QPair<const char*, qint64>> StartupTrace::phases;
+bool                                StartupTrace::bDone = false;
+
+
+/*!
+ * \brief StartupTrace::mark Record the end of a start-up phase
+ * \param sPhase The name of the phase just completed (a string literal)
+ *
+ * The first call starts the clock. Once the first frame has been
+ * painted the calls are ignored.
+ */
+void
+StartupTrace::mark(const char* sPhase) {
+    if(bDone)
+        return;
+    if(!timer.isValid())
+        timer.start();
+    phases.append(qMakePair(sPhase, timer.nsecsElapsed()));
+}
+
+
+/*!
+ * \brief StartupTrace::firstFrame Close the trace and log the phase durations
+ * \param logFile The log file (if any)
+ */
+void
+StartupTrace::firstFrame(QFile* logFile) {
+    if(bDone)
+        return;
+    mark("first frame");
+    bDone = true;
+    QString sTrace;
+    qint64 previous = 0;
+    for(const QPair<const char*, qint64>& phase : qAsConst(phases)) {
+        sTrace += QString("%1: %2 ms; ")
+                  .arg(QString::fromLatin1(phase.first))
+                  .arg(double(phase.second-previous)/1.0e6, 0, 'f', 1);
+        previous = phase.second;
+    }
+    sTrace += QString("total %1 ms").arg(double(previous)/1.0e6, 0, 'f', 1);
+    logMessage(logFile,
+               Q_FUNC_INFO,
+               sTrace);
+    phases.clear();
+    phases.squeeze();
+}
+
+
+bool
+StartupTrace::isDone() {
+    return bDone;
+}
@@ -0,0 +1,356 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QApplication>
+#include <QCommandLineParser>
+#include <QDir>
+#include <QEventLoop>
+#include <QFile>
+#include <QImage>
+#include <QPainter>
+#include <QStandardPaths>
+#include <QTemporaryDir>
+#include <QTextStream>
+#include <QTimer>
+#include <QVector>
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include "volleypanel.h"
+#include "messagewindow.h"
+#include "resourcecache.h"
+#include "metrics.h"
+#include "panelconfig.h"
+#include "protocol.h"
+
+
+#define CYCLE_TIME          250 // msec of events after each batch of messages
+#define SAMPLE_PERIOD         4 // cycles between two samples
+#define ORIENTATION_PERIOD   24 // cycles between two orientation flips
+#define SLIDESHOW_PERIOD     40 // cycles between two slide shows
+#define SLIDESHOW_LENGTH     16 // cycles of slide show
+#define SLIDE_DURATION      400 // msec
+#define LEVEL_SAMPLES         5 // The final level is the lowest of the last samples
+#define RSS_SLACK   (8*1024*1024) // bytes the resident memory may grow past the plateau
+#define ALLOCATION_SLACK   2000 // live blocks that may be added past the plateau
+
+
+namespace {
+
+std::atomic<qint64> liveAllocations(0); // Blocks from operator new not yet deleted
+
+} // namespace
+
+
+/*
+ * Every operator new (the array and nothrow ones call it) is counted.
+ * The QImage pixels are malloc'ed: they show in the resident memory.
+ */
+void*
+operator new(std::size_t size) {
+    void* p = std::malloc(size ? size : 1);
+    if(!p)
+        throw std::bad_alloc();
+    liveAllocations.fetch_add(1, std::memory_order_relaxed);
+    return p;
+}
+
+
+void
+operator delete(void* p) noexcept {
+    if(!p)
+        return;
+    liveAllocations.fetch_sub(1, std::memory_order_relaxed);
+    std::free(p);
+}
+
+
+void
+operator delete(void* p, std::size_t) noexcept {
+    ::operator delete(p);
+}
+
+
+namespace {
+
+/*!
+ * \brief The Panel with the message dispatch of the network thread exposed
+ */
+class SoakPanel : public VolleyPanel
+{
+public:
+    SoakPanel() : VolleyPanel(Q_NULLPTR) {}
+    using VolleyPanel::applyMessage;
+    using VolleyPanel::scoreState;
+};
+
+
+struct Sample {
+    qint64 residentBytes;
+    qint64 cacheBytes;
+    qint64 allocations;
+};
+
+
+/*!
+ * \brief Two 1920x1080 screens side by side: the Panel goes on the second one
+ *
+ * The offscreen platform reads the layout from a JSON file
+ * ("-platform offscreen:configfile=...").
+ */
+bool
+createScreens(const QString& sFileName) {
+    QFile config(sFileName);
+    if(!config.open(QIODevice::WriteOnly))
+        return false;
+    config.write("{ \"screens\": [\n"
+                 "  { \"name\": \"Console\", \"x\": 0,    \"y\": 0, \"width\": 1920, \"height\": 1080 },\n"
+                 "  { \"name\": \"Panel\",   \"x\": 1920, \"y\": 0, \"width\": 1920, \"height\": 1080 }\n"
+                 "] }\n");
+    return true;
+}
+
+
+/*!
+ * \brief The value exported as process_resident_memory_bytes
+ */
+qint64
+residentBytes() {
+    const QList<QByteArray> lines = Metrics::exposition().split('\n');
+    for(const QByteArray& line : lines) {
+        if(line.startsWith("process_resident_memory_bytes "))
+            return line.mid(line.indexOf(' ')+1).toLongLong();
+    }
+    return 0;
+}
+
+
+void
+wait(int msec) {
+    QEventLoop loop;
+    QTimer::singleShot(msec, &loop, &QEventLoop::quit);
+    loop.exec();
+}
+
+
+void
+apply(SoakPanel& panel, const QString& sMessage) {
+    ProtocolMessage message;
+    message.parse(sMessage);
+    panel.applyMessage(message);
+}
+
+
+/*!
+ * \brief Some slides, with different transitions, and one that cannot be decoded
+ */
+bool
+createSlides(const QString& sDir) {
+    const char* transitions[] = { "fade", "fromleft", "abrupt", "kenburns" };
+    QString sSlides;
+    for(int i=0; i<4; i++) {
+        QImage slide(1920, 1080, QImage::Format_RGB32);
+        slide.fill(QColor::fromHsv(i*90, 200, 200));
+        QPainter painter(&slide);
+        painter.setFont(QFont(QString("Sans"), 200));
+        painter.drawText(slide.rect(), Qt::AlignCenter, QString::number(i));
+        painter.end();
+        QString sName = QString("slide%1.jpg").arg(i);
+        if(!slide.save(QDir(sDir).filePath(sName)))
+            return false;
+        sSlides += QString("{ \"file\": \"%1\", \"transition\": \"%2\" },").arg(sName, QString(transitions[i]));
+    }
+    QFile broken(QDir(sDir).filePath(QString("broken.jpg")));
+    if(!broken.open(QIODevice::WriteOnly))
+        return false;
+    broken.write("\xFF\xD8\xFF this is not a jpeg");
+    broken.close();
+    sSlides += QString("{ \"file\": \"broken.jpg\" }");
+
+    QFile manifest(QDir(sDir).filePath(QString("playlist.json")));
+    if(!manifest.open(QIODevice::WriteOnly))
+        return false;
+    manifest.write(QString("{ \"defaultDuration\": %1, \"slides\": [ %2 ] }")
+                   .arg(SLIDE_DURATION).arg(sSlides).toUtf8());
+    return true;
+}
+
+} // namespace
+
+
+/*
+ * The score changes, the orientation flips, the slide show starts and
+ * stops and a message window runs, over and over. Every batch must be
+ * shown and the slide show must run. The resident memory, the image
+ * cache and the live allocations must level off after the warm-up: the
+ * lowest of the last samples is compared with the highest of the
+ * warm-up ones.
+ */
+int
+main(int argc, char *argv[]) {
+    // The Panel refuses to start without a second screen
+    QTemporaryDir screenDir;
+    if(qEnvironmentVariableIsEmpty("QT_QPA_PLATFORM")) {
+        QString sScreens = QDir(screenDir.path()).filePath(QString("screens.json"));
+        if(!screenDir.isValid() || !createScreens(sScreens)) {
+            QTextStream(stdout) << "FAIL: unable to configure the screens" << Qt::endl;
+            return 1;
+        }
+        qputenv("QT_QPA_PLATFORM", QString("offscreen:configfile=%1").arg(sScreens).toLocal8Bit());
+    }
+    qputenv("QT_LOGGING_RULES","*.debug=false;qt.qpa.*=false");
+    // The configuration of the Panel under test is not the real one
+    QStandardPaths::setTestModeEnabled(true);
+    QApplication app(argc, argv);
+    QTextStream out(stdout);
+    if(QApplication::screens().count() < 2) {
+        out << "FAIL: " << QApplication::platformName()
+            << " shows a single screen: the Panel would not start" << Qt::endl;
+        return 1;
+    }
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption cyclesOption(QString("cycles"), QString("Cycles to run."), QString("n"), QString("480"));
+    QCommandLineOption warmupOption(QString("warmup"), QString("Warm-up cycles."), QString("n"), QString("120"));
+    parser.addOptions({cyclesOption, warmupOption});
+    parser.process(app);
+    const int nCycles = parser.value(cyclesOption).toInt();
+    const int nWarmup = parser.value(warmupOption).toInt();
+    if(nWarmup < SLIDESHOW_PERIOD+SLIDESHOW_LENGTH || nCycles < nWarmup+LEVEL_SAMPLES*SAMPLE_PERIOD) {
+        out << "FAIL: the warm-up must include a slide show and be followed by some samples" << Qt::endl;
+        return 1;
+    }
+
+    QTemporaryDir slideDir;
+    if(!slideDir.isValid() || !createSlides(slideDir.path())) {
+        out << "FAIL: unable to create the slides" << Qt::endl;
+        return 1;
+    }
+
+    // Nothing listening: the Panel is driven only by this test
+    PanelConfig* pSettings = PanelConfig::instance();
+    pSettings->setValue("metrics/port", 0);
+    pSettings->setValue("discovery/port", 0);
+    pSettings->setValue("stream/port", 0);
+    pSettings->setValue("export/mode", QString());
+
+    int iResult = 0;
+    {
+        SoakPanel panel;
+        panel.showFullScreen();
+        MessageWindow messageWindow;
+        apply(panel, QString("<slidedir>%1</slidedir>").arg(slideDir.path()));
+
+        QVector<Sample> samples;
+        int nMissed = 0;
+        for(int iCycle=0; iCycle<nCycles; iCycle++) {
+            apply(panel, QString("<team0>Home %1</team0><team1>Guests %2</team1>")
+                         .arg(iCycle % 7).arg(iCycle % 5));
+            apply(panel, Protocol::serialize<Protocol::Tag::Score0>(iCycle % 26).toString() +
+                         Protocol::serialize<Protocol::Tag::Score1>((iCycle/2) % 26).toString() +
+                         Protocol::serialize<Protocol::Tag::Set0>(iCycle % 4).toString() +
+                         Protocol::serialize<Protocol::Tag::Set1>((iCycle/3) % 4).toString() +
+                         Protocol::serialize<Protocol::Tag::Timeout0>(iCycle % 3).toString() +
+                         Protocol::serialize<Protocol::Tag::Timeout1>((iCycle/2) % 3).toString() +
+                         Protocol::serialize<Protocol::Tag::Servizio>(iCycle % 2).toString());
+            ScoreState expected;
+            expected.team[0]    = QString("Home %1").arg(iCycle % 7);
+            expected.team[1]    = QString("Guests %1").arg(iCycle % 5);
+            expected.score[0]   = iCycle % 26;
+            expected.score[1]   = (iCycle/2) % 26;
+            expected.set[0]     = iCycle % 4;
+            expected.set[1]     = (iCycle/3) % 4;
+            expected.timeout[0] = iCycle % 3;
+            expected.timeout[1] = (iCycle/2) % 3;
+            expected.servizio   = iCycle % 2;
+            if(panel.scoreState != expected)
+                nMissed++;
+            if(iCycle % ORIENTATION_PERIOD == 0)
+                apply(panel, Protocol::serialize<Protocol::Tag::SetOrientation>((iCycle/ORIENTATION_PERIOD) % 2).toString());
+            if(iCycle % SLIDESHOW_PERIOD == 0)
+                apply(panel, Protocol::serialize<Protocol::Tag::SlideShow>(0).toString());
+            if(iCycle % SLIDESHOW_PERIOD == SLIDESHOW_LENGTH)
+                apply(panel, Protocol::serialize<Protocol::Tag::EndSlideShow>(0).toString());
+            if(iCycle % 2 == 0) {
+                messageWindow.setDisplayedText(QString("Message %1").arg(iCycle));
+                messageWindow.showFullScreen();
+            }
+            else {
+                messageWindow.hide();
+            }
+            wait(CYCLE_TIME);
+
+            if(iCycle % SAMPLE_PERIOD == 0)
+                samples.append(Sample{residentBytes(), ResourceCache::cacheBytes(),
+                                      liveAllocations.load(std::memory_order_relaxed)});
+        }
+        apply(panel, Protocol::serialize<Protocol::Tag::EndSlideShow>(0).toString());
+
+        // The Panel really went through the messages
+        out << "score batches not shown: " << nMissed << " of " << nCycles << Qt::endl;
+        out << "slide transition frames: " << Metrics::transitionFrames.get() << Qt::endl;
+        if(nMissed > 0) {
+            out << "FAIL: the Panel did not show every score" << Qt::endl;
+            iResult = 1;
+        }
+        if(Metrics::transitionFrames.get() == 0) {
+            out << "FAIL: the slide show never ran" << Qt::endl;
+            iResult = 1;
+        }
+
+        int nWarmupSamples = nWarmup/SAMPLE_PERIOD;
+        Sample plateau{0, 0, 0};
+        for(int i=0; i<nWarmupSamples; i++) {
+            plateau.residentBytes = qMax(plateau.residentBytes, samples.at(i).residentBytes);
+            plateau.cacheBytes    = qMax(plateau.cacheBytes,    samples.at(i).cacheBytes);
+            plateau.allocations   = qMax(plateau.allocations,   samples.at(i).allocations);
+        }
+        Sample level = samples.last();
+        for(int i=samples.count()-LEVEL_SAMPLES; i<samples.count(); i++) {
+            level.residentBytes = qMin(level.residentBytes, samples.at(i).residentBytes);
+            level.cacheBytes    = qMin(level.cacheBytes,    samples.at(i).cacheBytes);
+            level.allocations   = qMin(level.allocations,   samples.at(i).allocations);
+        }
+        out << "resident memory: plateau " << plateau.residentBytes
+            << " final " << level.residentBytes << " bytes" << Qt::endl;
+        out << "image cache:     plateau " << plateau.cacheBytes
+            << " final " << level.cacheBytes << " bytes" << Qt::endl;
+        out << "live allocations: plateau " << plateau.allocations
+            << " final " << level.allocations << " blocks" << Qt::endl;
+        if(plateau.residentBytes == 0)
+            out << "  resident memory not available on this system: not checked" << Qt::endl;
+        else if(level.residentBytes > plateau.residentBytes + RSS_SLACK) {
+            out << "FAIL: the resident memory grows past the plateau" << Qt::endl;
+            iResult = 1;
+        }
+        if(level.cacheBytes > plateau.cacheBytes) {
+            out << "FAIL: the image cache grows past the plateau" << Qt::endl;
+            iResult = 1;
+        }
+        if(level.allocations > plateau.allocations + ALLOCATION_SLACK) {
+            out << "FAIL: the live allocations grow past the plateau" << Qt::endl;
+            iResult = 1;
+        }
+    }
+    ResourceCache::clear();
+    if(iResult == 0)
+        out << "PASS" << Qt::endl;
+    return iResult;
+}
@@ -0,0 +1,25 @@
+# Soak test: the Panel, its slide show and a message window driven for a
+# while on two offscreen screens (QT_QPA_PLATFORM=offscreen:configfile=...).
+# It exits with 1 if a score is not shown, if the slide show does not run
+# or if the resident memory, the image cache or the live allocations keep
+# growing past the warm-up plateau.
+
+QT += core
+QT += gui
+QT += network
+QT += websockets
+QT += widgets
+
+CONFIG += c++17
+CONFIG += console
+CONFIG -= app_bundle
+
+DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000
+
+include(../../VolleyPanel.pri)
+
+SOURCES += \
+    main.cpp
+
+RESOURCES += \
+    ../../VolleyPanel.qrc
@@ -0,0 +1,134 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QFontMetrics>
+#include <QPainter>
+
+#include "textfitter.h"
+
+#if (QT_VERSION < QT_VERSION_CHECK(5, 11, 0))
+    #define horizontalAdvance width
+#endif
+
+
+#define MIN_PIXEL_SIZE      8    // Smallest font size tried
+#define MAX_METRICS_CACHE   4096 // Cached (text, size) measures
+#define MAX_PIXMAP_CACHE    16   // Cached rendered texts
+
+
+/*!
+ * \brief TextFitter::TextFitter Renders texts at the largest size fitting a slot
+ * \param sNewFontName The font family
+ * \param newFontWeight The font weight
+ * \param newColor The text color
+ */
+TextFitter::TextFitter(QString sNewFontName, int newFontWeight, QColor newColor)
+    : sFontName(sNewFontName)
+    , fontWeight(newFontWeight)
+    , textColor(newColor)
+{
+}
+
+
+QFont
+TextFitter::font(int iPixelSize) {
+    // As in the panel: the constructor takes the weight as an int
+    // in Qt 5 and Qt 6 as well
+    QFont textFont(sFontName, -1, fontWeight);
+    textFont.setPixelSize(iPixelSize);
+    return textFont;
+}
+
+
+/*!
+ * \brief TextFitter::textSize The (cached) size of a text
+ * \param sText The text to measure
+ * \param iPixelSize The font pixel size
+ * \return The advance and the height of the text
+ */
+QSize
+TextFitter::textSize(const QString& sText, int iPixelSize) {
+    QPair<QString, int> key(sText, iPixelSize);
+    QHash<QPair<QString, int>, QSize>::const_iterator it = metricsCache.constFind(key);
+    if(it != metricsCache.constEnd())
+        return it.value();
+    if(metricsCache.count() >= MAX_METRICS_CACHE)
+        metricsCache.clear();
+    QFontMetrics metrics(font(iPixelSize));
+    QSize size(metrics.horizontalAdvance(sText), metrics.height());
+    metricsCache.insert(key, size);
+    return size;
+}
+
+
+/*!
+ * \brief TextFitter::fittedPixelSize Binary search of the largest fitting font
+ * \param sText The text to fit
+ * \param slotSize The available space
+ * \return The font pixel size
+ */
+int
+TextFitter::fittedPixelSize(const QString& sText, const QSize& slotSize) {
+    int low  = MIN_PIXEL_SIZE;
+    int high = qMax(low, slotSize.height());
+    while(low < high) {
+        int middle = (low + high + 1) / 2;
+        QSize size = textSize(sText, middle);
+        if(size.width() <= slotSize.width() && size.height() <= slotSize.height())
+            low = middle;
+        else
+            high = middle - 1;
+    }
+    return low;
+}
+
+
+/*!
+ * \brief TextFitter::fittedText The text rasterized at the largest fitting size
+ * \param sText The text to render
+ * \param slotSize The available space
+ * \return A transparent pixmap with the text
+ *
+ * The pixmap is cached so that sending again the same text costs nothing.
+ */
+QPixmap
+TextFitter::fittedText(const QString& sText, const QSize& slotSize) {
+    QString sKey = QString("%1x%2:%3")
+                   .arg(slotSize.width())
+                   .arg(slotSize.height())
+                   .arg(sText);
+    QHash<QString, QPixmap>::const_iterator it = pixmapCache.constFind(sKey);
+    if(it != pixmapCache.constEnd())
+        return it.value();
+
+    int iPixelSize = fittedPixelSize(sText, slotSize);
+    QSize size = textSize(sText, iPixelSize).expandedTo(QSize(1, 1));
+    QPixmap pixmap(size);
+    pixmap.fill(Qt::transparent);
+    QPainter painter(&pixmap);
+    painter.setRenderHint(QPainter::TextAntialiasing);
+    painter.setFont(font(iPixelSize));
+    painter.setPen(textColor);
+    painter.drawText(pixmap.rect(), Qt::AlignCenter, sText);
+    painter.end();
+
+    if(pixmapCache.count() >= MAX_PIXMAP_CACHE)
+        pixmapCache.clear();
+    pixmapCache.insert(sKey, pixmap);
+    return pixmap;
+}
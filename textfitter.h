@@ -0,0 +1,46 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QString>
+#include <QFont>
+#include <QColor>
+#include <QPixmap>
+#include <QHash>
+#include <QPair>
+
+
+class TextFitter
+{
+public:
+    TextFitter(QString sNewFontName, int newFontWeight, QColor newColor);
+    QPixmap fittedText(const QString& sText, const QSize& slotSize);
+    int fittedPixelSize(const QString& sText, const QSize& slotSize);
+
+private:
+    QFont font(int iPixelSize);
+    QSize textSize(const QString& sText, int iPixelSize);
+
+private:
+    QString                         sFontName;
+    int                             fontWeight;
+    QColor                          textColor;
+    QHash<QPair<QString, int>, QSize> metricsCache;
+    QHash<QString, QPixmap>         pixmapCache;
+};
@@ -16,7 +16,7 @@ You should have received a copy of the GNU General Public License
 along with this program.  If not, see <http://www.gnu.org/licenses/>.
 *
 */
-#include <QVBoxLayout>
+#include <QPainter>
 #include <QResizeEvent>
 #include <QGuiApplication>
 #include <QScreen>
@@ -25,6 +25,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 
 #include "timeoutwindow.h"
 #include "utility.h"
+#include "trace.h"
+#include "stallwatchdog.h"
 
 #if (QT_VERSION < QT_VERSION_CHECK(5, 11, 0))
     #define horizontalAdvance width
@@ -37,6 +39,7 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
  */
 TimeoutWindow::TimeoutWindow(QWidget *parent)
     : QWidget(parent)
+    , iShownValue(-1)
 {
     Q_UNUSED(parent);
     setMinimumSize(QSize(320, 240));
@@ -57,10 +60,6 @@ TimeoutWindow::TimeoutWindow(QWidget *parent)
     int height = screenGeometry.height();
     int iFontSize = height/4;
 
-    myLabel.setText(QString("No Text"));
-    myLabel.setAlignment(Qt::AlignCenter);
-    myLabel.setFont(QFont("Arial", iFontSize, QFont::Black));
-
     panelPalette = QWidget::palette();
     panelGradient = QLinearGradient(0.0, 0.0, 0.0, height);
     panelGradient.setColorAt(0, QColor(0, 0, START_GRADIENT));
@@ -76,18 +75,27 @@ TimeoutWindow::TimeoutWindow(QWidget *parent)
     setPalette(panelPalette);
 
     setWindowOpacity(0.8);
-    myLabel.setText(tr("-- No Text --"));
-    QVBoxLayout *panelLayout = new QVBoxLayout();
-    panelLayout->addWidget(&myLabel);
-    setLayout(panelLayout);
 
+    // The digits are rendered once: the countdown only blits them
+    QFont digitFont("Arial", iFontSize, QFont::Black);
+    QFontMetrics metrics(digitFont);
+    for(int i=0; i<10; i++) {
+        QString sDigit = QString::number(i);
+        QPixmap pixmap(metrics.horizontalAdvance(sDigit), metrics.height());
+        pixmap.fill(Qt::transparent);
+        QPainter painter(&pixmap);
+        painter.setFont(digitFont);
+        painter.setPen(panelPalette.color(QPalette::WindowText));
+        painter.drawText(pixmap.rect(), Qt::AlignCenter, sDigit);
+        painter.end();
+        digitPixmap[i] = pixmap;
+    }
+
+    // A single shot timer wakes us up only when the shown value changes
     TimerUpdate.setTimerType(Qt::PreciseTimer);
+    TimerUpdate.setSingleShot(true);
     connect(&TimerUpdate, SIGNAL(timeout()),
             this, SLOT(updateTime()));
-    TimerTimeout.setTimerType(Qt::PreciseTimer);
-    TimerTimeout.setSingleShot(true);
-    connect(&TimerTimeout, SIGNAL(timeout()),
-            this, SLOT(updateTime()));
 }
 
 
@@ -101,17 +109,68 @@ TimeoutWindow::~TimeoutWindow() {
 /*!
  * \brief TimeoutWindow::updateTime Update the time shown in the window
  * and hide the window when the countdown reach zero
+ *
+ * The remaining time is always computed from the deadline on the
+ * monotonic clock, so a late wake-up never accumulates into a drift.
  */
 void
 TimeoutWindow::updateTime() {
-    int remainingTime = TimerTimeout.remainingTime();
-    myLabel.setText(QString("%1").arg(1+(remainingTime/1000)));
-    if(remainingTime > 0)
-        update();
-    else {
+    GUI_PHASE("TimeoutWindow::updateTime");
+    qint64 remainingTime = deadline.remainingTimeNSecs();
+    if(remainingTime <= 0) {
         TimerUpdate.stop();
-        TimerTimeout.stop();
+        iShownValue = -1;
         emit doneTimeout();
+        return;
+    }
+    int iValue = int((remainingTime+999999999)/1000000000); // Rounded up
+    if(iValue != iShownValue) {
+        update(digitsRect(iShownValue).united(digitsRect(iValue)));
+        iShownValue = iValue;
+    }
+    // Next wake-up exactly at the next second boundary
+    qint64 nextChange = remainingTime - qint64(iValue-1)*1000000000;
+    TimerUpdate.start(int((nextChange+999999)/1000000));
+}
+
+
+/*!
+ * \brief TimeoutWindow::digitsRect
+ * \param iValue The value to show
+ * \return The rectangle covered by the digits of iValue (empty if none)
+ */
+QRect
+TimeoutWindow::digitsRect(int iValue) {
+    if(iValue < 0)
+        return QRect();
+    QString sValue = QString::number(iValue);
+    int w = 0;
+    int h = 0;
+    for(const QChar& digit : qAsConst(sValue)) {
+        w += digitPixmap[digit.digitValue()].width();
+        h  = qMax(h, digitPixmap[digit.digitValue()].height());
+    }
+    return QRect((width()-w)/2, (height()-h)/2, w, h);
+}
+
+
+/*!
+ * \brief TimeoutWindow::paintEvent Blit the pre-rendered digits
+ * \param event
+ */
+void
+TimeoutWindow::paintEvent(QPaintEvent *event) {
+    Q_UNUSED(event)
+    if(iShownValue < 0)
+        return;
+    QPainter painter(this);
+    QRect rect = digitsRect(iShownValue);
+    int x = rect.x();
+    QString sValue = QString::number(iShownValue);
+    for(const QChar& digit : qAsConst(sValue)) {
+        const QPixmap& pixmap = digitPixmap[digit.digitValue()];
+        painter.drawPixmap(x, rect.y(), pixmap);
+        x += pixmap.width();
     }
 }
 
@@ -122,9 +181,19 @@ TimeoutWindow::updateTime() {
  */
 void
 TimeoutWindow::startTimeout(int msecTime) {
-    TimerTimeout.start(msecTime);
-    TimerUpdate.start(100);
-    myLabel.setText(QString("%1").arg(int(0.999+(TimerTimeout.remainingTime()/1000.0))));
+    deadline = QDeadlineTimer(qint64(msecTime), Qt::PreciseTimer);
+    updateTime();
+}
+
+
+/*!
+ * \brief TimeoutWindow::startTimeout Start a countdown ending at a given time
+ * \param newDeadline The end of the timeout on the local monotonic clock
+ */
+void
+TimeoutWindow::startTimeout(QDeadlineTimer newDeadline) {
+    deadline = newDeadline;
+    updateTime();
 }
 
 
@@ -134,7 +203,7 @@ TimeoutWindow::startTimeout(int msecTime) {
 void
 TimeoutWindow::stopTimeout() {
     TimerUpdate.stop();
-    TimerTimeout.stop();
+    iShownValue = -1;
     emit doneTimeout();
 }
 
@@ -22,7 +22,8 @@ along with this program.  If not, see <http://www.gnu.org/licenses/>.
 #include <QObject>
 #include <QWidget>
 #include <QTimer>
-#include <QLabel>
+#include <QDeadlineTimer>
+#include <QPixmap>
 
 class TimeoutWindow : public QWidget
 {
@@ -34,6 +35,7 @@ public:
 
 public:
     void startTimeout(int msecTime);
+    void startTimeout(QDeadlineTimer newDeadline);
     void stopTimeout();
 
 public slots:
@@ -42,13 +44,20 @@ public slots:
 signals:
     void doneTimeout();
 
+protected:
+    void paintEvent(QPaintEvent *event);
+
+private:
+    QRect digitsRect(int iValue);
+
 private:
     QPalette           panelPalette;
     QLinearGradient    panelGradient;
     QBrush             panelBrush;
-    QLabel             myLabel;
-    QTimer             TimerTimeout;
+    QPixmap            digitPixmap[10];
+    QDeadlineTimer     deadline;
     QTimer             TimerUpdate;
+    int                iShownValue;
 };
 
 #endif // TIMEOUTWINDOW_H
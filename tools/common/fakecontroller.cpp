@@ -0,0 +1,169 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QNetworkDatagram>
+#include <QWebSocket>
+
+#include "fakecontroller.h"
+#include "protocol.h"
+
+
+/*!
+ * \brief FakeController::FakeController A controller on the loopback, for the harnesses
+ * \param sNewName
+ * \param parent
+ *
+ * It accepts the Panel WebSocket, answers every message (so that the
+ * heartbeat is satisfied) and, if asked, announces itself like a real
+ * controller, echoing the discovery probes after a given delay.
+ */
+FakeController::FakeController(QString sNewName, QObject *parent)
+    : QObject(parent)
+    , sName(sNewName)
+    , server(sNewName, QWebSocketServer::NonSecureMode)
+    , discoveryPort(0)
+    , replyDelay(0)
+{
+    connect(&server, SIGNAL(newConnection()),
+            this, SLOT(onNewConnection()));
+    connect(&announceTimer, SIGNAL(timeout()),
+            this, SLOT(onAnnounceTime()));
+    connect(&announceSocket, SIGNAL(readyRead()),
+            this, SLOT(onProbe()));
+}
+
+
+bool
+FakeController::listen(const QHostAddress& address) {
+    return server.listen(address, 0) &&
+           announceSocket.bind(address, 0);
+}
+
+
+quint16
+FakeController::port() const {
+    return server.serverPort();
+}
+
+
+QString
+FakeController::name() const {
+    return sName;
+}
+
+
+/*!
+ * \brief FakeController::announce Start to announce <controller>port</controller>
+ * \param port The discovery port of the Panel (on the loopback)
+ * \param msecInterval
+ * \param msecReplyDelay Added to the round trip of the probes
+ */
+void
+FakeController::announce(quint16 port, int msecInterval, int msecReplyDelay) {
+    discoveryPort = port;
+    replyDelay    = msecReplyDelay;
+    announceTimer.start(msecInterval);
+    onAnnounceTime();
+}
+
+
+void
+FakeController::onAnnounceTime() {
+    QByteArray baAnnounce = Protocol::serialize<Protocol::Tag::Controller>(port()).toString().toLatin1();
+    announceSocket.writeDatagram(baAnnounce, server.serverAddress(), discoveryPort);
+}
+
+
+void
+FakeController::onProbe() {
+    while(announceSocket.hasPendingDatagrams()) {
+        QNetworkDatagram datagram = announceSocket.receiveDatagram();
+        ProtocolMessage message;
+        message.parse(QString::fromUtf8(datagram.data()));
+        if(!message.has(Protocol::Tag::DiscoveryProbe))
+            continue;
+        QByteArray baReply = Protocol::serialize<Protocol::Tag::DiscoveryReply>(message.number(Protocol::Tag::DiscoveryProbe)).toString().toLatin1();
+        QHostAddress address = datagram.senderAddress();
+        quint16 senderPort = quint16(datagram.senderPort());
+        QTimer::singleShot(replyDelay, this, [this, baReply, address, senderPort]() {
+            if(announceTimer.isActive())
+                announceSocket.writeDatagram(baReply, address, senderPort);
+        });
+    }
+}
+
+
+void
+FakeController::onNewConnection() {
+    while(server.hasPendingConnections()) {
+        QWebSocket* pClient = server.nextPendingConnection();
+        connect(pClient, SIGNAL(textMessageReceived(QString)),
+                this, SLOT(onTextMessageReceived(QString)));
+        connect(pClient, SIGNAL(disconnected()),
+                this, SLOT(onClientDisconnected()));
+        clients.append(pClient);
+        emit clientConnected(sName);
+    }
+}
+
+
+void
+FakeController::onTextMessageReceived(QString sMessage) {
+    QWebSocket* pClient = qobject_cast<QWebSocket*>(sender());
+    emit messageReceived(sName, sMessage);
+    if(sMessage.contains(QString("<getStatus>")))
+        emit statusRequested(sName);
+    // Any answer keeps the heartbeat alive
+    if(pClient)
+        pClient->sendTextMessage(Protocol::serialize<Protocol::Tag::Servizio>(0).toString());
+}
+
+
+void
+FakeController::onClientDisconnected() {
+    QWebSocket* pClient = qobject_cast<QWebSocket*>(sender());
+    clients.removeAll(pClient);
+    if(pClient)
+        pClient->deleteLater();
+}
+
+
+void
+FakeController::sendToClients(const QString& sMessage) {
+    for(QWebSocket* pClient : qAsConst(clients))
+        pClient->sendTextMessage(sMessage);
+}
+
+
+/*!
+ * \brief FakeController::shutdown The controller goes away
+ *
+ * No more announcements nor probe replies, the server is closed and
+ * so are its connections.
+ */
+void
+FakeController::shutdown() {
+    announceTimer.stop();
+    server.close();
+    for(QWebSocket* pClient : qAsConst(clients)) {
+        pClient->disconnect(this);
+        pClient->close(QWebSocketProtocol::CloseCodeGoingAway, QString("Shutdown"));
+        pClient->deleteLater();
+    }
+    clients.clear();
+}
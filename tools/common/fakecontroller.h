@@ -0,0 +1,64 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QObject>
+#include <QHostAddress>
+#include <QList>
+#include <QTimer>
+#include <QUdpSocket>
+#include <QWebSocketServer>
+
+QT_FORWARD_DECLARE_CLASS(QWebSocket)
+
+
+class FakeController : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit FakeController(QString sNewName, QObject *parent = nullptr);
+    bool listen(const QHostAddress& address = QHostAddress(QHostAddress::LocalHost));
+    quint16 port() const;
+    QString name() const;
+    void announce(quint16 discoveryPort, int msecInterval, int msecReplyDelay);
+    void sendToClients(const QString& sMessage);
+    void shutdown();
+
+signals:
+    void clientConnected(QString sName);
+    void statusRequested(QString sName);
+    void messageReceived(QString sName, QString sMessage);
+
+private slots:
+    void onNewConnection();
+    void onTextMessageReceived(QString sMessage);
+    void onClientDisconnected();
+    void onAnnounceTime();
+    void onProbe();
+
+private:
+    QString            sName;
+    QWebSocketServer   server;
+    QList<QWebSocket*> clients;
+    QUdpSocket         announceSocket;
+    QTimer             announceTimer;
+    quint16            discoveryPort;
+    int                replyDelay;
+};
@@ -0,0 +1,41 @@
+# Loopback failover harness: two fake controllers and the Panel NetworkWorker.
+# Run it: it exits with 0 when the Panel picks the faster controller and
+# fails over to the other one within a heartbeat interval.
+
+QT += core
+QT += network
+QT += websockets
+QT -= gui
+
+CONFIG += c++17
+CONFIG += console
+CONFIG -= app_bundle
+
+DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000
+
+INCLUDEPATH += \
+    ../.. \
+    ../common
+
+SOURCES += \
+    ../../clocksync.cpp \
+    ../../controllerdiscovery.cpp \
+    ../../metrics.cpp \
+    ../../multicastreceiver.cpp \
+    ../../networkworker.cpp \
+    ../../protocol.cpp \
+    ../../stallwatchdog.cpp \
+    ../../trace.cpp \
+    ../common/fakecontroller.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../clocksync.h \
+    ../../controllerdiscovery.h \
+    ../../metrics.h \
+    ../../multicastreceiver.h \
+    ../../networkworker.h \
+    ../../protocol.h \
+    ../../stallwatchdog.h \
+    ../../trace.h \
+    ../common/fakecontroller.h
@@ -0,0 +1,116 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QCoreApplication>
+#include <QElapsedTimer>
+#include <QTimer>
+#include <QTextStream>
+
+#include "networkworker.h"
+#include "fakecontroller.h"
+
+
+#define DISCOVERY_PORT     45455 // udp (on the loopback)
+#define ANNOUNCE_INTERVAL    200 // msec
+#define SLOW_REPLY_DELAY     100 // msec added to the probes of the slow controller
+#define FAST_START            20 // msec the fast controller announces after the slow one
+#define SETTLE_TIME         1000 // msec connected to the first controller
+#define HEARTBEAT_INTERVAL  5000 // msec, the longest NetworkWorker refresh period
+#define FIRST_CONNECTION   10000 // msec to wait for the first connection
+
+
+/*
+ * Two controllers announce themselves on the loopback, the "slow" one
+ * first and with a longer probe round trip. The Panel must:
+ *  - connect to the "fast" one (the lower round trip), then
+ *  - when the "fast" one goes away, connect to the "slow" one within
+ *    a heartbeat interval.
+ */
+int
+main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    FakeController fast(QString("fast"));
+    FakeController slow(QString("slow"));
+    if(!fast.listen() || !slow.listen()) {
+        out << "FAIL: unable to start the fake controllers" << Qt::endl;
+        return 1;
+    }
+
+    // The configured server (ranked first) does not exist: the Panel
+    // must fall back to the announced ones
+    NetworkWorker worker(QString("ws://127.0.0.1:1"));
+    worker.setDiscovery(DISCOVERY_PORT, QHostAddress());
+    QObject::connect(&worker, &NetworkWorker::statusMessage, [&out](QString sMessage) {
+        out << "  " << sMessage << Qt::endl;
+    });
+    worker.start();
+
+    int iResult = -1;
+    auto finish = [&app, &out, &iResult](int iCode, const QString& sMessage) {
+        if(iResult >= 0)
+            return;
+        iResult = iCode;
+        out << (iCode == 0 ? "PASS: " : "FAIL: ") << sMessage << Qt::endl;
+        app.exit(iCode);
+    };
+
+    QElapsedTimer failoverTime;
+    QTimer deadline;
+    deadline.setSingleShot(true);
+    QObject::connect(&deadline, &QTimer::timeout, [&finish, &failoverTime]() {
+        if(failoverTime.isValid())
+            finish(1, QString("no failover within %1 ms").arg(HEARTBEAT_INTERVAL));
+        else
+            finish(1, QString("no connection within %1 ms").arg(FIRST_CONNECTION));
+    });
+
+    QObject::connect(&fast, &FakeController::clientConnected, [&]() {
+        out << "  connected to fast" << Qt::endl;
+        if(failoverTime.isValid()) {
+            finish(1, QString("reconnected to the controller that went away"));
+            return;
+        }
+        deadline.stop();
+        QTimer::singleShot(SETTLE_TIME, [&]() {
+            out << "  fast goes away" << Qt::endl;
+            fast.shutdown();
+            failoverTime.start();
+            deadline.start(HEARTBEAT_INTERVAL);
+        });
+    });
+    QObject::connect(&slow, &FakeController::clientConnected, [&]() {
+        out << "  connected to slow" << Qt::endl;
+        if(!failoverTime.isValid()) {
+            finish(1, QString("connected to the controller with the higher round trip"));
+            return;
+        }
+        finish(0, QString("failover in %1 ms").arg(failoverTime.elapsed()));
+    });
+
+    slow.announce(DISCOVERY_PORT, ANNOUNCE_INTERVAL, SLOW_REPLY_DELAY);
+    QTimer::singleShot(FAST_START, [&fast]() {
+        fast.announce(DISCOVERY_PORT, ANNOUNCE_INTERVAL, 0);
+    });
+    deadline.start(FIRST_CONNECTION);
+
+    app.exec();
+    worker.stop();
+    return (iResult < 0) ? 1 : iResult;
+}
@@ -0,0 +1,283 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QCoreApplication>
+#include <QCommandLineParser>
+#include <QElapsedTimer>
+#include <QNetworkInterface>
+#include <QRandomGenerator>
+#include <QTextStream>
+#include <QTimer>
+#include <QUdpSocket>
+#include <QVector>
+
+#include "networkworker.h"
+#include "fakecontroller.h"
+#include "metrics.h"
+
+
+#define MULTICAST_GROUP   "239.255.43.21"
+#define MULTICAST_PORT    45456
+#define SEND_INTERVAL         2 // msec between two datagrams
+#define RESYNC_INTERVAL     250 // msec, as in NetworkWorker
+#define RESYNC_TOLERANCE     20 // msec of scheduling jitter
+#define DRAIN_TIME          500 // msec to receive the last datagrams
+#define STATUS_PAIRING      100 // msec to wait for the <timeSync> of a heartbeat
+#define CONNECTION_TIMEOUT 5000 // msec
+
+
+namespace {
+
+/*!
+ * \brief The numbering rule, as seen from the Panel
+ *
+ * A number beyond the next one is a gap (of the skipped numbers), an
+ * old number is a duplicate.
+ */
+struct Expected {
+    quint64       gaps       = 0;
+    quint64       lost       = 0;
+    quint64       duplicates = 0;
+    quint64       accepted   = 0;
+    QVector<bool> gapAt;     // The datagrams that open a gap
+};
+
+
+Expected
+expectedCounts(const QVector<qint64>& sent) {
+    Expected expected;
+    expected.gapAt.fill(false, sent.count());
+    qint64 lastSeq = -1;
+    for(int i=0; i<sent.count(); i++) {
+        qint64 seq = sent.at(i);
+        if(lastSeq >= 0 && seq <= lastSeq) {
+            expected.duplicates++;
+            continue;
+        }
+        if(lastSeq >= 0 && seq > lastSeq+1) {
+            expected.gaps++;
+            expected.lost += quint64(seq-lastSeq-1);
+            expected.gapAt[i] = true;
+        }
+        lastSeq = seq;
+        expected.accepted++;
+    }
+    return expected;
+}
+
+
+/*!
+ * \brief The loopback interface: the datagrams never leave the host
+ */
+QNetworkInterface
+loopbackInterface() {
+    const QList<QNetworkInterface> interfaces = QNetworkInterface::allInterfaces();
+    for(const QNetworkInterface& candidate : interfaces) {
+        if((candidate.flags() & QNetworkInterface::IsLoopBack) &&
+           (candidate.flags() & QNetworkInterface::IsUp))
+            return candidate;
+    }
+    return QNetworkInterface();
+}
+
+} // namespace
+
+
+/*
+ * A fake controller sends numbered state datagrams to the multicast
+ * group: some are dropped, some swapped with the next one and some
+ * sent twice. The Panel must count the gaps, the lost and the duplicate
+ * messages as the numbering rule says and must ask the whole status
+ * again (<getStatus>) after a gap, at most once every RESYNC_INTERVAL.
+ * Everything runs on the loopback (multicast looped back on "lo").
+ *
+ * The heartbeat and the connection also send <getStatus>, always
+ * followed by <timeSync>: a <getStatus> alone is a resync.
+ */
+int
+main(int argc, char *argv[]) {
+    QCoreApplication app(argc, argv);
+    QTextStream out(stdout);
+
+    QCommandLineParser parser;
+    parser.addHelpOption();
+    QCommandLineOption countOption(QString("count"), QString("Datagrams to send."), QString("n"), QString("1000"));
+    QCommandLineOption dropOption(QString("drop"), QString("Drop probability."), QString("p"), QString("0.05"));
+    QCommandLineOption reorderOption(QString("reorder"), QString("Swap probability."), QString("p"), QString("0.05"));
+    QCommandLineOption duplicateOption(QString("duplicate"), QString("Duplicate probability."), QString("p"), QString("0.02"));
+    QCommandLineOption seedOption(QString("seed"), QString("Random seed."), QString("n"), QString("1"));
+    parser.addOptions({countOption, dropOption, reorderOption, duplicateOption, seedOption});
+    parser.process(app);
+    const qint64 nDatagrams    = parser.value(countOption).toLongLong();
+    const double dropRate      = parser.value(dropOption).toDouble();
+    const double reorderRate   = parser.value(reorderOption).toDouble();
+    const double duplicateRate = parser.value(duplicateOption).toDouble();
+    QRandomGenerator random(parser.value(seedOption).toUInt());
+
+    QNetworkInterface loopback = loopbackInterface();
+    if(!loopback.isValid()) {
+        out << "FAIL: no loopback interface" << Qt::endl;
+        return 1;
+    }
+    const QHostAddress hostAddress(QHostAddress::LocalHost);
+    FakeController controller(QString("controller"));
+    if(!controller.listen(hostAddress)) {
+        out << "FAIL: unable to start the fake controller" << Qt::endl;
+        return 1;
+    }
+    // From 127.0.0.1, the address of the WebSocket peer, and looped back
+    QUdpSocket sender;
+    sender.bind(hostAddress, 0);
+    sender.setMulticastInterface(loopback);
+    sender.setSocketOption(QAbstractSocket::MulticastLoopbackOption, 1);
+
+    // The stream: numbers dropped, swapped and repeated at random
+    QVector<qint64> stream;
+    for(qint64 seq=1; seq<=nDatagrams; seq++) {
+        if(random.generateDouble() < dropRate)
+            continue;
+        stream.append(seq);
+        if(random.generateDouble() < duplicateRate)
+            stream.append(seq);
+    }
+    for(int i=0; i+1<stream.count(); i++) {
+        if(random.generateDouble() < reorderRate) {
+            qSwap(stream[i], stream[i+1]);
+            i++;
+        }
+    }
+    const Expected expected = expectedCounts(stream);
+
+    NetworkWorker worker(QString("ws://%1:%2").arg(hostAddress.toString()).arg(controller.port()));
+    worker.setMulticast(QHostAddress(QString(MULTICAST_GROUP)), MULTICAST_PORT, loopback.name());
+    quint64 nAccepted = 0;
+    QObject::connect(&worker, &NetworkWorker::messageReceived, [&nAccepted](ProtocolMessage message) {
+        if(message.has(Protocol::Tag::Seq))
+            nAccepted++;
+    });
+
+    // The resyncs: a <getStatus> not followed by <timeSync>, that must
+    // come after a gap has been sent
+    QElapsedTimer clock;
+    clock.start();
+    QVector<qint64> resyncTimes;
+    int nUnexpectedResyncs = 0;
+    bool bGapSent = false;
+    bool bStatusPending = false;
+    qint64 statusTime = 0;
+    auto resync = [&]() {
+        bStatusPending = false;
+        resyncTimes.append(statusTime);
+        if(!bGapSent)
+            nUnexpectedResyncs++;
+        bGapSent = false;
+    };
+    QTimer pairingTimer;
+    pairingTimer.setSingleShot(true);
+    QObject::connect(&pairingTimer, &QTimer::timeout, [&]() {
+        if(bStatusPending)
+            resync();
+    });
+    QObject::connect(&controller, &FakeController::messageReceived, [&](QString sName, QString sMessage) {
+        Q_UNUSED(sName)
+        if(bStatusPending) {
+            if(sMessage.contains(QString("<timeSync>")))
+                bStatusPending = false; // Heartbeat (or connection)
+            else
+                resync();
+        }
+        if(sMessage.contains(QString("<getStatus>"))) {
+            bStatusPending = true;
+            statusTime = clock.elapsed();
+            pairingTimer.start(STATUS_PAIRING);
+        }
+    });
+    bool bConnected = false;
+
+    int iNext = 0;
+    QTimer sendTimer;
+    sendTimer.setTimerType(Qt::PreciseTimer);
+    QObject::connect(&sendTimer, &QTimer::timeout, [&]() {
+        if(iNext >= stream.count()) {
+            sendTimer.stop();
+            QTimer::singleShot(DRAIN_TIME, &app, &QCoreApplication::quit);
+            return;
+        }
+        bGapSent = bGapSent || expected.gapAt.at(iNext);
+        qint64 seq = stream.at(iNext++);
+        QString sMessage = Protocol::serialize<Protocol::Tag::Seq>(seq).toString() +
+                           Protocol::serialize<Protocol::Tag::Score0>(seq % 100).toString();
+        sender.writeDatagram(sMessage.toLatin1(), QHostAddress(QString(MULTICAST_GROUP)), MULTICAST_PORT);
+    });
+    QObject::connect(&worker, &NetworkWorker::connected, [&]() {
+        bConnected = true;
+        sendTimer.start(SEND_INTERVAL);
+    });
+    QTimer::singleShot(CONNECTION_TIMEOUT, [&]() {
+        if(!bConnected)
+            app.exit(1);
+    });
+
+    worker.start();
+    if(app.exec() != 0 || !bConnected) {
+        out << "FAIL: no connection with the fake controller" << Qt::endl;
+        return 1;
+    }
+    worker.stop();
+
+    bool bPassed = true;
+    auto check = [&out, &bPassed](const char* sName, quint64 value, quint64 expectedValue) {
+        bool bOk = (value == expectedValue);
+        out << (bOk ? "  ok   " : "  FAIL ") << sName << ": " << value
+            << " (expected " << expectedValue << ")" << Qt::endl;
+        bPassed = bPassed && bOk;
+    };
+    if(Metrics::multicastPackets.get() != quint64(stream.count())) {
+        out << "FAIL: " << stream.count()-qint64(Metrics::multicastPackets.get())
+            << " datagrams lost by the host itself: the counts cannot be checked" << Qt::endl;
+        return 1;
+    }
+    check("gaps", Metrics::multicastGaps.get(), expected.gaps);
+    check("lost", Metrics::multicastLost.get(), expected.lost);
+    check("duplicates", Metrics::duplicateMessages.get(), expected.duplicates);
+    check("accepted", nAccepted, expected.accepted);
+
+    // The resyncs: at least one if there were gaps, only after a gap,
+    // never too close
+    if(expected.gaps > 0 && resyncTimes.isEmpty()) {
+        out << "  FAIL no status request after " << expected.gaps << " gaps" << Qt::endl;
+        bPassed = false;
+    }
+    if(nUnexpectedResyncs > 0) {
+        out << "  FAIL " << nUnexpectedResyncs << " status requests without a gap" << Qt::endl;
+        bPassed = false;
+    }
+    qint64 shortest = -1;
+    for(int i=1; i<resyncTimes.count(); i++) {
+        qint64 interval = resyncTimes.at(i) - resyncTimes.at(i-1);
+        if(shortest < 0 || interval < shortest)
+            shortest = interval;
+    }
+    bool bRateOk = (shortest < 0) || (shortest >= RESYNC_INTERVAL-RESYNC_TOLERANCE);
+    out << (bRateOk ? "  ok   " : "  FAIL ") << resyncTimes.count()
+        << " resyncs, shortest interval " << shortest << " ms" << Qt::endl;
+    bPassed = bPassed && bRateOk;
+
+    out << (bPassed ? "PASS" : "FAIL") << Qt::endl;
+    return bPassed ? 0 : 1;
+}
@@ -0,0 +1,43 @@
+# Multicast loss harness, on the loopback only: numbered state datagrams,
+# dropped, reordered and duplicated at random, sent to the Panel
+# NetworkWorker. It exits with 0 when the gaps, the lost and the duplicate
+# messages are counted right and the status is asked again only after a
+# gap and at most once every RESYNC_INTERVAL.
+
+QT += core
+QT += network
+QT += websockets
+QT -= gui
+
+CONFIG += c++17
+CONFIG += console
+CONFIG -= app_bundle
+
+DEFINES += QT_DISABLE_DEPRECATED_BEFORE=0x060000
+
+INCLUDEPATH += \
+    ../.. \
+    ../common
+
+SOURCES += \
+    ../../clocksync.cpp \
+    ../../controllerdiscovery.cpp \
+    ../../metrics.cpp \
+    ../../multicastreceiver.cpp \
+    ../../networkworker.cpp \
+    ../../protocol.cpp \
+    ../../stallwatchdog.cpp \
+    ../../trace.cpp \
+    ../common/fakecontroller.cpp \
+    main.cpp
+
+HEADERS += \
+    ../../clocksync.h \
+    ../../controllerdiscovery.h \
+    ../../metrics.h \
+    ../../multicastreceiver.h \
+    ../../networkworker.h \
+    ../../protocol.h \
+    ../../stallwatchdog.h \
+    ../../trace.h \
+    ../common/fakecontroller.h
@@ -0,0 +1,201 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QElapsedTimer>
+#include <QMutex>
+#include <QMutexLocker>
+#include <QVector>
+#include <QThread>
+#include <QSaveFile>
+#include <QCoreApplication>
+
+#include "trace.h"
+
+
+#define MAX_THREAD_EVENTS 100000 // Events kept by each thread between two flushes
+
+
+namespace {
+
+struct TraceEvent {
+    const char* name;
+    qint64      start;
+    qint64      duration;
+};
+
+
+/*!
+ * \brief The events of one thread
+ *
+ * Only the owner thread appends; the mutex is contended only
+ * while the buffers are flushed.
+ */
+struct ThreadBuffer {
+    QMutex              mutex;
+    QVector<TraceEvent> events;
+    int                 tid;
+    QString             threadName;
+    quint64             nDropped;
+};
+
+
+QMutex&
+buffersMutex() {
+    static QMutex mutex;
+    return mutex;
+}
+
+
+QVector<ThreadBuffer*>&
+allBuffers() {
+    static QVector<ThreadBuffer*> buffers;
+    return buffers;
+}
+
+
+/*!
+ * \brief threadBuffer
+ * \return The buffer of the calling thread
+ *
+ * The buffers are never freed: a thread may end before the events are flushed.
+ */
+ThreadBuffer*
+threadBuffer() {
+    static thread_local ThreadBuffer* pBuffer = nullptr;
+    if(!pBuffer) {
+        pBuffer = new ThreadBuffer();
+        pBuffer->events.reserve(1024);
+        pBuffer->nDropped = 0;
+        QThread* pThread = QThread::currentThread();
+        pBuffer->threadName = pThread->objectName();
+        if(pBuffer->threadName.isEmpty()) {
+            pBuffer->threadName = (pThread == QCoreApplication::instance()->thread()) ?
+                                  QString("GUI") : QString("Thread");
+        }
+        QMutexLocker locker(&buffersMutex());
+        pBuffer->tid = allBuffers().count()+1;
+        allBuffers().append(pBuffer);
+    }
+    return pBuffer;
+}
+
+
+QByteArray
+jsonString(const QString& sText) {
+    QByteArray text = sText.toUtf8();
+    text.replace('\\', "\\\\");
+    text.replace('"', "\\\"");
+    return "\"" + text + "\"";
+}
+
+} // namespace
+
+
+std::atomic<bool> Trace::bEnabled(false);
+
+
+/*!
+ * \brief Trace::setEnabled Start or stop collecting the events
+ * \param bEnable
+ *
+ * Starting discards the events still in the buffers.
+ */
+void
+Trace::setEnabled(bool bEnable) {
+    if(bEnable && !isEnabled()) {
+        QMutexLocker locker(&buffersMutex());
+        for(ThreadBuffer* pBuffer : qAsConst(allBuffers())) {
+            QMutexLocker bufferLocker(&pBuffer->mutex);
+            pBuffer->events.clear();
+            pBuffer->nDropped = 0;
+        }
+    }
+    bEnabled.store(bEnable, std::memory_order_relaxed);
+}
+
+
+/*!
+ * \brief Trace::now
+ * \return usec since the first call
+ */
+qint64
+Trace::now() {
+    static QElapsedTimer clock;
+    static bool bStarted = (clock.start(), true);
+    Q_UNUSED(bStarted)
+    return clock.nsecsElapsed()/1000;
+}
+
+
+void
+Trace::complete(const char* sName, qint64 start, qint64 duration) {
+    ThreadBuffer* pBuffer = threadBuffer();
+    QMutexLocker locker(&pBuffer->mutex);
+    if(pBuffer->events.count() >= MAX_THREAD_EVENTS) {
+        pBuffer->nDropped++;
+        return;
+    }
+    pBuffer->events.append(TraceEvent{sName, start, duration});
+}
+
+
+/*!
+ * \brief Trace::flush Write the events in the Chrome trace event format
+ * \param sFileName The JSON file (open it in chrome://tracing or Perfetto)
+ * \return true on success
+ *
+ * The buffers are emptied.
+ */
+bool
+Trace::flush(QString sFileName) {
+    QSaveFile traceFile(sFileName);
+    if(!traceFile.open(QIODevice::WriteOnly))
+        return false;
+    traceFile.write("{\"traceEvents\":[\n");
+    bool bFirst = true;
+    QMutexLocker locker(&buffersMutex());
+    for(ThreadBuffer* pBuffer : qAsConst(allBuffers())) {
+        QVector<TraceEvent> events;
+        quint64 nDropped;
+        {
+            QMutexLocker bufferLocker(&pBuffer->mutex);
+            events.swap(pBuffer->events);
+            nDropped = pBuffer->nDropped;
+            pBuffer->nDropped = 0;
+        }
+        QByteArray sTid = QByteArray::number(pBuffer->tid);
+        QByteArray text;
+        text += bFirst ? "" : ",\n";
+        bFirst = false;
+        text += "{\"name\":\"thread_name\",\"ph\":\"M\",\"pid\":1,\"tid\":" + sTid +
+                ",\"args\":{\"name\":" + jsonString(pBuffer->threadName) + "}}";
+        for(const TraceEvent& event : qAsConst(events)) {
+            text += ",\n{\"name\":" + jsonString(QString::fromLatin1(event.name)) +
+                    ",\"ph\":\"X\",\"pid\":1,\"tid\":" + sTid +
+                    ",\"ts\":" + QByteArray::number(event.start) +
+                    ",\"dur\":" + QByteArray::number(event.duration) + "}";
+        }
+        if(nDropped > 0) {
+            text += ",\n{\"name\":\"dropped events\",\"ph\":\"C\",\"pid\":1,\"tid\":" + sTid +
+                    ",\"ts\":0,\"args\":{\"dropped\":" + QByteArray::number(nDropped) + "}}";
+        }
+        traceFile.write(text);
+    }
+    traceFile.write("\n]}\n");
+    return traceFile.commit();
+}
@@ -0,0 +1,73 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QString>
+#include <atomic>
+
+
+#define TRACE_CONCAT_(a, b) a##b
+#define TRACE_CONCAT(a, b)  TRACE_CONCAT_(a, b)
+/*!
+ * \brief TRACE_SCOPE Traces the time spent in the enclosing scope
+ * \param sName A string literal
+ */
+#define TRACE_SCOPE(sName) TraceScope TRACE_CONCAT(traceScope_, __LINE__)(sName)
+
+
+class Trace
+{
+public:
+    static bool isEnabled() {
+        return bEnabled.load(std::memory_order_relaxed);
+    }
+    static void setEnabled(bool bEnable);
+    static qint64 now();
+    static void complete(const char* sName, qint64 start, qint64 duration);
+    static bool flush(QString sFileName);
+
+private:
+    static std::atomic<bool> bEnabled;
+};
+
+
+/*!
+ * \brief Records a trace event from construction to destruction
+ *
+ * When the tracing is off it costs a relaxed atomic load.
+ */
+class TraceScope
+{
+public:
+    explicit TraceScope(const char* sScopeName)
+        : sName(sScopeName)
+        , start(Trace::isEnabled() ? Trace::now() : -1)
+    {
+    }
+    ~TraceScope() {
+        if(start >= 0)
+            Trace::complete(sName, start, Trace::now()-start);
+    }
+    TraceScope(const TraceScope&) = delete;
+    TraceScope& operator=(const TraceScope&) = delete;
+
+private:
+    const char* sName;
+    qint64      start;
+};
@@ -0,0 +1,344 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#include <QBuffer>
+#include <QDir>
+#include <QFileInfo>
+#include <QImageReader>
+#include <QStringList>
+
+#include "uploadreceiver.h"
+#include "trace.h"
+
+
+#define MAX_UPLOAD_SIZE  (qint64(64)*1024*1024) // Slides and logos only
+#define MAX_CHUNKS       4096
+#define MAX_SPOT_SIZE    (qint64(4)*1024*1024*1024)
+#define MAX_SPOT_CHUNKS  (1024*1024)
+#define CHUNK_MAX_AGE    (7*24*3600) // sec to keep the chunks of an interrupted upload
+
+
+/*!
+ * \brief UploadReceiver::UploadReceiver Receives slides and logos on the binary channel
+ * \param parent
+ *
+ * Every binary message starts with UPLOAD_MAGIC and a type byte, followed
+ * by a QDataStream (Qt_5_0) payload:
+ *
+ * UPLOAD_MANIFEST: QString target, QString name, qint64 size,
+ *                  quint32 n, n x QByteArray chunk SHA-256
+ * UPLOAD_CHUNK:    QByteArray chunk SHA-256, QByteArray data
+ * UPLOAD_SPOT:     QString name, qint64 size,
+ *                  quint32 n, n x (QByteArray chunk SHA-256, qint32 length)
+ *
+ * The Panel answers a manifest with <uploadNeed>target/name:i,j,...</uploadNeed>
+ * listing the chunks it does not have yet. Chunks are kept in the ChunkStore
+ * as they arrive, so after a reconnection the controller sends the manifest
+ * again and only the chunks still missing are transferred.
+ * The first chunk of a slide or logo is checked as soon as it arrives:
+ * a file that is not an image is refused before the rest is transferred.
+ * (The Qt image readers cannot decode a partial file: the full decode is
+ * done once the file is assembled.)
+ * When all the chunks are present the file is assembled, checked and
+ * renamed into place; then <uploadDone>target/name</uploadDone> is sent
+ * and the chunks, no longer needed, are removed from the store.
+ * Spots follow the same scheme (<spotNeed>, <spotDone>) but with content
+ * defined chunks, taken from the spots already present whenever possible
+ * (see SpotSync).
+ *
+ * The object lives in a low priority thread: the score messages are never
+ * delayed by the uploads.
+ */
+UploadReceiver::UploadReceiver(QObject *parent)
+    : QObject(parent)
+    , spotSync(&store)
+{
+    QString sBaseDir = QDir::homePath();
+    if(!sBaseDir.endsWith(QString("/"))) sBaseDir+= QString("/");
+    sSlideDir = QString("%1slides/").arg(sBaseDir);
+    sLogoDir  = QString("%1logos/").arg(sBaseDir);
+    store.prune(CHUNK_MAX_AGE);
+}
+
+
+void
+UploadReceiver::setSlideDir(QString sNewDir) {
+    sSlideDir = sNewDir;
+    if(!sSlideDir.endsWith(QString("/"))) sSlideDir+= QString("/");
+}
+
+
+void
+UploadReceiver::setSpotDir(QString sNewDir) {
+    spotSync.setSpotDir(sNewDir);
+}
+
+
+QString
+UploadReceiver::uploadKey(QString sTarget, QString sName) {
+    return sTarget + QString("/") + sName;
+}
+
+
+QString
+UploadReceiver::destinationDir(QString sTarget) const {
+    if(sTarget == QString("slide"))
+        return sSlideDir;
+    if(sTarget == QString("logo"))
+        return sLogoDir;
+    return QString();
+}
+
+
+void
+UploadReceiver::onBinaryMessage(QByteArray baMessage) {
+    TRACE_SCOPE("UploadReceiver::onBinaryMessage");
+    QDataStream stream(baMessage);
+    stream.setVersion(QDataStream::Qt_5_0); // Same encoding of these types up to Qt 6
+    quint32 magic;
+    quint8 type;
+    stream >> magic >> type;
+    if(stream.status() != QDataStream::Ok || magic != UPLOAD_MAGIC)
+        return;
+    if(type == UPLOAD_MANIFEST)
+        onManifest(stream);
+    else if(type == UPLOAD_CHUNK)
+        onChunk(stream);
+    else if(type == UPLOAD_SPOT)
+        onSpotManifest(stream);
+}
+
+
+/*!
+ * \brief UploadReceiver::onManifest A new (or resumed) upload
+ * \param stream
+ */
+void
+UploadReceiver::onManifest(QDataStream& stream) {
+    Upload upload;
+    quint32 nChunks;
+    stream >> upload.target >> upload.name >> upload.size >> nChunks;
+    if(stream.status() != QDataStream::Ok || nChunks > MAX_CHUNKS)
+        return;
+    // Never write outside the destination directory
+    upload.name = QFileInfo(upload.name).fileName();
+    if(upload.name.isEmpty() || upload.name.startsWith(QString(".")) ||
+       destinationDir(upload.target).isEmpty() ||
+       upload.size < 0 || upload.size > MAX_UPLOAD_SIZE)
+    {
+        emit replyReady(QString("<uploadFailed>%1</uploadFailed>")
+                        .arg(uploadKey(upload.target, upload.name)));
+        return;
+    }
+    QStringList sMissing;
+    upload.chunks.reserve(int(nChunks));
+    for(quint32 i=0; i<nChunks; i++) {
+        QByteArray chunkHash;
+        stream >> chunkHash;
+        upload.chunks.append(chunkHash);
+        if(!store.contains(chunkHash)) {
+            if(!upload.missing.contains(chunkHash))
+                sMissing.append(QString::number(i));
+            upload.missing.insert(chunkHash);
+        }
+    }
+    if(stream.status() != QDataStream::Ok)
+        return;
+    QString sKey = uploadKey(upload.target, upload.name);
+    if(upload.missing.isEmpty()) {
+        uploads.remove(sKey);
+        complete(upload);
+        releaseChunks(QList<Upload>() << upload);
+        return;
+    }
+    uploads.insert(sKey, upload);
+    emit replyReady(QString("<uploadNeed>%1:%2</uploadNeed>")
+                    .arg(sKey, sMissing.join(QChar(','))));
+}
+
+
+/*!
+ * \brief UploadReceiver::onChunk Store a chunk and complete the uploads waiting for it
+ * \param stream
+ */
+void
+UploadReceiver::onChunk(QDataStream& stream) {
+    QByteArray chunkHash;
+    QByteArray data;
+    stream >> chunkHash >> data;
+    if(stream.status() != QDataStream::Ok)
+        return;
+    if(!store.store(chunkHash, data))
+        return; // Corrupted: it will be asked again with the next manifest
+    QList<Upload> completed;
+    QList<Upload> refused;
+    for(auto it=uploads.begin(); it!=uploads.end();) {
+        if(!it->chunks.isEmpty() && it->chunks.first() == chunkHash && !isImageStart(data)) {
+            refused.append(*it);
+            it = uploads.erase(it);
+            continue;
+        }
+        it->missing.remove(chunkHash);
+        if(it->missing.isEmpty()) {
+            completed.append(*it);
+            it = uploads.erase(it);
+        }
+        else
+            ++it;
+    }
+    for(const Upload& upload : qAsConst(refused))
+        fail(upload);
+    for(const Upload& upload : qAsConst(completed))
+        complete(upload);
+    // Only now: the uploads of the batch may share chunks
+    releaseChunks(refused + completed);
+    const QStringList sSpots = spotSync.chunkStored(chunkHash);
+    for(const QString& sName : sSpots)
+        completeSpot(sName);
+}
+
+
+/*!
+ * \brief UploadReceiver::onSpotManifest A spot to synchronize
+ * \param stream
+ */
+void
+UploadReceiver::onSpotManifest(QDataStream& stream) {
+    QString sName;
+    qint64 size;
+    quint32 nChunks;
+    stream >> sName >> size >> nChunks;
+    if(stream.status() != QDataStream::Ok || nChunks > MAX_SPOT_CHUNKS)
+        return;
+    sName = QFileInfo(sName).fileName();
+    if(sName.isEmpty() || sName.startsWith(QString(".")) ||
+       !sName.endsWith(QString(".mp4"), Qt::CaseInsensitive) ||
+       size < 0 || size > MAX_SPOT_SIZE)
+    {
+        emit replyReady(QString("<spotFailed>%1</spotFailed>").arg(sName));
+        return;
+    }
+    QVector<SpotSync::Chunk> chunks;
+    chunks.reserve(int(nChunks));
+    for(quint32 i=0; i<nChunks; i++) {
+        SpotSync::Chunk chunk;
+        qint32 length;
+        stream >> chunk.hash >> length;
+        chunk.offset = 0;
+        chunk.length = length;
+        chunks.append(chunk);
+    }
+    if(stream.status() != QDataStream::Ok)
+        return;
+    if(!SpotSync::isValidManifest(size, chunks)) {
+        emit replyReady(QString("<spotFailed>%1</spotFailed>").arg(sName));
+        return;
+    }
+    QStringList sMissing = spotSync.addManifest(sName, size, chunks);
+    if(sMissing.isEmpty()) {
+        completeSpot(sName);
+        return;
+    }
+    emit replyReady(QString("<spotNeed>%1:%2</spotNeed>")
+                    .arg(sName, sMissing.join(QChar(','))));
+}
+
+
+void
+UploadReceiver::completeSpot(QString sName) {
+    if(spotSync.complete(sName))
+        emit replyReady(QString("<spotDone>%1</spotDone>").arg(sName));
+    else
+        emit replyReady(QString("<spotFailed>%1</spotFailed>").arg(sName));
+}
+
+
+/*!
+ * \brief UploadReceiver::complete Assemble the file and move it into place
+ * \param upload
+ */
+void
+UploadReceiver::complete(const Upload& upload) {
+    TRACE_SCOPE("UploadReceiver::complete");
+    QString sKey = uploadKey(upload.target, upload.name);
+    QString sDir = destinationDir(upload.target);
+    QDir().mkpath(sDir);
+    QString sPath = sDir + upload.name;
+    // Assemble beside the destination and check the image before it becomes visible
+    QString sTemp = sDir + QString(".") + upload.name + QString(".part");
+    bool bOk = store.assemble(upload.chunks, upload.size, sTemp);
+    if(bOk) {
+        QImageReader reader(sTemp);
+        reader.setDecideFormatFromContent(true);
+        bOk = !reader.read().isNull();
+    }
+    if(bOk) {
+        bOk = ChunkStore::replaceFile(sTemp, sPath);
+    }
+    if(!bOk) {
+        QFile::remove(sTemp);
+        fail(upload);
+        return;
+    }
+    emit replyReady(QString("<uploadDone>%1</uploadDone>").arg(sKey));
+    emit uploadCompleted(upload.target, sPath);
+}
+
+
+void
+UploadReceiver::fail(const Upload& upload) {
+    emit replyReady(QString("<uploadFailed>%1</uploadFailed>")
+                    .arg(uploadKey(upload.target, upload.name)));
+}
+
+
+/*!
+ * \brief UploadReceiver::releaseChunks Remove the chunks nobody else is waiting for
+ * \param finished The uploads completed (or failed) together, already
+ * removed from the pending ones and all of them already assembled
+ *
+ * Otherwise every slide would stay on the SD card twice.
+ */
+void
+UploadReceiver::releaseChunks(const QList<Upload>& finished) {
+    for(const Upload& upload : finished) {
+        for(const QByteArray& chunkHash : upload.chunks) {
+            bool bNeeded = spotSync.uses(chunkHash);
+            for(auto it=uploads.cbegin(); !bNeeded && it!=uploads.cend(); ++it)
+                bNeeded = it->chunks.contains(chunkHash);
+            if(!bNeeded)
+                store.remove(chunkHash);
+        }
+    }
+}
+
+
+/*!
+ * \brief UploadReceiver::isImageStart
+ * \param data The first chunk of a file
+ * \return true if it starts like an image Qt can read
+ */
+bool
+UploadReceiver::isImageStart(const QByteArray& data) {
+    QBuffer buffer;
+    buffer.setData(data);
+    buffer.open(QIODevice::ReadOnly);
+    QImageReader reader(&buffer);
+    reader.setDecideFormatFromContent(true);
+    return reader.canRead();
+}
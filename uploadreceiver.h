@@ -0,0 +1,81 @@
+/*
+ *
+Copyright (C) 2023  Gabriele Salvato
+
+This program is free software: you can redistribute it and/or modify
+it under the terms of the GNU General Public License as published by
+the Free Software Foundation, either version 3 of the License, or
+(at your option) any later version.
+
+This program is distributed in the hope that it will be useful,
+but WITHOUT ANY WARRANTY; without even the implied warranty of
+MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See the
+GNU General Public License for more details.
+
+You should have received a copy of the GNU General Public License
+along with this program.  If not, see <http://www.gnu.org/licenses/>.
+*
+*/
+#pragma once
+
+#include <QObject>
+#include <QHash>
+#include <QSet>
+#include <QVector>
+#include <QDataStream>
+
+#include "chunkstore.h"
+#include "spotsync.h"
+
+
+#define UPLOAD_MAGIC        quint32(0x56505550) // "VPUP"
+#define UPLOAD_MANIFEST     quint8(1)
+#define UPLOAD_CHUNK        quint8(2)
+#define UPLOAD_SPOT         quint8(3)
+
+
+class UploadReceiver : public QObject
+{
+    Q_OBJECT
+
+public:
+    explicit UploadReceiver(QObject *parent = nullptr);
+
+public slots:
+    void setSlideDir(QString sNewDir);
+    void setSpotDir(QString sNewDir);
+    void onBinaryMessage(QByteArray baMessage);
+
+signals:
+    void replyReady(QString sMessage);
+    void uploadCompleted(QString sTarget, QString sPath);
+
+private:
+    /*!
+     * \brief A file being received
+     */
+    struct Upload {
+        QString             target;  /*!< "slide" or "logo" */
+        QString             name;    /*!< File name (no path) */
+        qint64              size;    /*!< File size in bytes */
+        QVector<QByteArray> chunks;  /*!< SHA-256 of the chunks in file order */
+        QSet<QByteArray>    missing; /*!< Chunks not yet in the store */
+    };
+    void onManifest(QDataStream& stream);
+    void onChunk(QDataStream& stream);
+    void onSpotManifest(QDataStream& stream);
+    void completeSpot(QString sName);
+    void complete(const Upload& upload);
+    void fail(const Upload& upload);
+    void releaseChunks(const QList<Upload>& finished);
+    static bool isImageStart(const QByteArray& data);
+    QString destinationDir(QString sTarget) const;
+    static QString uploadKey(QString sTarget, QString sName);
+
+private:
+    ChunkStore             store;
+    SpotSync               spotSync;
+    QString                sSlideDir;
+    QString                sLogoDir;
+    QHash<QString, Upload> uploads;
+};
@@ -3,10 +3,12 @@
 #include <QMessageBox>
 #include <QDir>
 #include <QStandardPaths>
-#include <QSettings>
 
 #include "volleyapplication.h"
 #include "volleypanel.h"
+#include "startuptrace.h"
+#include "panelconfig.h"
+#include "resourcecache.h"
 
 #define NETWORK_CHECK_TIME    3000 // In msec
 
@@ -16,17 +18,19 @@ VolleyApplication::VolleyApplication(int &argc, char **argv)
     , logFile(nullptr)
     , pScorePanel(nullptr)
 {
-    pSettings = new QSettings("Gabriele Salvato", "Volley Panel");
-    sLanguage = pSettings->value("language/current",  QString("Italiano")).toString();
+    StartupTrace::mark("application");
+    sLanguage = PanelConfig::instance()->value("language/current",  QString("Italiano")).toString();
 #ifdef LOG_VERBOSE
     logMessage(logFile,
                Q_FUNC_INFO,
                QString("Initial Language: %1").arg(sLanguage));
 #endif
     if(sLanguage == QString("English")) {
-        if(Translator.load(":/VolleyPanel_en_US.ts"))
+        // The compiled translations are embedded by lrelease in :/i18n
+        if(Translator.load(QString("VolleyPanel_en_US"), QString(":/i18n")))
             QCoreApplication::installTranslator(&Translator);
     }
+    StartupTrace::mark("settings and translations");
 
     // Initialize the random number generator
     QTime time(QTime::currentTime());
@@ -37,9 +41,17 @@ VolleyApplication::VolleyApplication(int &argc, char **argv)
     if(!sBaseDir.endsWith(QString("/"))) sBaseDir+= QString("/");
     logFileName = QString("%1volley_panel.txt").arg(sBaseDir);
     PrepareLogFile();
+    StartupTrace::mark("log file");
 
     pScorePanel = new VolleyPanel(logFile);
     pScorePanel->showFullScreen();
+    StartupTrace::mark("show");
+}
+
+
+VolleyApplication::~VolleyApplication() {
+    // The cached pixmaps cannot outlive the QApplication
+    ResourceCache::clear();
 }
 
 
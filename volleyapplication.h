@@ -5,7 +5,6 @@
 #include <QTimer>
 
 
-QT_FORWARD_DECLARE_CLASS(QSettings)
 QT_FORWARD_DECLARE_CLASS(VolleyPanel)
 QT_FORWARD_DECLARE_CLASS(QFile)
 
@@ -15,6 +14,7 @@ class VolleyApplication : public QApplication
     Q_OBJECT
 public:
     VolleyApplication(int& argc, char** argv);
+    ~VolleyApplication();
 
 private:
     bool PrepareLogFile();
@@ -23,7 +23,6 @@ public:
     QTranslator        Translator;
 
 private:
-    QSettings         *pSettings;
     QFile             *logFile;
     VolleyPanel*      pScorePanel;
     QString            sLanguage;
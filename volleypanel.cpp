@@ -2,7 +2,6 @@
 #include <QtNetwork>
 #include <QtWidgets>
 #include <QProcess>
-#include <QWebSocket>
 #include <QVBoxLayout>
 #include <QMessageBox>
 #include <QTime>
@@ -10,32 +9,40 @@
 #include "volleypanel.h"
 #include "timeoutwindow.h"
 #include "utility.h"
+#include "resourcecache.h"
+#include "startuptrace.h"
+#include "textfitter.h"
+#include "metrics.h"
+#include "trace.h"
+#include "stallwatchdog.h"
+
+
+#define STALE_OPACITY 0.35 // Of the fields restored from the snapshot
+
 
 VolleyPanel::VolleyPanel(QFile *myLogFile, QWidget *parent)
     : ScorePanel(myLogFile, parent)
     , iServizio(0)
-    , maxTeamNameLen(15)
+    , bStale(false)
+    , pTeamFitter(Q_NULLPTR)
     , pTimeoutWindow(Q_NULLPTR)
 {
     sFontName = QString("Liberation Sans Bold");
     fontWeight = QFont::Black;
 
     QSize panelSize = QGuiApplication::primaryScreen()->geometry().size();
-    iTeamFontSize    = std::min(panelSize.height()/8,
-                                int(panelSize.width()/(2.2*maxTeamNameLen)));
+    // Each team name is fitted in half the panel width
+    teamSlotSize     = QSize(int(panelSize.width()/2.2), panelSize.height()/6);
     iScoreFontSize   = std::min(panelSize.height()/4,
                                 int(panelSize.width()/9));
     iLabelsFontSize  = panelSize.height()/8; // 2 Righe
     iTimeoutFontSize = panelSize.height()/8; // 2 Righe
     iSetFontSize     = panelSize.height()/8; // 2 Righe
 
-    connect(pPanelServerSocket, SIGNAL(textMessageReceived(QString)),
-            this, SLOT(onTextMessageReceived(QString)));
-    connect(pPanelServerSocket, SIGNAL(binaryMessageReceived(QByteArray)),
+    // Text messages are parsed in the network thread and dispatched by ScorePanel
+    connect(pNetworkWorker, SIGNAL(binaryMessageReceived(QByteArray)),
             this, SLOT(onBinaryMessageReceived(QByteArray)));
 
-    pSettings = new QSettings("Gabriele Salvato", "Segnapunti Volley");
-
     // QWidget propagates explicit palette roles from parent to child.
     // If you assign a brush or color to a specific role on a palette and
     // assign that palette to a widget, that role will propagate to all
@@ -54,25 +61,54 @@ VolleyPanel::VolleyPanel(QFile *myLogFile, QWidget *parent)
     panelPalette.setColor(QPalette::BrightText,    Qt::white);
     setPalette(panelPalette);
 
-
-    pTimeoutWindow = new TimeoutWindow(Q_NULLPTR);
-    connect(pTimeoutWindow, SIGNAL(doneTimeout()),
-            this, SLOT(onTimeoutDone()));
-
+    // The TimeoutWindow is created on the first timeout
     createPanelElements();
     buildLayout();
+    restoreSnapshot();
+    StartupTrace::mark("volley panel");
+}
+
+
+/*!
+ * \brief VolleyPanel::timeoutWindow
+ * \return The TimeoutWindow, created on first use
+ */
+TimeoutWindow*
+VolleyPanel::timeoutWindow() {
+    if(!pTimeoutWindow) {
+        pTimeoutWindow = new TimeoutWindow(Q_NULLPTR);
+        connect(pTimeoutWindow, SIGNAL(doneTimeout()),
+                this, SLOT(onTimeoutDone()));
+    }
+    return pTimeoutWindow;
 }
 
 
 VolleyPanel::~VolleyPanel() {
-    if(pSettings) delete pSettings;
+    if(pTeamFitter) delete pTeamFitter;
+}
+
+
+/*!
+ * \brief VolleyPanel::setTeamName Show a team name as large as its slot allows
+ * \param iTeam The team (0 or 1)
+ * \param sName The name to show
+ */
+void
+VolleyPanel::setTeamName(int iTeam, QString sName) {
+    if(sName == sTeamName[iTeam])
+        return;
+    sTeamName[iTeam] = sName;
+    scoreState.team[iTeam] = sName;
+    if(sName.trimmed().isEmpty())
+        team[iTeam]->setText(" ");
+    else
+        team[iTeam]->setPixmap(pTeamFitter->fittedText(sName, teamSlotSize));
 }
 
 
 void
 VolleyPanel::closeEvent(QCloseEvent *event) {
-    if(pSettings != Q_NULLPTR) delete pSettings;
-    pSettings = Q_NULLPTR;
     ScorePanel::closeEvent(event);
     event->accept();
 }
@@ -86,113 +122,160 @@ VolleyPanel::onTimeoutDone() {
 
 void
 VolleyPanel::onBinaryMessageReceived(QByteArray baMessage) {
+#ifdef LOG_VERBOSE_VERBOSE
     logMessage(logFile,
                Q_FUNC_INFO,
                QString("Received %1 bytes").arg(baMessage.size()));
+#endif
     ScorePanel::onBinaryMessageReceived(baMessage);
 }
 
+/*!
+ * \brief VolleyPanel::applyMessage Updates the score with the values of a message
+ * \param message Already parsed and validated
+ *
+ * The Panel commands are then executed by ScorePanel.
+ */
 void
-VolleyPanel::onTextMessageReceived(QString sMessage) {
-    QString sToken;
-    bool ok;
+VolleyPanel::applyMessage(const ProtocolMessage& message) {
+    GUI_PHASE("VolleyPanel::applyMessage");
+    QElapsedTimer parseTimer;
+    parseTimer.start();
     int iVal;
-    QString sNoData = QString("NoData");
-
-    sToken = XML_Parse(sMessage, "team0");
-    if(sToken != sNoData){
-        team[0]->setText(sToken.left(maxTeamNameLen));
-    }// team0
-
-    sToken = XML_Parse(sMessage, "team1");
-    if(sToken != sNoData){
-        team[1]->setText(sToken.left(maxTeamNameLen));
-    }// team1
-
-    sToken = XML_Parse(sMessage, "set0");
-    if(sToken != sNoData){
-        iVal = sToken.toInt(&ok);
-        if(!ok || iVal<0 || iVal>3)
-            iVal = 8;
-        set[0]->setText(QString("%1").arg(iVal));
-    }// set0
-
-    sToken = XML_Parse(sMessage, "set1");
-    if(sToken != sNoData){
-        iVal = sToken.toInt(&ok);
-        if(!ok || iVal<0 || iVal>3)
-            iVal = 8;
-        set[1]->setText(QString("%1").arg(iVal));
-    }// set1
-
-    sToken = XML_Parse(sMessage, "timeout0");
-    if(sToken != sNoData){
-        iVal = sToken.toInt(&ok);
-        if(!ok || iVal<0 || iVal>2)
-            iVal = 8;
-        timeout[0]->setText(QString("%1"). arg(iVal));
-    }// timeout0
-
-    sToken = XML_Parse(sMessage, "timeout1");
-    if(sToken != sNoData){
-        iVal = sToken.toInt(&ok);
-        if(!ok || iVal<0 || iVal>2)
-            iVal = 8;
-        timeout[1]->setText(QString("%1"). arg(iVal));
-    }// timeout1
-
-    sToken = XML_Parse(sMessage, "startTimeout");
-    if(sToken != sNoData) {
-        iVal = sToken.toInt(&ok);
-        if(!ok || iVal<0)
-            iVal = 30;
-        pTimeoutWindow->startTimeout(iVal*1000);
-        pTimeoutWindow->showFullScreen();
-        // Do NOT hide the Panel: its window is transparent !
-    }// timeout1
-
-    sToken = XML_Parse(sMessage, "stopTimeout");
-    if(sToken != sNoData) {
-        pTimeoutWindow->stopTimeout();
-        showFullScreen();
-        pTimeoutWindow->hide();
-    }// timeout1
-
-    sToken = XML_Parse(sMessage, "score0");
-    if(sToken != sNoData) {
-        iVal = sToken.toInt(&ok);
-        if(!ok || iVal<0 || iVal>99)
-            iVal = 99;
-        score[0]->setText(QString("%1").arg(iVal));
-    }// score0
-
-    sToken = XML_Parse(sMessage, "score1");
-    if(sToken != sNoData){
-        iVal = sToken.toInt(&ok);
-        if(!ok || iVal<0 || iVal>99)
-            iVal = 99;
-        score[1]->setText(QString("%1").arg(iVal));
-    }// score1
-
-    sToken = XML_Parse(sMessage, "servizio");
-    if(sToken != sNoData){
-        iVal = sToken.toInt(&ok);
-        if(!ok || iVal<-1 || iVal>1)
-            iVal = 0;
-        iServizio = iVal;
-        if(iServizio == -1) {
-            servizio[0]->setText(" ");
-            servizio[1]->setText(" ");
-        } else if(iServizio == 0) {
-            servizio[0]->setPixmap(*pPixmapService);
-            servizio[1]->setText(" ");
-        } else if(iServizio == 1) {
-            servizio[0]->setText(" ");
-            servizio[1]->setPixmap(*pPixmapService);
+
+    for(int i=0; i<message.count(); i++) {
+        const Protocol::Tag tag = message.tag(i);
+        switch(tag) {
+        case Protocol::Tag::Team0:
+            setTeamName(0, message.text(tag));
+            break;
+
+        case Protocol::Tag::Team1:
+            setTeamName(1, message.text(tag));
+            break;
+
+        case Protocol::Tag::Set0:
+        case Protocol::Tag::Set1: {
+            int iTeam = (tag == Protocol::Tag::Set0) ? 0 : 1;
+            iVal = int(message.number(tag));
+            set[iTeam]->setText(QString("%1").arg(iVal));
+            scoreState.set[iTeam] = iVal;
+            break;
+        }
+
+        case Protocol::Tag::Timeout0:
+        case Protocol::Tag::Timeout1: {
+            int iTeam = (tag == Protocol::Tag::Timeout0) ? 0 : 1;
+            iVal = int(message.number(tag));
+            timeout[iTeam]->setText(QString("%1").arg(iVal));
+            scoreState.timeout[iTeam] = iVal;
+            break;
+        }
+
+        case Protocol::Tag::StartTimeout:
+            // An absolute deadline (controller clock) keeps all the panels in step
+            if(message.has(Protocol::Tag::TimeoutDeadline) && clockSync.isValid())
+                timeoutWindow()->startTimeout(clockSync.toLocalDeadline(message.number(Protocol::Tag::TimeoutDeadline)));
+            else
+                timeoutWindow()->startTimeout(int(message.number(tag))*1000);
+            pTimeoutWindow->showFullScreen();
+            // Do NOT hide the Panel: its window is transparent !
+            break;
+
+        case Protocol::Tag::StopTimeout:
+            if(pTimeoutWindow) {
+                pTimeoutWindow->stopTimeout();
+                pTimeoutWindow->hide();
+            }
+            showFullScreen();
+            break;
+
+        case Protocol::Tag::Score0:
+        case Protocol::Tag::Score1: {
+            int iTeam = (tag == Protocol::Tag::Score0) ? 0 : 1;
+            iVal = int(message.number(tag));
+            score[iTeam]->setText(QString("%1").arg(iVal));
+            scoreState.score[iTeam] = iVal;
+            break;
+        }
+
+        case Protocol::Tag::Servizio:
+            showServizio(int(message.number(tag)));
+            break;
+
+        default: // Panel commands
+            break;
         }
-    }// servizio
+    }
+
+    // The controller has confirmed (or replaced) the restored score
+    if(bStale && message.hasAny(Protocol::mergeableTags() & ~Protocol::bit(Protocol::Tag::Seq)))
+        setStale(false);
+
+    ScorePanel::applyMessage(message);
+    Metrics::parseTime.observe(parseTimer.nsecsElapsed()/1000);
+}
+
 
-    ScorePanel::onTextMessageReceived(sMessage);
+void
+VolleyPanel::showServizio(int iTeam) {
+    iServizio = iTeam;
+    scoreState.servizio = iServizio;
+    if(iServizio == -1) {
+        servizio[0]->setText(" ");
+        servizio[1]->setText(" ");
+    } else if(iServizio == 0) {
+        servizio[0]->setPixmap(pixmapService);
+        servizio[1]->setText(" ");
+    } else if(iServizio == 1) {
+        servizio[0]->setText(" ");
+        servizio[1]->setPixmap(pixmapService);
+    }
+}
+
+
+/*!
+ * \brief VolleyPanel::restoreSnapshot Shows the score saved before the restart
+ *
+ * The score is shown at once, dimmed, until the controller sends its own.
+ */
+void
+VolleyPanel::restoreSnapshot() {
+    if(!snapshot.load(&savedState))
+        return;
+    for(int i=0; i<2; i++) {
+        setTeamName(i, savedState.team[i]);
+        score[i]->setText(QString("%1").arg(savedState.score[i]));
+        set[i]->setText(QString("%1").arg(savedState.set[i]));
+        timeout[i]->setText(QString("%1").arg(savedState.timeout[i]));
+    }
+    showServizio(savedState.servizio);
+    scoreState = savedState;
+    setStale(true);
+}
+
+
+/*!
+ * \brief VolleyPanel::setStale Dims the fields not yet confirmed by the controller
+ *
+ * The team names and the service ball are pixmaps: a palette would not
+ * change them, an opacity effect dims every field the same way.
+ */
+void
+VolleyPanel::setStale(bool bNewStale) {
+    bStale = bNewStale;
+    for(int i=0; i<2; i++) {
+        QLabel* fields[] = { team[i], score[i], servizio[i], set[i], timeout[i] };
+        for(QLabel* pField : fields) {
+            if(bStale) {
+                QGraphicsOpacityEffect* pDimmer = new QGraphicsOpacityEffect(pField);
+                pDimmer->setOpacity(STALE_OPACITY);
+                pField->setGraphicsEffect(pDimmer); // Deletes the previous one
+            }
+            else
+                pField->setGraphicsEffect(nullptr);
+        }
+    }
 }
 
 
@@ -241,22 +324,36 @@ VolleyPanel::createPanelElements() {
         servizio[i]->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
     }
 
-    // Teams
-    QPalette pal = panelPalette;
-    pal.setColor(QPalette::WindowText, Qt::white);
+    // Teams: rendered once for each name and shown as pixmaps
+    pTeamFitter = new TextFitter(sFontName, fontWeight, Qt::white);
     for(int i=0; i<2; i++) {
         team[i] = new QLabel();
-        team[i]->setPalette(pal);
-        team[i]->setFont(QFont(sFontName, iTeamFontSize, fontWeight));
+        team[i]->setAlignment(Qt::AlignCenter);
         team[i]->setSizePolicy(QSizePolicy::Fixed, QSizePolicy::Fixed);
     }
-    team[0]->setText(tr("Locali"));
-    team[1]->setText(tr("Ospiti"));
+    setTeamName(0, tr("Locali"));
+    setTeamName(1, tr("Ospiti"));
+}
+
+
+/*!
+ * \brief VolleyPanel::logoFile
+ * \param sName The logo file name in ~/logos
+ * \param sDefault The built in logo
+ * \return The logo to show
+ */
+QString
+VolleyPanel::logoFile(QString sName, QString sDefault) {
+    QString sLogo = QDir::homePath() + QString("/logos/") + sName;
+    if(QFileInfo::exists(sLogo))
+        return sLogo;
+    return sDefault;
 }
 
 
 QGridLayout*
 VolleyPanel::createPanel() {
+    GUI_PHASE("VolleyPanel::createPanel");
     QGridLayout *layout = new QGridLayout();
 
     int ileft  = 0;
@@ -265,16 +362,15 @@ VolleyPanel::createPanel() {
         ileft  = 1;
         iright = 0;
     }
-    QPixmap* pixmapLeftTop = new QPixmap(":/Logo_UniMe.png");
+    // Logos uploaded by the controller replace the built in ones
     QLabel* leftTopLabel = new QLabel();
-    leftTopLabel->setPixmap(*pixmapLeftTop);
+    leftTopLabel->setPixmap(ResourceCache::pixmap(logoFile("left.png", ":/Logo_UniMe.png")));
 
-    QPixmap* pixmapRightTop = new QPixmap(":/SSD_UniMe.png");
     QLabel* rightTopLabel = new QLabel();
-    rightTopLabel->setPixmap(*pixmapRightTop);
+    rightTopLabel->setPixmap(ResourceCache::pixmap(logoFile("right.png", ":/SSD_UniMe.png")));
 
-    pPixmapService = new QPixmap(":/ball2.png");
-    *pPixmapService = pPixmapService->scaled(2*iLabelsFontSize/3, 2*iLabelsFontSize/3);
+    pixmapService = ResourceCache::pixmap(QString(":/ball2.png"),
+                                          QSize(2*iLabelsFontSize/3, 2*iLabelsFontSize/3));
 
     layout->addWidget(team[ileft],      0, 0, 2, 6, Qt::AlignHCenter|Qt::AlignVCenter);
     layout->addWidget(team[iright],     0, 6, 2, 6, Qt::AlignHCenter|Qt::AlignVCenter);
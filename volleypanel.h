@@ -8,11 +8,11 @@
 
 #include "scorepanel.h"
 
-QT_FORWARD_DECLARE_CLASS(QSettings)
 QT_FORWARD_DECLARE_CLASS(QGroupBox)
 QT_FORWARD_DECLARE_CLASS(QFile)
 QT_FORWARD_DECLARE_CLASS(QGridLayout)
 QT_FORWARD_DECLARE_CLASS(TimeoutWindow)
+QT_FORWARD_DECLARE_CLASS(TextFitter)
 
 class VolleyPanel : public ScorePanel
 {
@@ -25,7 +25,6 @@ public:
     void changeEvent(QEvent *event);
 
 private:
-    QSettings         *pSettings;
     QLabel            *team[2];
     QLabel            *score[2];
     QLabel            *scoreLabel;
@@ -40,20 +39,30 @@ private:
     QLinearGradient    panelGradient;
     QBrush             panelBrush;
     int                iServizio;
+    bool               bStale;
     int                iTimeoutFontSize;
     int                iSetFontSize;
     int                iScoreFontSize;
-    int                iTeamFontSize;
+    QSize              teamSlotSize;
     int                iLabelsFontSize;
-    int                maxTeamNameLen;
-    QPixmap*           pPixmapService;
+    QString            sTeamName[2];
+    TextFitter*        pTeamFitter;
+    QPixmap            pixmapService;
 
     void               createPanelElements();
+    void               setTeamName(int iTeam, QString sName);
+    void               showServizio(int iTeam);
+    void               restoreSnapshot();
+    void               setStale(bool bNewStale);
     QGridLayout*       createPanel();
+    QString            logoFile(QString sName, QString sDefault);
+    TimeoutWindow*     timeoutWindow();
     TimeoutWindow     *pTimeoutWindow;
 
+protected:
+    void applyMessage(const ProtocolMessage& message) override;
+
 private slots:
-    void onTextMessageReceived(QString sMessage);
     void onBinaryMessageReceived(QByteArray baMessage);
     void onTimeoutDone();
 };